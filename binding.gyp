@@ -30,9 +30,15 @@
       'hard_dependency': 1,
       'sources': [
         './src/annotator.cpp',
+        './src/compressed_file.cpp',
         './src/database.cpp',
+        './src/edge_speed_map.cpp',
         './src/extractor.cpp',
+        './src/polyline.cpp',
         './src/segment_speed_map.cpp',
+        './src/speed_fallback.cpp',
+        './src/speed_stats.cpp',
+        './src/thread_pool.cpp',
         './src/way_speed_map.cpp'
       ],
       'cflags': [
@@ -58,6 +64,8 @@
       'dependencies': [ 'action_before_build', 'annotator' ],
       'product_dir': '<(module_path)',
       'sources': [
+        './src/binding_utils.cpp',
+        './src/fallback_bindings.cpp',
         './src/main_bindings.cpp',
         './src/nodejs_bindings.cpp',
         './src/segment_bindings.cpp',
@@ -149,6 +157,190 @@
         'GCC_VERSION': 'com.apple.compilers.llvm.clang.1_0'
       }
     },
+    {
+      'target_name': 'bench-lookups',
+      'dependencies': [ 'annotator' ],
+      'type': 'executable',
+      'sources': [ './test/bench-lookups.cpp' ],
+      'include_dirs': [ 'src/' ],
+      'conditions': [
+        ['error_on_warnings == "true"', {
+            'cflags_cc' : [ '-Werror' ],
+            'xcode_settings': {
+              'OTHER_CPLUSPLUSFLAGS': [ '-Werror' ]
+            }
+        }]
+      ],
+      "libraries": [
+        '<(module_root_dir)/mason_packages/.link/lib/libbz2.a',
+        '<(module_root_dir)/mason_packages/.link/lib/libexpat.a',
+        '<(module_root_dir)/mason_packages/.link/lib/libboost_iostreams.a',
+        # we link to zlib here to fix this error: ../src/extractor.cpp:(.text._ZN6osmium2io16GzipDecompressor4readEv[_ZN6osmium2io16GzipDecompressor4readEv]+0x46): undefined reference to `gzoffset64'
+        # because osmium needs a custom zlib that is different that what is statically linked inside node and available on default ubuntu (which don't have gzoffset64`
+        '<(module_root_dir)/mason_packages/.link/lib/libz.a'
+      ],
+      'cflags': [
+          '<@(system_includes)'
+      ],
+      'defines': [
+          'BOOST_MATH_DISABLE_FLOAT128=1'
+      ],
+      'ldflags': [
+        '-Wl,-z,now',
+      ],
+      'xcode_settings': {
+        'OTHER_LDFLAGS':[
+          '-Wl,-bind_at_load'
+        ],
+        'OTHER_CPLUSPLUSFLAGS': [
+            '<@(system_includes)'
+        ],
+        'GCC_ENABLE_CPP_RTTI': 'YES',
+        'GCC_ENABLE_CPP_EXCEPTIONS': 'YES',
+        'MACOSX_DEPLOYMENT_TARGET':'10.8',
+        'CLANG_CXX_LIBRARY': 'libc++',
+        'CLANG_CXX_LANGUAGE_STANDARD':'c++14',
+        'GCC_VERSION': 'com.apple.compilers.llvm.clang.1_0'
+      }
+    },
+    {
+      'target_name': 'bench-csv',
+      'dependencies': [ 'annotator' ],
+      'type': 'executable',
+      'sources': [ './test/bench-csv.cpp' ],
+      'include_dirs': [ 'src/' ],
+      'conditions': [
+        ['error_on_warnings == "true"', {
+            'cflags_cc' : [ '-Werror' ],
+            'xcode_settings': {
+              'OTHER_CPLUSPLUSFLAGS': [ '-Werror' ]
+            }
+        }]
+      ],
+      "libraries": [
+        '<(module_root_dir)/mason_packages/.link/lib/libbz2.a',
+        '<(module_root_dir)/mason_packages/.link/lib/libexpat.a',
+        '<(module_root_dir)/mason_packages/.link/lib/libboost_iostreams.a',
+        # we link to zlib here to fix this error: ../src/extractor.cpp:(.text._ZN6osmium2io16GzipDecompressor4readEv[_ZN6osmium2io16GzipDecompressor4readEv]+0x46): undefined reference to `gzoffset64'
+        # because osmium needs a custom zlib that is different that what is statically linked inside node and available on default ubuntu (which don't have gzoffset64`
+        '<(module_root_dir)/mason_packages/.link/lib/libz.a'
+      ],
+      'cflags': [
+          '<@(system_includes)'
+      ],
+      'defines': [
+          'BOOST_MATH_DISABLE_FLOAT128=1'
+      ],
+      'ldflags': [
+        '-Wl,-z,now',
+      ],
+      'xcode_settings': {
+        'OTHER_LDFLAGS':[
+          '-Wl,-bind_at_load'
+        ],
+        'OTHER_CPLUSPLUSFLAGS': [
+            '<@(system_includes)'
+        ],
+        'GCC_ENABLE_CPP_RTTI': 'YES',
+        'GCC_ENABLE_CPP_EXCEPTIONS': 'YES',
+        'MACOSX_DEPLOYMENT_TARGET':'10.8',
+        'CLANG_CXX_LIBRARY': 'libc++',
+        'CLANG_CXX_LANGUAGE_STANDARD':'c++14',
+        'GCC_VERSION': 'com.apple.compilers.llvm.clang.1_0'
+      }
+    },
+    {
+      'target_name': 'bench-way-speeds',
+      'dependencies': [ 'annotator' ],
+      'type': 'executable',
+      'sources': [ './test/bench-way-speeds.cpp' ],
+      'include_dirs': [ 'src/' ],
+      'conditions': [
+        ['error_on_warnings == "true"', {
+            'cflags_cc' : [ '-Werror' ],
+            'xcode_settings': {
+              'OTHER_CPLUSPLUSFLAGS': [ '-Werror' ]
+            }
+        }]
+      ],
+      "libraries": [
+        '<(module_root_dir)/mason_packages/.link/lib/libbz2.a',
+        '<(module_root_dir)/mason_packages/.link/lib/libexpat.a',
+        '<(module_root_dir)/mason_packages/.link/lib/libboost_iostreams.a',
+        # we link to zlib here to fix this error: ../src/extractor.cpp:(.text._ZN6osmium2io16GzipDecompressor4readEv[_ZN6osmium2io16GzipDecompressor4readEv]+0x46): undefined reference to `gzoffset64'
+        # because osmium needs a custom zlib that is different that what is statically linked inside node and available on default ubuntu (which don't have gzoffset64`
+        '<(module_root_dir)/mason_packages/.link/lib/libz.a'
+      ],
+      'cflags': [
+          '<@(system_includes)'
+      ],
+      'defines': [
+          'BOOST_MATH_DISABLE_FLOAT128=1'
+      ],
+      'ldflags': [
+        '-Wl,-z,now',
+      ],
+      'xcode_settings': {
+        'OTHER_LDFLAGS':[
+          '-Wl,-bind_at_load'
+        ],
+        'OTHER_CPLUSPLUSFLAGS': [
+            '<@(system_includes)'
+        ],
+        'GCC_ENABLE_CPP_RTTI': 'YES',
+        'GCC_ENABLE_CPP_EXCEPTIONS': 'YES',
+        'MACOSX_DEPLOYMENT_TARGET':'10.8',
+        'CLANG_CXX_LIBRARY': 'libc++',
+        'CLANG_CXX_LANGUAGE_STANDARD':'c++14',
+        'GCC_VERSION': 'com.apple.compilers.llvm.clang.1_0'
+      }
+    },
+    {
+      'target_name': 'bench-snapping',
+      'dependencies': [ 'annotator' ],
+      'type': 'executable',
+      'sources': [ './test/bench-snapping.cpp' ],
+      'include_dirs': [ 'src/' ],
+      'conditions': [
+        ['error_on_warnings == "true"', {
+            'cflags_cc' : [ '-Werror' ],
+            'xcode_settings': {
+              'OTHER_CPLUSPLUSFLAGS': [ '-Werror' ]
+            }
+        }]
+      ],
+      "libraries": [
+        '<(module_root_dir)/mason_packages/.link/lib/libbz2.a',
+        '<(module_root_dir)/mason_packages/.link/lib/libexpat.a',
+        '<(module_root_dir)/mason_packages/.link/lib/libboost_iostreams.a',
+        # we link to zlib here to fix this error: ../src/extractor.cpp:(.text._ZN6osmium2io16GzipDecompressor4readEv[_ZN6osmium2io16GzipDecompressor4readEv]+0x46): undefined reference to `gzoffset64'
+        # because osmium needs a custom zlib that is different that what is statically linked inside node and available on default ubuntu (which don't have gzoffset64`
+        '<(module_root_dir)/mason_packages/.link/lib/libz.a'
+      ],
+      'cflags': [
+          '<@(system_includes)'
+      ],
+      'defines': [
+          'BOOST_MATH_DISABLE_FLOAT128=1'
+      ],
+      'ldflags': [
+        '-Wl,-z,now',
+      ],
+      'xcode_settings': {
+        'OTHER_LDFLAGS':[
+          '-Wl,-bind_at_load'
+        ],
+        'OTHER_CPLUSPLUSFLAGS': [
+            '<@(system_includes)'
+        ],
+        'GCC_ENABLE_CPP_RTTI': 'YES',
+        'GCC_ENABLE_CPP_EXCEPTIONS': 'YES',
+        'MACOSX_DEPLOYMENT_TARGET':'10.8',
+        'CLANG_CXX_LIBRARY': 'libc++',
+        'CLANG_CXX_LANGUAGE_STANDARD':'c++14',
+        'GCC_VERSION': 'com.apple.compilers.llvm.clang.1_0'
+      }
+    },
     {
       'target_name': 'basic-tests',
       'dependencies': [ 'annotator' ],
@@ -156,9 +348,20 @@
       'sources': [
         './test/basic-tests.cpp',
         './test/basic/annotator.cpp',
+        './test/basic/batch_lookup.cpp',
+        './test/basic/bloom_filter.cpp',
         './test/basic/database.cpp',
+        './test/basic/edge_speed_map.cpp',
+        './test/basic/elias_fano.cpp',
         './test/basic/extractor.cpp',
-        './test/basic/rtree.cpp'
+        './test/basic/lru_cache.cpp',
+        './test/basic/parallel_load.cpp',
+        './test/basic/polyline.cpp',
+        './test/basic/rtree.cpp',
+        './test/basic/speed_csv.cpp',
+        './test/basic/speed_fallback.cpp',
+        './test/basic/speed_stats.cpp',
+        './test/basic/thread_pool.cpp'
       ],
       'include_dirs' : [
         'src/'
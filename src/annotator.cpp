@@ -1,57 +1,259 @@
 #include "annotator.hpp"
 #include "extractor.hpp"
+#include "thread_pool.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
+#include <limits>
+#include <unordered_map>
 
 // For boost RTree
 #include <boost/geometry.hpp>
 #include <boost/geometry/index/rtree.hpp>
 
 #include <boost/geometry/strategies/spherical/distance_haversine.hpp>
-//#include <boost/log/trivial.hpp>
+
+#include <boost/functional/hash.hpp>
+
+namespace
+{
+const double EARTH_RADIUS = 6372795.0;
+const double DEG_TO_RAD = 0.017453292519943295;
+const double RAD_TO_DEG = 57.29577951308232;
+const boost::geometry::strategy::distance::haversine<double> haversine(EARTH_RADIUS);
+
+// Calls f(begin, end) over [0, count), split into chunks of chunk_size that run on the
+// shared thread pool.  Runs everything on the calling thread if count doesn't exceed
+// chunk_size, or chunk_size is 0.
+template <typename F>
+void run_in_chunks(const std::size_t count, const std::size_t chunk_size, F &&f)
+{
+    if (chunk_size == 0 || count <= chunk_size)
+        return f(std::size_t{0}, count);
+
+    auto &pool = ThreadPool::shared();
+    pool.for_each_index((count + chunk_size - 1) / chunk_size, pool.size() + 1,
+                        [&](const std::size_t chunk) {
+                            const auto begin = chunk * chunk_size;
+                            f(begin, std::min(count, begin + chunk_size));
+                        });
+}
+} // namespace
 
 RouteAnnotator::RouteAnnotator(const Database &db) : db(db) {}
 
+RouteAnnotator::RouteAnnotator(const Database &db, const Options &options)
+    : db(db), options(options)
+{
+    if (options.route_cache_size > 0)
+    {
+        route_cache = std::make_unique<route_cache_t>(options.route_cache_size);
+    }
+    if (options.coordinate_cache_size > 0 && options.snap_candidates == 1)
+    {
+        coordinate_cache = std::make_unique<coordinate_cache_t>(options.coordinate_cache_size);
+    }
+}
+
 std::vector<internal_nodeid_t>
 RouteAnnotator::coordinates_to_internal(const std::vector<point_t> &points)
 {
-
-    static const boost::geometry::strategy::distance::haversine<double> haversine(6372795.0);
-    static const double MAX_DISTANCE = 5;
-
     if (!db.rtree)
         throw RtreeError("RTree is null - call build_rtree() on database before use");
 
-    std::vector<internal_nodeid_t> internal_nodeids;
-    for (const auto &point : points)
+    if (options.snap_candidates > 1)
+        return snap_to_connected(points);
+
+    // Every coordinate snaps on its own, so long inputs can be split anywhere
+    std::vector<internal_nodeid_t> internal_nodeids(points.size());
+    run_in_chunks(points.size(), options.parallel_chunk_size,
+                  [&](const std::size_t begin, const std::size_t end) {
+                      for (auto i = begin; i < end; ++i)
+                          internal_nodeids[i] = nearest_node(points[i]);
+                  });
+    return internal_nodeids;
+}
+
+internal_nodeid_t RouteAnnotator::nearest_node(const point_t &point) const
+{
+    if (!coordinate_cache)
+    {
+        // Find the nearest node within the snap radius, or an invalid value
+        // if this coordinate didn't match
+        const auto nearest = nearby_nodes(point, 1);
+        return nearest.empty() ? INVALID_INTERNAL_NODEID : nearest.front().node;
+    }
+
+    // Coordinates outside the world can't be keyed, and won't match anything anyway
+    if (!(std::abs(point.get<0>()) <= 180 && std::abs(point.get<1>()) <= 90))
+        return INVALID_INTERNAL_NODEID;
+
+    // Snap from the cell itself, so that every coordinate in it gets the same answer
+    const fixed_point_t cell{point};
+    const auto key = static_cast<std::uint64_t>(static_cast<std::uint32_t>(cell.lon)) << 32 |
+                     static_cast<std::uint32_t>(cell.lat);
+
+    internal_nodeid_t node;
+    if (coordinate_cache->get(key, node))
+        return node;
+
+    const auto nearest = nearby_nodes(cell.to_point(), 1);
+    node = nearest.empty() ? INVALID_INTERNAL_NODEID : nearest.front().node;
+    coordinate_cache->put(key, node);
+    return node;
+}
+
+std::vector<RouteAnnotator::Candidate>
+RouteAnnotator::nearby_nodes(const point_t &point, const std::size_t max_count) const
+{
+    // The index is planar over fixed point lon/lat, so search the box that covers
+    // the snap radius at this latitude, then pick the closest nodes inside it.
+    const double lon = point.get<0>();
+    const double lat = point.get<1>();
+    const double lat_radius = options.snap_radius / EARTH_RADIUS * RAD_TO_DEG;
+    const double lon_radius = lat_radius / std::max(std::cos(lat * DEG_TO_RAD), 1e-9);
+
+    // Round the box outwards so that nodes on its edge are never missed
+    const auto lower = [](const double degrees, const double limit) {
+        return static_cast<std::int32_t>(
+            std::floor(std::max(-limit, degrees) * COORDINATE_PRECISION));
+    };
+    const auto upper = [](const double degrees, const double limit) {
+        return static_cast<std::int32_t>(
+            std::ceil(std::min(limit, degrees) * COORDINATE_PRECISION));
+    };
+    const boost::geometry::model::box<fixed_point_t> search_box{
+        fixed_point_t{lower(lon - lon_radius, 180), lower(lat - lat_radius, 90)},
+        fixed_point_t{upper(lon + lon_radius, 180), upper(lat + lat_radius, 90)}};
+
+    std::vector<value_t> rtree_results;
+    db.rtree->query(boost::geometry::index::intersects(search_box),
+                    std::back_inserter(rtree_results));
+
+    // Rank the nodes inside the box in a local equirectangular projection, which
+    // is far more accurate than we need over a few metres, and only compute the
+    // haversine distance for the nodes we keep.  A little slack on the planar
+    // radius makes sure rounding never drops a node the exact test would accept.
+    const double lon_scale = std::cos(lat * DEG_TO_RAD);
+    const double origin_lon = lon * COORDINATE_PRECISION;
+    const double origin_lat = lat * COORDINATE_PRECISION;
+    const double planar_radius = lat_radius * COORDINATE_PRECISION * 1.01;
+    const double planar_radius_squared = planar_radius * planar_radius;
+
+    typedef std::pair<double, const value_t *> ranked_t;
+    std::vector<ranked_t> ranked;
+    ranked.reserve(std::min(rtree_results.size(), max_count));
+    const auto closer = [](const ranked_t &a, const ranked_t &b) { return a.first < b.first; };
+    for (const auto &result : rtree_results)
     {
-        std::vector<value_t> rtree_results;
-
-        // Search for the nearest point to the one supplied
-        db.rtree->query(boost::geometry::index::nearest(point, 1),
-                        std::back_inserter(rtree_results));
-
-        // If we got exactly one hit (we should), append it to our nodeids list, if it
-        // was within 1m
-        /*
-        BOOST_LOG_TRIVIAL(debug) << "Distance from " << point.get<0>() << "," << point.get<1>()
-                                 << " to  " << rtree_results[0].first.get<0>() << ","
-                                 << rtree_results[0].first.get<1>() << " is "
-                                 << boost::geometry::distance(point, rtree_results[0].first,
-                                                              haversine)
-                                 << "\n";
-        */
-        if (rtree_results.size() == 1 &&
-            boost::geometry::distance(point, rtree_results[0].first, haversine) < MAX_DISTANCE)
+        const double dx = (result.first.lon - origin_lon) * lon_scale;
+        const double dy = result.first.lat - origin_lat;
+        const ranked_t entry{dx * dx + dy * dy, &result};
+        if (entry.first > planar_radius_squared)
+            continue;
+
+        // Keep a max-heap of the closest max_count nodes seen so far
+        if (ranked.size() < max_count)
         {
-            internal_nodeids.push_back(rtree_results[0].second);
+            ranked.push_back(entry);
+            std::push_heap(ranked.begin(), ranked.end(), closer);
         }
-        // otherwise, insert a 0 value, this coordinate didn't match
-        else
+        else if (!ranked.empty() && closer(entry, ranked.front()))
         {
-            internal_nodeids.push_back(INVALID_INTERNAL_NODEID);
+            std::pop_heap(ranked.begin(), ranked.end(), closer);
+            ranked.back() = entry;
+            std::push_heap(ranked.begin(), ranked.end(), closer);
         }
     }
+    std::sort_heap(ranked.begin(), ranked.end(), closer);
+
+    std::vector<Candidate> candidates;
+    for (const auto &entry : ranked)
+    {
+        const auto &result = *entry.second;
+        const auto distance = boost::geometry::distance(point, result.first.to_point(), haversine);
+        if (distance < options.snap_radius)
+            candidates.push_back(Candidate{result.second, distance});
+    }
+    return candidates;
+}
+
+std::vector<internal_nodeid_t>
+RouteAnnotator::snap_to_connected(const std::vector<point_t> &points) const
+{
+    // Gather up to snap_candidates nodes within the radius for every coordinate
+    std::vector<std::vector<Candidate>> candidates(points.size());
+    for (std::size_t i = 0; i < points.size(); ++i)
+    {
+        candidates[i] = nearby_nodes(points[i], options.snap_candidates);
+    }
+
+    // Moving between two candidates that aren't a known node pair costs more than
+    // any difference in snapping distance, so connected combinations always win.
+    const double disconnected_penalty = 2 * options.snap_radius;
+    const auto transition_cost = [&](const internal_nodeid_t a, const internal_nodeid_t b) {
+        return (a == b || find_way(a, b) != db.pair_way_map.end()) ? 0. : disconnected_penalty;
+    };
+
+    std::vector<internal_nodeid_t> internal_nodeids(points.size(), INVALID_INTERNAL_NODEID);
+
+    // Coordinates without candidates split the route into independent stretches,
+    // each solved with a Viterbi pass over its candidates.
+    std::size_t start = 0;
+    while (start < points.size())
+    {
+        if (candidates[start].empty())
+        {
+            ++start;
+            continue;
+        }
+        auto end = start;
+        while (end < points.size() && !candidates[end].empty())
+            ++end;
+
+        std::vector<double> cost;
+        for (const auto &candidate : candidates[start])
+            cost.push_back(candidate.distance);
+
+        // backtrack[i][b] is the best predecessor candidate for candidate b of point i
+        std::vector<std::vector<std::size_t>> backtrack(end - start);
+        for (auto i = start + 1; i < end; ++i)
+        {
+            const auto &previous = candidates[i - 1];
+            const auto &current = candidates[i];
+            std::vector<double> next_cost(current.size(), std::numeric_limits<double>::max());
+            auto &best = backtrack[i - start];
+            best.resize(current.size(), 0);
+
+            for (std::size_t b = 0; b < current.size(); ++b)
+            {
+                for (std::size_t a = 0; a < previous.size(); ++a)
+                {
+                    const auto total = cost[a] + transition_cost(previous[a].node, current[b].node);
+                    if (total < next_cost[b])
+                    {
+                        next_cost[b] = total;
+                        best[b] = a;
+                    }
+                }
+                next_cost[b] += current[b].distance;
+            }
+            cost.swap(next_cost);
+        }
+
+        auto choice = static_cast<std::size_t>(
+            std::distance(cost.begin(), std::min_element(cost.begin(), cost.end())));
+        for (auto i = end; i-- > start;)
+        {
+            internal_nodeids[i] = candidates[i][choice].node;
+            if (i > start)
+                choice = backtrack[i - start][choice];
+        }
+
+        start = end;
+    }
+
     return internal_nodeids;
 }
 
@@ -78,30 +280,215 @@ RouteAnnotator::external_to_internal(const std::vector<external_nodeid_t> &exter
 
 annotated_route_t RouteAnnotator::annotateRoute(const std::vector<internal_nodeid_t> &route)
 {
-    annotated_route_t result;
+    if (!route_cache)
+        return annotate_uncached(route);
+
+    const auto key = boost::hash_range(route.begin(), route.end());
+
+    std::shared_ptr<const CachedRoute> cached;
+    if (route_cache->get(key, cached) && cached->route == route)
+        return cached->result;
+
+    auto entry = std::make_shared<CachedRoute>();
+    entry->route = route;
+    entry->result = annotate_uncached(route);
+    auto result = entry->result;
+    route_cache->put(key, std::move(entry));
+    return result;
+}
+
+annotated_runs_t RouteAnnotator::collapse_runs(const annotated_route_t &annotated)
+{
+    annotated_runs_t runs;
+    for (std::size_t i = 0; i < annotated.size(); ++i)
+    {
+        if (!runs.empty() && runs.back().way_id == annotated[i])
+            ++runs.back().count;
+        else
+            runs.push_back(way_run_t{annotated[i], static_cast<std::uint32_t>(i), 1});
+    }
+    return runs;
+}
+
+annotated_route_t
+RouteAnnotator::annotate_uncached(const std::vector<internal_nodeid_t> &route) const
+{
+    if (route.size() < 2)
+        return {};
+
+    annotated_route_t result(route.size() - 1);
+
+    // Segment i needs nodes i and i + 1, so chunks of segments overlap by one node
+    run_in_chunks(result.size(), options.parallel_chunk_size,
+                  [&](const std::size_t begin, const std::size_t end) {
+                      for (auto i = begin; i < end; ++i)
+                      {
+                          const auto way_id = find_way(route[i], route[i + 1]);
+                          if (way_id != db.pair_way_map.end())
+                          {
+                              result[i] = way_id->second.id;
+                          }
+                          else
+                          {
+                              result[i] = INVALID_WAYID;
+                          }
+                      }
+                  });
+    return result;
+}
+
+std::vector<std::unordered_map<std::string, double>>
+RouteAnnotator::aggregate_by_tags(const std::vector<internal_nodeid_t> &route,
+                                  const std::vector<std::string> &keys) const
+{
+    if (db.node_coordinates.empty())
+        throw RtreeError(
+            "Node coordinates are missing - call build_rtree() on database before use");
+
+    std::vector<std::unordered_map<std::string, double>> lengths(keys.size());
+    if (route.size() < 2)
+        return lengths;
+
+    // Strings can't be looked up by value once the database is compacted, so map each
+    // key string id we come across to its position in keys, or -1, the first time
+    std::unordered_map<stringid_t, int> key_positions;
+    const auto key_position = [&](const stringid_t key_id) {
+        const auto found = key_positions.find(key_id);
+        if (found != key_positions.end())
+            return found->second;
+        const auto position = std::find(keys.begin(), keys.end(), db.getstring(key_id));
+        const int result = position == keys.end() ? -1 : position - keys.begin();
+        key_positions.emplace(key_id, result);
+        return result;
+    };
 
-    for (std::size_t i = 0; i < route.size() - 1; i++)
+    const auto annotated = annotate_uncached(route);
+    for (std::size_t i = 0; i < annotated.size(); ++i)
     {
-        const auto way_id = [&]() {
-            if (route[i] < route[i + 1])
-            {
-                return db.pair_way_map.find(std::make_pair(route[i], route[i + 1]));
-            }
-            else
-            {
-                return db.pair_way_map.find(std::make_pair(route[i + 1], route[i]));
-            }
-        }();
-        if (way_id != db.pair_way_map.end())
+        const auto way_id = annotated[i];
+        if (way_id >= db.way_tag_ranges.size() || route[i] >= db.node_coordinates.size() ||
+            route[i + 1] >= db.node_coordinates.size())
+            continue;
+
+        const auto length = boost::geometry::distance(db.node_coordinates[route[i]].to_point(),
+                                                      db.node_coordinates[route[i + 1]].to_point(),
+                                                      haversine);
+
+        const auto range = db.way_tag_ranges[way_id];
+        for (auto t = range.first; t < range.second; ++t)
         {
-            result.push_back(way_id->second.id);
+            const auto position = key_position(db.key_value_pairs[t].first);
+            if (position >= 0)
+                lengths[position][db.getstring(db.key_value_pairs[t].second)] += length;
         }
-        else
+    }
+    return lengths;
+}
+
+std::vector<annotated_route_t>
+RouteAnnotator::fill_gaps(const std::vector<internal_nodeid_t> &route,
+                          const annotated_route_t &annotated,
+                          const std::size_t max_hops) const
+{
+    std::vector<annotated_route_t> filled(annotated.size());
+    for (std::size_t i = 0; i < annotated.size(); ++i)
+    {
+        if (annotated[i] != INVALID_WAYID || route[i] == INVALID_INTERNAL_NODEID ||
+            route[i + 1] == INVALID_INTERNAL_NODEID)
+            continue;
+
+        const auto path = find_path(route[i], route[i + 1], max_hops);
+        for (std::size_t j = 1; j < path.size(); ++j)
         {
-            result.push_back(INVALID_WAYID);
+            const auto way_id = find_way(path[j - 1], path[j])->second.id;
+            if (filled[i].empty() || filled[i].back() != way_id)
+                filled[i].push_back(way_id);
         }
     }
-    return result;
+    return filled;
+}
+
+const RouteAnnotator::NodeGraph &RouteAnnotator::node_graph() const
+{
+    std::call_once(graph_once, [this] {
+        std::size_t node_count = 0;
+        for (const auto &pair : db.pair_way_map)
+            node_count = std::max<std::size_t>(node_count, pair.first.second + 1);
+
+        // Count the degree of every node, turn the counts into offsets, then fill in
+        // the neighbours of both ends of every pair
+        graph.offsets.assign(node_count + 1, 0);
+        for (const auto &pair : db.pair_way_map)
+        {
+            ++graph.offsets[pair.first.first + 1];
+            ++graph.offsets[pair.first.second + 1];
+        }
+        for (std::size_t n = 0; n < node_count; ++n)
+            graph.offsets[n + 1] += graph.offsets[n];
+
+        graph.neighbours.resize(graph.offsets.back());
+        auto next = graph.offsets;
+        for (const auto &pair : db.pair_way_map)
+        {
+            graph.neighbours[next[pair.first.first]++] = pair.first.second;
+            graph.neighbours[next[pair.first.second]++] = pair.first.first;
+        }
+    });
+    return graph;
+}
+
+std::vector<internal_nodeid_t> RouteAnnotator::find_path(const internal_nodeid_t a,
+                                                         const internal_nodeid_t b,
+                                                         const std::size_t max_hops) const
+{
+    const auto &graph = node_graph();
+    const auto node_count = graph.offsets.size() - 1;
+    if (a == b || a >= node_count || b >= node_count)
+        return {};
+
+    // The node each visited node was reached from
+    std::unordered_map<internal_nodeid_t, internal_nodeid_t> parents{{a, a}};
+    std::vector<internal_nodeid_t> frontier{a};
+    std::vector<internal_nodeid_t> next_frontier;
+
+    for (std::size_t hop = 0; hop < max_hops && !frontier.empty(); ++hop)
+    {
+        next_frontier.clear();
+        for (const auto node : frontier)
+        {
+            for (auto n = graph.offsets[node]; n < graph.offsets[node + 1]; ++n)
+            {
+                const auto neighbour = graph.neighbours[n];
+                if (!parents.emplace(neighbour, node).second)
+                    continue;
+
+                if (neighbour == b)
+                {
+                    std::vector<internal_nodeid_t> path{b};
+                    while (path.back() != a)
+                        path.push_back(parents[path.back()]);
+                    std::reverse(path.begin(), path.end());
+                    return path;
+                }
+                next_frontier.push_back(neighbour);
+            }
+        }
+        frontier.swap(next_frontier);
+    }
+    return {};
+}
+
+std::unordered_map<internal_nodepair_t, way_storage_t>::const_iterator
+RouteAnnotator::find_way(const internal_nodeid_t a, const internal_nodeid_t b) const
+{
+    if (a < b)
+    {
+        return db.pair_way_map.find(std::make_pair(a, b));
+    }
+    else
+    {
+        return db.pair_way_map.find(std::make_pair(b, a));
+    }
 }
 
 std::string RouteAnnotator::get_tag_key(const std::size_t index)
@@ -109,6 +496,13 @@ std::string RouteAnnotator::get_tag_key(const std::size_t index)
     return db.getstring(db.key_value_pairs[index].first);
 }
 
+stringid_t RouteAnnotator::get_tag_key_id(const std::size_t index)
+{
+    return db.key_value_pairs[index].first;
+}
+
+std::string RouteAnnotator::get_string(const stringid_t id) { return db.getstring(id); }
+
 std::string RouteAnnotator::get_tag_value(const std::size_t index)
 {
     return db.getstring(db.key_value_pairs[index].second);
@@ -120,3 +514,21 @@ wayid_t RouteAnnotator::get_external_way_id(const wayid_t way_id)
 {
     return db.internal_to_external_way_id_map[way_id];
 }
+
+std::size_t RouteAnnotator::get_way_count() const { return db.way_tag_ranges.size(); }
+
+RouteAnnotator::CacheStats RouteAnnotator::get_cache_stats() const
+{
+    if (!route_cache)
+        return CacheStats{0, 0, 0, 0};
+    return CacheStats{route_cache->hits(), route_cache->misses(), route_cache->size(),
+                      route_cache->capacity()};
+}
+
+RouteAnnotator::CacheStats RouteAnnotator::get_coordinate_cache_stats() const
+{
+    if (!coordinate_cache)
+        return CacheStats{0, 0, 0, 0};
+    return CacheStats{coordinate_cache->hits(), coordinate_cache->misses(),
+                      coordinate_cache->size(), coordinate_cache->capacity()};
+}
@@ -1,9 +1,13 @@
 #pragma once
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "database.hpp"
+#include "lru_cache.hpp"
 #include "types.hpp"
 
 /**
@@ -14,16 +18,73 @@
 struct RouteAnnotator
 {
   public:
+    /**
+     * Tuning knobs for the annotator.  The defaults reproduce the
+     * plain, uncached behaviour.
+     */
+    struct Options
+    {
+        /**
+         * Maximum number of annotated routes to keep in the route cache.
+         * 0 disables the cache.
+         */
+        std::size_t route_cache_size = 0;
+
+        /**
+         * Coordinates are only snapped to nodes closer than this many metres.
+         */
+        double snap_radius = 5;
+
+        /**
+         * Number of nearby nodes considered for each coordinate.  With more
+         * than one, the combination of nodes that forms existing node pairs
+         * along the route is chosen, rather than just the closest node.
+         */
+        std::size_t snap_candidates = 1;
+
+        /**
+         * Maximum number of snapped coordinates to keep in the coordinate
+         * cache.  Coordinates are cached per 1e-7 degree cell, the
+         * precision of the coordinate index.  0 disables the cache, and it
+         * is only used with a single snap candidate, where a coordinate
+         * snaps independently of its neighbours.
+         */
+        std::size_t coordinate_cache_size = 0;
+
+        /**
+         * Routes and coordinate lists longer than this are split into
+         * chunks of this size that are processed in parallel on the shared
+         * ThreadPool.  0 processes everything on the calling thread.  Connected
+         * snapping (more than one snap candidate) always runs on the
+         * calling thread.
+         */
+        std::size_t parallel_chunk_size = 0;
+    };
+
+    /**
+     * Hit/miss counters for one of the caches
+     */
+    struct CacheStats
+    {
+        std::uint64_t hits;
+        std::uint64_t misses;
+        std::size_t size;
+        std::size_t capacity;
+    };
+
     /**
      * Constructs a route annotator.
      *
-     * @param osmfilename the name of the OSM file to load
+     * @param db the database to query
      */
     RouteAnnotator(const Database &db);
+    RouteAnnotator(const Database &db, const Options &options);
 
     /**
      * Convert a list of lon/lat coordinates into internal
-     * node ids.
+     * node ids.  If the annotator was configured with more than one snap
+     * candidate, the candidates for neighbouring coordinates are matched
+     * against each other so that connected nodes are preferred.
      *
      * @param points a vector of lon/lat coordinates
      * @return a vector of internal node ids.  Will return INVALID_INTERNAL_NODEID
@@ -42,7 +103,8 @@ struct RouteAnnotator
     external_to_internal(const std::vector<external_nodeid_t> &external_nodeids);
 
     /**
-     * Gets the tags for a route
+     * Gets the tags for a route.  If the route cache is enabled, a route
+     * that was annotated before is answered from the cache.
      *
      * @param route a list of connected internal node ids
      * @return a vector of way ids that each pair of nodes on the route touches,
@@ -50,6 +112,44 @@ struct RouteAnnotator
      */
     annotated_route_t annotateRoute(const std::vector<internal_nodeid_t> &route);
 
+    /**
+     * Collapses an annotated route into runs of identical way ids.
+     *
+     * @param annotated the way ids for each segment, as returned by annotateRoute
+     * @return one entry per run, with the index of its first segment and the
+     *     number of segments in it.  Unmatched segments form runs of INVALID_WAYID.
+     */
+    static annotated_runs_t collapse_runs(const annotated_route_t &annotated);
+
+    /**
+     * Sums up the length of a route per value of some tag keys.  Needs the
+     * node coordinates, which are only kept if the RTree was built.
+     *
+     * @param route a list of connected internal node ids
+     * @param keys the tag keys to group by
+     * @return for each key, the metres of the route on ways tagged with each
+     *     of its values.  Segments without a way or without the tag are left out.
+     */
+    std::vector<std::unordered_map<std::string, double>>
+    aggregate_by_tags(const std::vector<internal_nodeid_t> &route,
+                      const std::vector<std::string> &keys) const;
+
+    /**
+     * Looks for short paths across the unmatched segments of a route, for
+     * example where the route skipped intermediate nodes.  The node graph
+     * searched is built from the node pairs on first use.
+     *
+     * @param route the internal node ids that were annotated
+     * @param annotated the result of annotateRoute for the route
+     * @param max_hops the most node pairs a path across a gap may have
+     * @return for each segment, the way ids along the path with the fewest
+     *     hops between its nodes, with repeated way ids collapsed.  Empty for
+     *     matched segments and for gaps that couldn't be filled.
+     */
+    std::vector<annotated_route_t> fill_gaps(const std::vector<internal_nodeid_t> &route,
+                                             const annotated_route_t &annotated,
+                                             const std::size_t max_hops) const;
+
     /**
      * Gets the key part for a tag
      *
@@ -58,6 +158,24 @@ struct RouteAnnotator
      */
     std::string get_tag_key(const std::size_t index);
 
+    /**
+     * Gets the string id of the key part for a tag.  Keys repeat a lot
+     * between ways, so callers can use this to convert each distinct key
+     * only once.
+     *
+     * @param index the index for the tag
+     * @return the string id of the key, for use with get_string
+     */
+    stringid_t get_tag_key_id(const std::size_t index);
+
+    /**
+     * Gets a string by its string id
+     *
+     * @param id the string id
+     * @return the string
+     */
+    std::string get_string(const stringid_t id);
+
     /**
      * Gets the value part of a tag
      *
@@ -78,6 +196,21 @@ struct RouteAnnotator
 
     wayid_t get_external_way_id(const wayid_t way_id);
 
+    /**
+     * The number of ways in the database.  Valid way ids are below this.
+     */
+    std::size_t get_way_count() const;
+
+    /**
+     * Returns the route cache counters.  All zero if the cache is disabled.
+     */
+    CacheStats get_cache_stats() const;
+
+    /**
+     * Returns the coordinate cache counters.  All zero if the cache is disabled.
+     */
+    CacheStats get_coordinate_cache_stats() const;
+
     struct RtreeError final : std::runtime_error
     {
         using base = std::runtime_error;
@@ -85,6 +218,67 @@ struct RouteAnnotator
     };
 
   private:
+    // A cached annotation, together with the route it was computed for so
+    // that hash collisions can be detected
+    struct CachedRoute
+    {
+        std::vector<internal_nodeid_t> route;
+        annotated_route_t result;
+    };
+    typedef ShardedLRUCache<std::size_t, std::shared_ptr<const CachedRoute>> route_cache_t;
+    typedef ShardedLRUCache<std::uint64_t, internal_nodeid_t> coordinate_cache_t;
+
+    annotated_route_t annotate_uncached(const std::vector<internal_nodeid_t> &route) const;
+
+    // Finds the way for a pair of nodes, in either order
+    std::unordered_map<internal_nodepair_t, way_storage_t>::const_iterator
+    find_way(const internal_nodeid_t a, const internal_nodeid_t b) const;
+
+    // A node near a coordinate, and its distance in metres
+    struct Candidate
+    {
+        internal_nodeid_t node;
+        double distance;
+    };
+
+    // Finds up to max_count nodes within the snap radius of a point, closest first
+    std::vector<Candidate> nearby_nodes(const point_t &point, const std::size_t max_count) const;
+
+    // Node adjacency in compressed sparse row form: the neighbours of node n are
+    // neighbours[offsets[n]] up to neighbours[offsets[n + 1]]
+    struct NodeGraph
+    {
+        std::vector<std::size_t> offsets;
+        std::vector<internal_nodeid_t> neighbours;
+    };
+
+    // Builds the node graph on first use
+    const NodeGraph &node_graph() const;
+
+    // Breadth first search for the nodes of a path from a to b, empty if there is
+    // none within max_hops
+    std::vector<internal_nodeid_t> find_path(const internal_nodeid_t a,
+                                             const internal_nodeid_t b,
+                                             const std::size_t max_hops) const;
+
+    // Snaps a single coordinate to its nearest node, going through the coordinate cache
+    internal_nodeid_t nearest_node(const point_t &point) const;
+
+    // Snaps coordinates by picking the best connected combination of candidates
+    std::vector<internal_nodeid_t> snap_to_connected(const std::vector<point_t> &points) const;
+
     // This is where all the data lives
     const Database &db;
+
+    const Options options;
+
+    // Optional cache of annotated routes, keyed by a hash of the node sequence
+    std::unique_ptr<route_cache_t> route_cache;
+
+    // Optional cache of snapped coordinates, keyed by fixed point coordinate
+    std::unique_ptr<coordinate_cache_t> coordinate_cache;
+
+    // Only needed for gap filling, so built lazily
+    mutable std::once_flag graph_once;
+    mutable NodeGraph graph;
 };
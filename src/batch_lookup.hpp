@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Runs a sequence of independent lookups as a software pipeline, in the
+ * style of asynchronous memory access chaining (AMAC).
+ *
+ * A lookup that misses the cache stalls until its memory arrives, and a loop
+ * doing one lookup after another pays for every miss in turn.  Here the hash
+ * of each key is computed, and the memory it leads to prefetched, Window
+ * lookups before the lookup is resolved, so that up to Window cache misses
+ * are in flight at once.  Results are still resolved in order.
+ *
+ * @param count the number of lookups
+ * @param hash hash(i) computes the hash for lookup i
+ * @param prefetch prefetch(hash) issues prefetches for the memory a lookup touches
+ * @param resolve resolve(i, hash) does lookup i, once its memory should be cached
+ */
+template <std::size_t Window = 16, typename Hash, typename Prefetch, typename Resolve>
+void batch_lookup(const std::size_t count, Hash &&hash, Prefetch &&prefetch, Resolve &&resolve)
+{
+    static_assert(Window > 0 && (Window & (Window - 1)) == 0, "Window must be a power of two");
+
+    // Hashes of the lookups that have been prefetched but not resolved yet
+    std::array<std::uint64_t, Window> hashes;
+
+    const std::size_t lead = count < Window ? count : Window;
+    for (std::size_t i = 0; i < lead; ++i)
+    {
+        hashes[i] = hash(i);
+        prefetch(hashes[i]);
+    }
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const auto current = hashes[i & (Window - 1)];
+        if (i + Window < count)
+        {
+            auto &ahead = hashes[(i + Window) & (Window - 1)];
+            ahead = hash(i + Window);
+            prefetch(ahead);
+        }
+        resolve(i, current);
+    }
+}
@@ -0,0 +1,53 @@
+#include "binding_utils.hpp"
+
+#include <boost/numeric/conversion/cast.hpp>
+
+std::string parseNodeIds(const v8::Local<v8::Array> jsNodeIds,
+                         std::vector<external_nodeid_t> &nodeIds)
+{
+    // Guard against empty or one nodeId, for which nothing can be looked up
+    if (jsNodeIds->Length() < 2)
+        return "At least two node ids required";
+
+    nodeIds.resize(jsNodeIds->Length());
+    for (std::uint32_t i = 0; i < jsNodeIds->Length(); ++i)
+    {
+        const auto nodeIdValue = Nan::Get(jsNodeIds, i).ToLocalChecked();
+        if (!nodeIdValue->IsNumber())
+            return "Array of number type expected";
+
+        // Javascript has no UInt64 type, we have to go through floating point types.
+        // Only safe until Number.MAX_SAFE_INTEGER, which is 2^53-1, guard with checked cast.
+        try
+        {
+            nodeIds[i] =
+                boost::numeric_cast<external_nodeid_t>(Nan::To<double>(nodeIdValue).FromJust());
+        }
+        catch (const boost::numeric::bad_numeric_cast &e)
+        {
+            return e.what();
+        }
+    }
+    return std::string();
+}
+
+v8::Local<v8::Object> speedStatsToObject(const SpeedStats &stats)
+{
+    const auto speedValue = [&stats](const double speed) -> v8::Local<v8::Value> {
+        if (stats.valid == 0)
+            return Nan::Null();
+        return Nan::New<v8::Number>(speed);
+    };
+
+    auto result = Nan::New<v8::Object>();
+    Nan::Set(result, Nan::New("min").ToLocalChecked(), speedValue(stats.min));
+    Nan::Set(result, Nan::New("max").ToLocalChecked(), speedValue(stats.max));
+    Nan::Set(result, Nan::New("mean").ToLocalChecked(), speedValue(stats.mean));
+    Nan::Set(result, Nan::New("harmonicMean").ToLocalChecked(), speedValue(stats.harmonic_mean));
+    Nan::Set(result, Nan::New("coverage").ToLocalChecked(), Nan::New<v8::Number>(stats.coverage));
+    Nan::Set(result, Nan::New("valid").ToLocalChecked(),
+             Nan::New<v8::Number>(static_cast<double>(stats.valid)));
+    Nan::Set(result, Nan::New("total").ToLocalChecked(),
+             Nan::New<v8::Number>(static_cast<double>(stats.total)));
+    return result;
+}
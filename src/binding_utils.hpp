@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <nan.h>
+
+#include "speed_stats.hpp"
+#include "types.hpp"
+
+/**
+ * Reads a JS array of at least two node ids, as taken by the route methods
+ *
+ * @return an error message for a TypeError, or an empty string
+ */
+std::string parseNodeIds(const v8::Local<v8::Array> jsNodeIds,
+                         std::vector<external_nodeid_t> &nodeIds);
+
+/**
+ * Builds the JS object for route speed statistics, speeds are null if no segment had one
+ */
+v8::Local<v8::Object> speedStatsToObject(const SpeedStats &stats);
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * A blocked Bloom filter over 64 bit key hashes.
+ *
+ * All the bits for a key are set in a single 512 bit block, so a lookup
+ * touches one cache line instead of one per bit.  The speed maps put one in
+ * front of their hashtables: most of the node pairs of a route have no speed,
+ * and the filter answers those misses without probing the table.
+ */
+class BlockedBloomFilter
+{
+  public:
+    /**
+     * The size and expected accuracy of a filter
+     */
+    struct Stats
+    {
+        std::size_t keys;
+        std::size_t memory_bytes;
+        // Estimated from the bits actually set: the chance that a key that
+        // was never inserted is reported as present
+        double false_positive_rate;
+    };
+
+    /**
+     * Sizes the filter for a number of keys and clears it.
+     *
+     * @param key_count the number of keys that will be inserted
+     */
+    void reset(const std::size_t key_count)
+    {
+        keys = key_count;
+        const auto block_count = (key_count * BITS_PER_KEY + BLOCK_BITS - 1) / BLOCK_BITS;
+        blocks.assign(block_count, Block{});
+    }
+
+    /**
+     * Adds a key
+     *
+     * @param hash a well mixed hash of the key, see mix_hash
+     */
+    void insert(const std::uint64_t hash)
+    {
+        if (blocks.empty())
+            return;
+        auto &block = blocks[block_index(hash)];
+        auto bits = bit_source(hash);
+        for (std::size_t i = 0; i < PROBES; ++i, bits >>= 9)
+            block[(bits >> 6) & 7] |= std::uint64_t{1} << (bits & 63);
+    }
+
+    /**
+     * Checks whether a key may have been inserted.
+     *
+     * @param hash a well mixed hash of the key, see mix_hash
+     * @return false if the key was definitely never inserted
+     */
+    bool maybe_contains(const std::uint64_t hash) const
+    {
+        if (blocks.empty())
+            return false;
+        const auto &block = blocks[block_index(hash)];
+        auto bits = bit_source(hash);
+        for (std::size_t i = 0; i < PROBES; ++i, bits >>= 9)
+        {
+            if (!(block[(bits >> 6) & 7] & (std::uint64_t{1} << (bits & 63))))
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * Starts loading the block for a key into the cache, ahead of maybe_contains
+     */
+    void prefetch(const std::uint64_t hash) const
+    {
+        if (!blocks.empty())
+            __builtin_prefetch(blocks[block_index(hash)].data());
+    }
+
+    Stats stats() const
+    {
+        double false_positive_rate = 0;
+        for (const auto &block : blocks)
+        {
+            std::size_t set = 0;
+            for (const auto word : block)
+                set += __builtin_popcountll(word);
+            double block_rate = 1;
+            for (std::size_t i = 0; i < PROBES; ++i)
+                block_rate *= static_cast<double>(set) / BLOCK_BITS;
+            false_positive_rate += block_rate;
+        }
+        if (!blocks.empty())
+            false_positive_rate /= blocks.size();
+        return {keys, blocks.size() * sizeof(Block), false_positive_rate};
+    }
+
+    /**
+     * Finalizer from MurmurHash3, spreads the bits of a key over the whole hash
+     */
+    static std::uint64_t mix_hash(std::uint64_t key)
+    {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdull;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ull;
+        key ^= key >> 33;
+        return key;
+    }
+
+  private:
+    // About 1% false positives with 6 bits set per key
+    static constexpr std::size_t BITS_PER_KEY = 10;
+    static constexpr std::size_t PROBES = 6;
+    static constexpr std::size_t BLOCK_BITS = 512;
+
+    typedef std::array<std::uint64_t, BLOCK_BITS / 64> Block;
+
+    // Maps the upper half of the hash onto the blocks without a division
+    std::size_t block_index(const std::uint64_t hash) const
+    {
+        return static_cast<std::size_t>(((hash >> 32) * blocks.size()) >> 32);
+    }
+
+    // Bits for choosing positions in the block, independent of the block choice.  Each
+    // probe uses 9 bits, the multiplication makes the top 54 bits depend on the whole hash.
+    static std::uint64_t bit_source(const std::uint64_t hash)
+    {
+        return (hash * 0x9E3779B97F4A7C15ull) >> 10;
+    }
+
+    std::vector<Block> blocks;
+    std::size_t keys = 0;
+};
@@ -0,0 +1,67 @@
+#include "compressed_file.hpp"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <climits>
+#include <fstream>
+#include <stdexcept>
+
+Compression detect_compression(const char *first, const char *last)
+{
+    const auto length = last - first;
+    const auto magic = reinterpret_cast<const unsigned char *>(first);
+
+    if (length >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+        return Compression::Gzip;
+    if (length >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f &&
+        magic[3] == 0xfd)
+        return Compression::Zstd;
+    return Compression::None;
+}
+
+Compression detect_compression(const std::string &filename)
+{
+    char magic[4];
+    std::ifstream input(filename, std::ios::binary);
+    input.read(magic, sizeof(magic));
+    return detect_compression(magic, magic + input.gcount());
+}
+
+GzipFile::GzipFile(const std::string &filename_) : filename(filename_)
+{
+    file = gzopen(filename.c_str(), "rb");
+    if (file == nullptr)
+        throw std::runtime_error("Can't open " + filename);
+    // Fewer, larger reads of the compressed data
+    gzbuffer(file, 1 << 20);
+}
+
+GzipFile::~GzipFile() { gzclose(file); }
+
+std::size_t GzipFile::read(char *buffer, std::size_t size)
+{
+    std::size_t total = 0;
+    while (total < size)
+    {
+        const auto length = static_cast<unsigned>(std::min<std::size_t>(size - total, INT_MAX));
+        const auto count = gzread(file, buffer + total, length);
+        // zlib's messages start with the file name
+        if (count < 0)
+        {
+            int error;
+            throw std::runtime_error(std::string("Can't decompress ") + gzerror(file, &error));
+        }
+        if (count == 0)
+        {
+            // gzread also stops at the end of a truncated file, which gzerror reports
+            int error;
+            const auto message = gzerror(file, &error);
+            if (error != Z_OK)
+                throw std::runtime_error(std::string("Can't decompress ") + message);
+            break;
+        }
+        total += count;
+    }
+    return total;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// zlib's gzFile points to this, declared here so that this header doesn't need zlib.h
+struct gzFile_s;
+
+/**
+ * How a speed file is compressed
+ */
+enum class Compression
+{
+    None,
+    Gzip,
+    // Detected to report it, there's no zstd decompressor
+    Zstd
+};
+
+/**
+ * Detects the compression of a file from its magic bytes, whatever its extension
+ *
+ * @return Compression::None for files that can't be read, so that opening them
+ *     reports the error
+ */
+Compression detect_compression(const std::string &filename);
+
+/**
+ * Detects the compression of data in memory from its magic bytes
+ */
+Compression detect_compression(const char *first, const char *last);
+
+/**
+ * Reads a gzip compressed file, including files of several gzip members
+ */
+class GzipFile
+{
+  public:
+    /**
+     * @throws std::runtime_error if the file can't be opened
+     */
+    explicit GzipFile(const std::string &filename);
+    ~GzipFile();
+
+    GzipFile(const GzipFile &) = delete;
+    GzipFile &operator=(const GzipFile &) = delete;
+
+    /**
+     * Decompresses up to size bytes into buffer
+     *
+     * @return the number of bytes decompressed, less than size only at the end of the file
+     * @throws std::runtime_error if the data is corrupt or truncated
+     */
+    std::size_t read(char *buffer, std::size_t size);
+
+  private:
+    std::string filename;
+    gzFile_s *file;
+};
@@ -12,13 +12,30 @@ void Database::build_rtree()
                       boost::geometry::index::rtree<value_t, boost::geometry::index::rstar<8>>>(
                       used_nodes_list.begin(), used_nodes_list.end())
                 : nullptr;
+
+    if (createRTree)
+    {
+        std::vector<fixed_point_t> coordinates;
+        coordinates.reserve(used_nodes_list.size());
+        for (const auto &node : used_nodes_list)
+        {
+            if (node.second >= coordinates.size())
+                coordinates.resize(node.second + 1);
+            coordinates[node.second] = node.first;
+        }
+        node_coordinates.swap(coordinates);
+    }
+    std::vector<value_t>().swap(used_nodes_list);
 }
 
 void Database::compact()
 {
     // Tricks to free memory, swap out data with empty versions
     // This frees the memory.  shrink_to_fit doesn't guarantee that.
-    std::vector<value_t>().swap(used_nodes_list);
+    if (rtree_pending())
+        used_nodes_list.shrink_to_fit();
+    else
+        std::vector<value_t>().swap(used_nodes_list);
     std::unordered_map<std::string, std::uint32_t>().swap(string_index);
 
     // Hint that these data structures can be shrunk.
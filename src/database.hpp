@@ -18,6 +18,12 @@ struct Database
      * Only create RTree if explicitly told to
      */
     bool createRTree = false;
+    /**
+     * When set, the Extractor leaves the RTree unbuilt so that node id
+     * lookups can be served straight away; the caller builds it later
+     * with build_rtree(), e.g. on a background thread.
+     */
+    bool deferRTree = false;
     /**
      * A map of internal node id pairs to the way they belong to
      * TODO: support multiple ways???
@@ -41,6 +47,12 @@ struct Database
      */
     std::unique_ptr<boost::geometry::index::rtree<value_t, boost::geometry::index::rstar<8>>> rtree;
 
+    /**
+     * The location of every node, indexed by internal node id.  Only filled
+     * in when the RTree is created, used to measure route lengths.
+     */
+    std::vector<fixed_point_t> node_coordinates;
+
     /**
      * The map of external (OSM 64 bit) node ids to our internal
      * node ID values (32 bit, to save space)
@@ -65,14 +77,23 @@ struct Database
     std::string getstring(const stringid_t stringid) const;
 
     /**
-     * Builds the RTree. Needs to be called after
-     * all OSM data parsing has been added.
+     * Whether the RTree was requested but hasn't been built yet
+     */
+    bool rtree_pending() const { return createRTree && !rtree; }
+
+    /**
+     * Builds the RTree and node_coordinates, and releases the list of nodes
+     * they were built from.
+     * Needs to be called after all OSM data parsing has been added.  Only
+     * touches the RTree and the node list, so it may run on another thread
+     * while the rest of the database is being read.
      */
     void build_rtree();
     /**
      * Reclaims memory by discarding temporary data
      * and shrinking vectors that have auto-grown.  Needs to be called after
-     * all OSM data parsing has been added.
+     * all OSM data parsing has been added.  The node list is kept if the
+     * RTree still has to be built.
      */
     void compact();
 
@@ -0,0 +1,109 @@
+#include "edge_speed_map.hpp"
+#include "speed_csv.hpp"
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include <cmath>
+#include <iostream>
+
+EdgeSpeedMap::EdgeSpeedMap(std::shared_ptr<const Database> db_)
+    : db(std::move(db_)), forward_speeds(db->pair_way_map.size(), INVALID_SPEED),
+      backward_speeds(db->pair_way_map.size(), INVALID_SPEED)
+{
+}
+
+void EdgeSpeedMap::loadCSV(const std::string &input_filename)
+{
+    boost::iostreams::mapped_file_source mmap(input_filename);
+    auto first = speed_csv::parse_segment_speeds(
+        mmap.begin(), mmap.end(),
+        [this](const external_nodeid_t from, const external_nodeid_t to, const std::uint32_t speed,
+               const speed_csv::SpeedUnit unit) {
+            if (unit == speed_csv::SpeedUnit::None)
+                add(from, to, speed);
+            else
+                add_with_unit(from, to, speed, unit == speed_csv::SpeedUnit::Mph);
+        });
+    const auto last = mmap.end();
+
+    if (first != last)
+        throw std::runtime_error(speed_csv::parse_error(input_filename, mmap.begin(), first, last));
+}
+
+void EdgeSpeedMap::add_with_unit(const external_nodeid_t &from,
+                                 const external_nodeid_t &to,
+                                 const std::uint32_t &speed,
+                                 const bool &mph)
+{
+    add(from, to, speed_to_kph(speed, mph));
+}
+
+void EdgeSpeedMap::add(const external_nodeid_t &from,
+                       const external_nodeid_t &to,
+                       const std::uint64_t &speed)
+{
+    if (speed > INVALID_SPEED - 1)
+    {
+        std::cout << "CSV parsing failed.  From Node: " << std::to_string(from)
+                  << " To Node: " << std::to_string(to) << " Speed: " << std::to_string(speed)
+                  << std::endl;
+        return;
+    }
+
+    const auto internal_from = db->external_internal_map.find(from);
+    const auto internal_to = db->external_internal_map.find(to);
+    if (internal_from == db->external_internal_map.end() ||
+        internal_to == db->external_internal_map.end())
+    {
+        ++skipped_rows;
+        return;
+    }
+
+    const bool forward = internal_from->second < internal_to->second;
+    const auto pair = forward ? std::make_pair(internal_from->second, internal_to->second)
+                              : std::make_pair(internal_to->second, internal_from->second);
+    const auto found = db->pair_way_map.find(pair);
+    if (found == db->pair_way_map.end() || found->second.edge >= forward_speeds.size())
+    {
+        ++skipped_rows;
+        return;
+    }
+
+    (forward ? forward_speeds : backward_speeds)[found->second.edge] =
+        static_cast<segment_speed_t>(speed);
+}
+
+segment_speed_t EdgeSpeedMap::getValue(const internal_nodeid_t from,
+                                       const internal_nodeid_t to) const
+{
+    const bool forward = from < to;
+    const auto found = db->pair_way_map.find(forward ? std::make_pair(from, to)
+                                                    : std::make_pair(to, from));
+    if (found == db->pair_way_map.end() || found->second.edge >= forward_speeds.size())
+        return INVALID_SPEED;
+    return (forward ? forward_speeds : backward_speeds)[found->second.edge];
+}
+
+std::vector<segment_speed_t> EdgeSpeedMap::getValues(const std::vector<internal_nodeid_t> &route,
+                                                     annotated_route_t &way_ids) const
+{
+    const auto segment_count = route.size() < 2 ? 0 : route.size() - 1;
+    std::vector<segment_speed_t> speeds(segment_count, INVALID_SPEED);
+    way_ids.assign(segment_count, INVALID_WAYID);
+
+    for (std::size_t i = 0; i < segment_count; ++i)
+    {
+        const auto from = route[i];
+        const auto to = route[i + 1];
+        const bool forward = from < to;
+        const auto found = db->pair_way_map.find(forward ? std::make_pair(from, to)
+                                                        : std::make_pair(to, from));
+        if (found == db->pair_way_map.end())
+            continue;
+
+        way_ids[i] = found->second.id;
+        if (found->second.edge < forward_speeds.size())
+            speeds[i] = (forward ? forward_speeds : backward_speeds)[found->second.edge];
+    }
+    return speeds;
+}
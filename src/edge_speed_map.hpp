@@ -0,0 +1,84 @@
+#ifndef EDGE_SPEED_MAP_H
+#define EDGE_SPEED_MAP_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "database.hpp"
+#include "types.hpp"
+
+/**
+ * Segment speeds stored against the node pairs of a loaded Database.
+ *
+ * Where SegmentSpeedMap keeps its own hashtable keyed by OSM node id pairs,
+ * this looks node pairs up in Database::pair_way_map and keeps one speed
+ * per direction in arrays indexed by edge id.  A single lookup finds both the
+ * way and the speed for a node pair, and no keys are stored.  Rows for node
+ * pairs that aren't in the database are skipped.
+ */
+class EdgeSpeedMap
+{
+  public:
+    /**
+     * Constructs an empty map for the node pairs in a database, which the map
+     * keeps alive
+     */
+    explicit EdgeSpeedMap(std::shared_ptr<const Database> db);
+
+    /**
+     * Parses and loads a from,to,speed CSV file into the existing data
+     */
+    void loadCSV(const std::string &input_filename);
+
+    /**
+     * Gets the speed from one node to another.
+     *
+     * @return the speed, or INVALID_SPEED if the nodes aren't a node pair or
+     *     have no speed in this direction
+     */
+    segment_speed_t getValue(const internal_nodeid_t from, const internal_nodeid_t to) const;
+
+    /**
+     * Given a list of nodes, returns the speed for each sequential pair, and
+     * the way each pair belongs to.
+     *
+     * @param route a list of internal node ids
+     * @param way_ids receives the way id for each pair, or INVALID_WAYID
+     * @return the speed for each pair, or INVALID_SPEED
+     */
+    std::vector<segment_speed_t> getValues(const std::vector<internal_nodeid_t> &route,
+                                           annotated_route_t &way_ids) const;
+
+    /**
+     * The number of CSV rows that were skipped because their node pair isn't
+     * in the database
+     */
+    std::size_t skipped() const { return skipped_rows; }
+
+  private:
+    /**
+     * Adds a single to/from pair value with support for unit.
+     */
+    void add_with_unit(const external_nodeid_t &from,
+                       const external_nodeid_t &to,
+                       const std::uint32_t &speed,
+                       const bool &mph);
+
+    /**
+     * Adds a single to/from pair value in km/h
+     */
+    void
+    add(const external_nodeid_t &from, const external_nodeid_t &to, const std::uint64_t &speed);
+
+    std::shared_ptr<const Database> db;
+
+    // Speeds indexed by edge id.  Forward is from the lower to the higher internal node id, the
+    // order the node pair is stored in.
+    std::vector<segment_speed_t> forward_speeds;
+    std::vector<segment_speed_t> backward_speeds;
+
+    std::size_t skipped_rows = 0;
+};
+
+#endif
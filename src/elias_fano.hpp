@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * A non-decreasing sequence of integers in Elias-Fano encoding.
+ *
+ * Each value is split into low bits, stored as they are in a packed array,
+ * and high bits, stored in unary as gaps in a bit vector.  That takes about
+ * 2 + log2(universe / size) bits per value, and still allows reading any
+ * value and finding the first value not less than a key without decoding
+ * the sequence.  Samples of the positions of every SAMPLE_RATE-th one and
+ * zero bit bound the scans of the bit vector.
+ */
+class EliasFano
+{
+  public:
+    /**
+     * Encodes a sequence
+     *
+     * @param values non-decreasing values
+     */
+    explicit EliasFano(const std::vector<std::uint64_t> &values = {})
+    {
+        count = values.size();
+        if (count == 0)
+            return;
+
+        // The universe, values.back() + 1, shifted right by at least one bit, so that it doesn't
+        // overflow for the largest value
+        const auto back = values.back();
+        const auto universe_high = [back](const std::size_t bits) {
+            const auto below = ~std::uint64_t{0} >> (64 - bits);
+            return (back >> bits) + ((back & below) == below ? 1 : 0);
+        };
+        low_bits = 0;
+        while (low_bits < 63 && universe_high(low_bits + 1) >= count)
+            ++low_bits;
+
+        const auto high_size = count + (back >> low_bits) + 1;
+        high.assign((high_size + 63) / 64, 0);
+        low.assign((count * low_bits + 63) / 64 + 1, 0);
+
+        std::uint64_t previous = 0;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            // The bit vector is sized for the last value, so check before setting a bit
+            if (values[i] < previous || values[i] > back)
+                throw std::runtime_error("Elias-Fano values must be sorted");
+            previous = values[i];
+
+            const auto position = (values[i] >> low_bits) + i;
+            high[position / 64] |= std::uint64_t{1} << (position % 64);
+            if (i % SAMPLE_RATE == 0)
+                one_samples.push_back(position);
+            set_low(i, values[i]);
+        }
+
+        high_zeros = (back >> low_bits) + 1;
+        std::size_t zeros = 0;
+        for (std::size_t word_index = 0; word_index < high.size(); ++word_index)
+        {
+            auto word = ~high[word_index];
+            if (word_index == high.size() - 1 && high_size % 64 != 0)
+                word &= ~(~std::uint64_t{0} << (high_size % 64));
+            const auto set = static_cast<std::size_t>(__builtin_popcountll(word));
+            for (auto rank = zero_samples.size() * SAMPLE_RATE; rank < zeros + set;
+                 rank += SAMPLE_RATE)
+                zero_samples.push_back(word_index * 64 + select_in_word(word, rank - zeros));
+            zeros += set;
+        }
+    }
+
+    std::size_t size() const { return count; }
+
+    /**
+     * Gets the value at an index, which must be less than size()
+     */
+    std::uint64_t operator[](const std::size_t index) const
+    {
+        const auto position = select(one_samples, index, false);
+        return ((position - index) << low_bits) | get_low(index);
+    }
+
+    /**
+     * Finds the first value that isn't less than a key
+     *
+     * @param key the value to look for
+     * @param value receives the value found, or 0 if there's none
+     * @return the index of the value, or size() if all values are less than the key
+     */
+    std::size_t lower_bound(const std::uint64_t key, std::uint64_t &value) const
+    {
+        value = 0;
+        const auto key_high = key >> low_bits;
+        if (count == 0 || key_high >= high_zeros)
+            return count;
+
+        // Values with key's high bits start after the key_high-th zero
+        std::size_t position =
+            key_high == 0 ? 0 : select(zero_samples, key_high - 1, true) + 1;
+        std::size_t index = position - key_high;
+        const auto key_low = key & low_mask();
+        while (index < count && bit(position))
+        {
+            const auto low_value = get_low(index);
+            if (low_value >= key_low)
+            {
+                value = (key_high << low_bits) | low_value;
+                return index;
+            }
+            ++position;
+            ++index;
+        }
+        if (index < count)
+            value = (*this)[index];
+        return index;
+    }
+
+    std::size_t memory_bytes() const
+    {
+        return (high.size() + low.size() + one_samples.size() + zero_samples.size()) *
+               sizeof(std::uint64_t);
+    }
+
+  private:
+    static constexpr std::size_t SAMPLE_RATE = 256;
+
+    std::uint64_t low_mask() const
+    {
+        return low_bits == 0 ? 0 : (~std::uint64_t{0} >> (64 - low_bits));
+    }
+
+    bool bit(const std::size_t position) const
+    {
+        return high[position / 64] & (std::uint64_t{1} << (position % 64));
+    }
+
+    void set_low(const std::size_t index, const std::uint64_t value)
+    {
+        if (low_bits == 0)
+            return;
+        const auto position = index * low_bits;
+        const auto bits = value & low_mask();
+        low[position / 64] |= bits << (position % 64);
+        if (position % 64 + low_bits > 64)
+            low[position / 64 + 1] |= bits >> (64 - position % 64);
+    }
+
+    std::uint64_t get_low(const std::size_t index) const
+    {
+        if (low_bits == 0)
+            return 0;
+        const auto position = index * low_bits;
+        auto bits = low[position / 64] >> (position % 64);
+        if (position % 64 + low_bits > 64)
+            bits |= low[position / 64 + 1] << (64 - position % 64);
+        return bits & low_mask();
+    }
+
+    // Finds the position of the rank-th one (or zero) bit, starting from the closest sample
+    std::size_t select(const std::vector<std::uint64_t> &samples,
+                       const std::size_t rank,
+                       const bool zeros) const
+    {
+        std::size_t position = samples[rank / SAMPLE_RATE];
+        std::size_t remaining = rank % SAMPLE_RATE;
+
+        std::size_t word_index = position / 64;
+        auto word = zeros ? ~high[word_index] : high[word_index];
+        // Drop the bits before the sample
+        word &= ~std::uint64_t{0} << (position % 64);
+        while (true)
+        {
+            const auto set = static_cast<std::size_t>(__builtin_popcountll(word));
+            if (remaining < set)
+                break;
+            remaining -= set;
+            ++word_index;
+            word = zeros ? ~high[word_index] : high[word_index];
+        }
+        return word_index * 64 + select_in_word(word, remaining);
+    }
+
+    // The position of the rank-th set bit of a word, which must have more than rank bits set
+    static std::size_t select_in_word(std::uint64_t word, std::size_t rank)
+    {
+        for (; rank > 0; --rank)
+            word &= word - 1;
+        return __builtin_ctzll(word);
+    }
+
+    std::size_t count = 0;
+    std::size_t low_bits = 0;
+    // The number of zero bits in the high bits, one more than the largest high part
+    std::size_t high_zeros = 0;
+    std::vector<std::uint64_t> high;
+    std::vector<std::uint64_t> low;
+    std::vector<std::uint64_t> one_samples;
+    std::vector<std::uint64_t> zero_samples;
+};
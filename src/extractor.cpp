@@ -31,6 +31,17 @@ typedef osmium::index::map::SparseMemArray<osmium::unsigned_object_id_type, osmi
 // index_pos_type;
 typedef osmium::handler::NodeLocationsForWays<index_pos_type, index_neg_type> location_handler_type;
 
+namespace
+{
+// osmium already stores locations as fixed point with the same precision as the rtree
+fixed_point_t to_fixed_point(const osmium::Location &location)
+{
+    if (!location.valid())
+        throw osmium::invalid_location{"invalid location"};
+    return fixed_point_t{location.x(), location.y()};
+}
+} // namespace
+
 void Extractor::ParseTags(std::ifstream &tagfile)
 {
     std::string line;
@@ -42,7 +53,7 @@ void Extractor::ParseTags(std::ifstream &tagfile)
 
 void Extractor::SetupDatabase()
 {
-    if (db.createRTree)
+    if (db.createRTree && !db.deferRTree)
     {
         std::cout << "Constructing RTree ... " << std::flush;
         db.build_rtree();
@@ -253,9 +264,9 @@ void Extractor::way(const osmium::Way &way)
                     internal_a_id = db.external_internal_map.size();
                     if (db.createRTree)
                     {
-                        point_t a{external_a->location().lon(), external_a->location().lat()};
                         BOOST_ASSERT(db.used_nodes_list.size() == db.external_internal_map.size());
-                        db.used_nodes_list.emplace_back(a, internal_a_id);
+                        db.used_nodes_list.emplace_back(to_fixed_point(external_a->location()),
+                                                        internal_a_id);
                     }
                     db.external_internal_map.emplace(external_a_ref, internal_a_id);
                 }
@@ -270,9 +281,9 @@ void Extractor::way(const osmium::Way &way)
                     internal_b_id = db.external_internal_map.size();
                     if (db.createRTree)
                     {
-                        point_t b{external_b->location().lon(), external_b->location().lat()};
                         BOOST_ASSERT(db.used_nodes_list.size() == db.external_internal_map.size());
-                        db.used_nodes_list.emplace_back(b, internal_b_id);
+                        db.used_nodes_list.emplace_back(to_fixed_point(external_b->location()),
+                                                        internal_b_id);
                     }
                     db.external_internal_map.emplace(external_b_ref, internal_b_id);
                 }
@@ -284,14 +295,16 @@ void Extractor::way(const osmium::Way &way)
                 if (internal_a_id < internal_b_id)
                 {
                     // true here indicates storage is forward
+                    const auto edge_id = static_cast<edgeid_t>(db.pair_way_map.size());
                     db.pair_way_map.emplace(std::make_pair(internal_a_id, internal_b_id),
-                                            way_storage_t{way_id, true});
+                                            way_storage_t{way_id, true, edge_id});
                 }
                 else
                 {
                     // false here indicates storage is backward
+                    const auto edge_id = static_cast<edgeid_t>(db.pair_way_map.size());
                     db.pair_way_map.emplace(std::make_pair(internal_b_id, internal_a_id),
-                                            way_storage_t{way_id, false});
+                                            way_storage_t{way_id, false, edge_id});
                 }
             }
             catch (const osmium::invalid_location &e)
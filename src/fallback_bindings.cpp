@@ -0,0 +1,169 @@
+#include "fallback_bindings.hpp"
+#include "binding_utils.hpp"
+#include "nodejs_bindings.hpp"
+#include "segment_bindings.hpp"
+#include "speed_fallback.hpp"
+#include "way_bindings.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace
+{
+bool isInstanceOf(const v8::Local<v8::Value> value, const Nan::Persistent<v8::Function> &ctor)
+{
+    return value->IsObject() &&
+           value->InstanceOf(Nan::GetCurrentContext(), Nan::New(ctor)).FromMaybe(false);
+}
+} // namespace
+
+NAN_MODULE_INIT(SpeedFallbackLookup::Init)
+{
+    const auto whoami = Nan::New("SpeedFallbackLookup").ToLocalChecked();
+
+    auto fnTp = Nan::New<v8::FunctionTemplate>(New);
+    fnTp->SetClassName(whoami);
+    fnTp->InstanceTemplate()->SetInternalFieldCount(1);
+
+    SetPrototypeMethod(fnTp, "getRouteSpeeds", getRouteSpeeds);
+
+    const auto fn = Nan::GetFunction(fnTp).ToLocalChecked();
+    constructor().Reset(fn);
+
+    Nan::Set(target, whoami, fn);
+}
+
+SpeedFallbackLookup::~SpeedFallbackLookup()
+{
+    annotator.Reset();
+    segmentLookup.Reset();
+    wayLookup.Reset();
+}
+
+/**
+ * Combines an Annotator and the two speed lookups
+ * @function SpeedFallbackLookup
+ * @param {Annotator} annotator finds the way for a pair of nodes, and its maxspeed tag
+ * @param {SegmentSpeedLookup} segmentLookup the first choice for the speed of a pair of nodes
+ * @param {WaySpeedLookup} wayLookup the speed for the way, if there is no segment speed
+ */
+NAN_METHOD(SpeedFallbackLookup::New)
+{
+    if (info.Length() != 3 || !isInstanceOf(info[0], Annotator::constructor()) ||
+        !isInstanceOf(info[1], SegmentSpeedLookup::constructor()) ||
+        !isInstanceOf(info[2], WaySpeedLookup::constructor()))
+        return Nan::ThrowTypeError(
+            "Three arguments expected: Annotator, SegmentSpeedLookup, WaySpeedLookup");
+
+    if (info.IsConstructCall())
+    {
+        auto *const self = new SpeedFallbackLookup;
+        self->annotator.Reset(info[0].As<v8::Object>());
+        self->segmentLookup.Reset(info[1].As<v8::Object>());
+        self->wayLookup.Reset(info[2].As<v8::Object>());
+        self->Wrap(info.This());
+        info.GetReturnValue().Set(info.This());
+    }
+    else
+    {
+        return Nan::ThrowTypeError(
+            "Cannot call constructor as function, you need to use 'new' keyword");
+    }
+}
+
+/**
+ * Fetches the speed for pairs of nodes, from the segment speeds, the way speeds or the
+ * maxspeed tag of the way, whichever has one first
+ * @function getRouteSpeeds
+ * @param {array} nodes an array of node IDs to look up in pairs
+ * @param {function} callback receives the speeds, and the source of each speed: 0 for none,
+ *     1 for the segment speeds, 2 for the way speeds and 3 for the maxspeed tag
+ * @example
+ *   container.getRouteSpeeds([23,43,12],(err,speeds,sources) => {
+ *      console.log(speeds, sources);
+ *   });
+ */
+NAN_METHOD(SpeedFallbackLookup::getRouteSpeeds)
+{
+    auto *const self = Nan::ObjectWrap::Unwrap<SpeedFallbackLookup>(info.Holder());
+
+    if (info.Length() != 2 || !info[0]->IsArray() || !info[1]->IsFunction())
+        return Nan::ThrowTypeError("Two arguments expected: nodeIds (Array), Callback");
+
+    auto callback = info[1].As<v8::Function>();
+    std::vector<external_nodeid_t> nodes_to_query;
+    const auto error = parseNodeIds(info[0].As<v8::Array>(), nodes_to_query);
+    if (!error.empty())
+        return Nan::ThrowTypeError(error.c_str());
+
+    struct Worker final : Nan::AsyncWorker
+    {
+        using Base = Nan::AsyncWorker;
+
+        Worker(std::shared_ptr<Database> database_,
+               std::shared_ptr<SegmentSpeedMap> segments_,
+               std::shared_ptr<WaySpeedMap> ways_,
+               Nan::Callback *callback,
+               std::vector<external_nodeid_t> nodeIds)
+            : Base(callback, "annotator:speed.fallbackfromnodeids"), database{database_},
+              segments{segments_}, ways{ways_}, nodeIds(std::move(nodeIds))
+        {
+        }
+
+        void Execute() override
+        {
+            try
+            {
+                const SpeedFallback fallback(database.get(), segments.get(), ways.get());
+                result = fallback.getValues(nodeIds);
+            }
+            catch (const std::exception &e)
+            {
+                return SetErrorMessage(e.what());
+            }
+        }
+
+        void HandleOKCallback() override
+        {
+            Nan::HandleScope scope;
+
+            auto jsSpeeds = Nan::New<v8::Array>(result.speeds.size());
+            auto jsSources = Nan::New<v8::Array>(result.sources.size());
+
+            for (std::size_t i = 0; i < result.speeds.size(); ++i)
+            {
+                (void)Nan::Set(jsSpeeds, i, Nan::New<v8::Number>(result.speeds[i]));
+                (void)Nan::Set(jsSources, i,
+                               Nan::New<v8::Number>(static_cast<int>(result.sources[i])));
+            }
+
+            const auto argc = 3u;
+            v8::Local<v8::Value> argv[argc] = {Nan::Null(), jsSpeeds, jsSources};
+
+            callback->Call(argc, argv, async_resource);
+        }
+
+        std::shared_ptr<Database> database;
+        std::shared_ptr<SegmentSpeedMap> segments;
+        std::shared_ptr<WaySpeedMap> ways;
+        std::vector<external_nodeid_t> nodeIds;
+        FallbackSpeeds result;
+    };
+
+    // Take the data that is loaded right now, a later load swaps in new objects rather than
+    // changing these
+    auto *const annotator = Nan::ObjectWrap::Unwrap<Annotator>(Nan::New(self->annotator));
+    auto *const segmentLookup =
+        Nan::ObjectWrap::Unwrap<SegmentSpeedLookup>(Nan::New(self->segmentLookup));
+    auto *const wayLookup = Nan::ObjectWrap::Unwrap<WaySpeedLookup>(Nan::New(self->wayLookup));
+
+    Nan::AsyncQueueWorker(new Worker{annotator->database, segmentLookup->datamap,
+                                     wayLookup->datamap, new Nan::Callback{callback},
+                                     std::move(nodes_to_query)});
+}
+
+Nan::Persistent<v8::Function> &SpeedFallbackLookup::constructor()
+{
+    static Nan::Persistent<v8::Function> init;
+    return init;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <nan.h>
+
+class SpeedFallbackLookup : public Nan::ObjectWrap
+{
+  public:
+    static NAN_MODULE_INIT(Init);
+
+  private:
+    ~SpeedFallbackLookup();
+
+    static NAN_METHOD(New);
+
+    static NAN_METHOD(getRouteSpeeds);
+
+    static Nan::Persistent<v8::Function> &constructor(); // CPP Land
+
+    // The Annotator, SegmentSpeedLookup and WaySpeedLookup the speeds come from.  Their data
+    // is fetched on every call, so later loadOSMExtract and loadCSV calls are picked up.
+    Nan::Persistent<v8::Object> annotator;
+    Nan::Persistent<v8::Object> segmentLookup;
+    Nan::Persistent<v8::Object> wayLookup;
+};
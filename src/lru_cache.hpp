@@ -0,0 +1,124 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+/**
+ * A bounded, thread-safe least-recently-used cache.
+ *
+ * Entries are spread over a fixed number of independently locked shards so
+ * that concurrent lookups from the threadpool rarely contend on the same
+ * mutex.  Each shard evicts its own least recently used entry once it holds
+ * its share of the capacity, and the shares add up to the capacity.
+ */
+template <typename Key, typename Value, typename Hash = std::hash<Key>> class ShardedLRUCache
+{
+  public:
+    /**
+     * Constructs a cache.
+     *
+     * @param capacity the total number of entries the cache may hold
+     * @param shard_count the number of independently locked shards, rounded
+     *     up to a power of two, and down to at most capacity
+     */
+    ShardedLRUCache(const std::size_t capacity, const std::size_t shard_count = 16)
+        : total_capacity(capacity)
+    {
+        std::size_t count = 1;
+        while (count < shard_count && count * 2 <= capacity)
+            count <<= 1;
+        shard_mask = count - 1;
+        shards.reset(new Shard[count]);
+        for (std::size_t i = 0; i < count; ++i)
+            shards[i].capacity = capacity / count + (i < capacity % count ? 1 : 0);
+    }
+
+    /**
+     * Looks up a key, marking it as most recently used on a hit.
+     *
+     * @param key the key to look up
+     * @param value receives a copy of the cached value on a hit
+     * @return true if the key was found
+     */
+    bool get(const Key &key, Value &value)
+    {
+        auto &shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        const auto found = shard.index.find(key);
+        if (found == shard.index.end())
+        {
+            miss_count.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+        value = found->second->second;
+        hit_count.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * Inserts or replaces a value, evicting the least recently used entry of
+     * the shard if it is full.
+     */
+    void put(const Key &key, Value value)
+    {
+        auto &shard = shard_for(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        const auto found = shard.index.find(key);
+        if (found != shard.index.end())
+        {
+            found->second->second = std::move(value);
+            shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+            return;
+        }
+        if (shard.capacity == 0)
+            return;
+        if (shard.index.size() >= shard.capacity)
+        {
+            shard.index.erase(shard.entries.back().first);
+            shard.entries.pop_back();
+            entry_count.fetch_sub(1, std::memory_order_relaxed);
+        }
+        shard.entries.emplace_front(key, std::move(value));
+        shard.index.emplace(key, shard.entries.begin());
+        entry_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::uint64_t hits() const { return hit_count.load(std::memory_order_relaxed); }
+    std::uint64_t misses() const { return miss_count.load(std::memory_order_relaxed); }
+    std::size_t size() const { return entry_count.load(std::memory_order_relaxed); }
+    std::size_t capacity() const { return total_capacity; }
+
+  private:
+    typedef std::list<std::pair<Key, Value>> entry_list_t;
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::size_t capacity = 0;
+        entry_list_t entries;
+        std::unordered_map<Key, typename entry_list_t::iterator, Hash> index;
+    };
+
+    Shard &shard_for(const Key &key)
+    {
+        // Mix the hash so that the shard choice doesn't correlate with the
+        // bucket choice of the per-shard hash map.
+        const std::uint64_t h = static_cast<std::uint64_t>(Hash()(key)) * 0x9E3779B97F4A7C15ull;
+        return shards[(h >> 32) & shard_mask];
+    }
+
+    std::unique_ptr<Shard[]> shards;
+    std::size_t shard_mask;
+    std::size_t total_capacity;
+    std::atomic<std::uint64_t> hit_count{0};
+    std::atomic<std::uint64_t> miss_count{0};
+    std::atomic<std::size_t> entry_count{0};
+};
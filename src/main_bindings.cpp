@@ -1,3 +1,4 @@
+#include "fallback_bindings.hpp"
 #include "nodejs_bindings.hpp"
 #include "segment_bindings.hpp"
 #include "way_bindings.hpp"
@@ -7,6 +8,7 @@ NAN_MODULE_INIT(Init)
     Annotator::Init(target);
     SegmentSpeedLookup::Init(target);
     WaySpeedLookup::Init(target);
+    SpeedFallbackLookup::Init(target);
 }
 
 NODE_MODULE(route_annotator, Init)
@@ -1,16 +1,230 @@
 #include <cstdint>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
 
+#include "binding_utils.hpp"
 #include "extractor.hpp"
+#include "polyline.hpp"
 #include "types.hpp"
 
 #include "nodejs_bindings.hpp"
+#include "way_bindings.hpp"
 
 #include <boost/numeric/conversion/cast.hpp>
 
+namespace
+{
+// Reads a whole, non-negative number that fits a size_t.  Infinity, NaN and fractions are
+// rejected rather than truncated.
+bool toSize(const v8::Local<v8::Value> value, std::size_t &size)
+{
+    if (!value->IsNumber())
+        return false;
+    const auto number = Nan::To<double>(value).FromJust();
+    // 2^64 is the smallest double above the largest size_t
+    const auto limit = std::ldexp(1.0, std::numeric_limits<std::size_t>::digits);
+    if (!std::isfinite(number) || number < 0 || number >= limit || number != std::floor(number))
+        return false;
+    size = static_cast<std::size_t>(number);
+    return true;
+}
+
+// Builds a JS array of way ids, with null for segments that couldn't be matched
+v8::Local<v8::Array> wayIdsToArray(const annotated_route_t &wayIds)
+{
+    auto annotated = Nan::New<v8::Array>(wayIds.size());
+
+    for (std::size_t i{0}; i < wayIds.size(); ++i)
+    {
+        const auto wayId = wayIds[i];
+
+        if (wayId == INVALID_WAYID)
+            (void)Nan::Set(annotated, i, Nan::Null());
+        else
+            (void)Nan::Set(annotated, i, Nan::New<v8::Number>(wayIds[i]));
+    }
+    return annotated;
+}
+
+// Hands the way ids over to a Uint32Array without copying them.  The vector is
+// freed when the array is garbage collected.  Unmatched segments keep the
+// INVALID_WAYID sentinel.
+v8::Local<v8::Uint32Array> wayIdsToTypedArray(annotated_route_t wayIds)
+{
+    auto *const storage = new annotated_route_t(std::move(wayIds));
+    const auto length = storage->size();
+    const auto buffer =
+        Nan::NewBuffer(reinterpret_cast<char *>(storage->data()), length * sizeof(wayid_t),
+                       [](char *, void *hint) { delete static_cast<annotated_route_t *>(hint); },
+                       storage)
+            .ToLocalChecked();
+    return v8::Uint32Array::New(buffer.As<v8::Uint8Array>()->Buffer(), 0, length);
+}
+
+// Builds a JS array of [wayId, start, count] runs, with null for unmatched runs
+v8::Local<v8::Array> runsToArray(const annotated_runs_t &runs)
+{
+    auto annotated = Nan::New<v8::Array>(runs.size());
+
+    for (std::size_t i{0}; i < runs.size(); ++i)
+    {
+        auto run = Nan::New<v8::Array>(3);
+        if (runs[i].way_id == INVALID_WAYID)
+            (void)Nan::Set(run, 0, Nan::Null());
+        else
+            (void)Nan::Set(run, 0, Nan::New<v8::Number>(runs[i].way_id));
+        (void)Nan::Set(run, 1, Nan::New<v8::Number>(runs[i].start));
+        (void)Nan::Set(run, 2, Nan::New<v8::Number>(runs[i].count));
+        (void)Nan::Set(annotated, i, run);
+    }
+    return annotated;
+}
+
+// Hands the runs over to a Uint32Array of flat wayId, start, count triples without
+// copying them, like wayIdsToTypedArray
+v8::Local<v8::Uint32Array> runsToTypedArray(annotated_runs_t runs)
+{
+    static_assert(sizeof(way_run_t) == 3 * sizeof(std::uint32_t), "way_run_t must be packed");
+
+    auto *const storage = new annotated_runs_t(std::move(runs));
+    const auto length = storage->size() * 3;
+    const auto buffer =
+        Nan::NewBuffer(reinterpret_cast<char *>(storage->data()), length * sizeof(std::uint32_t),
+                       [](char *, void *hint) { delete static_cast<annotated_runs_t *>(hint); },
+                       storage)
+            .ToLocalChecked();
+    return v8::Uint32Array::New(buffer.As<v8::Uint8Array>()->Buffer(), 0, length);
+}
+
+// Builds a JS array with the way id of each matched segment, an array of way ids for each
+// gap that was filled, and null for the rest
+v8::Local<v8::Array> filledToArray(const annotated_route_t &wayIds,
+                                   const std::vector<annotated_route_t> &filled)
+{
+    auto annotated = Nan::New<v8::Array>(wayIds.size());
+
+    for (std::size_t i{0}; i < wayIds.size(); ++i)
+    {
+        if (wayIds[i] != INVALID_WAYID)
+            (void)Nan::Set(annotated, i, Nan::New<v8::Number>(wayIds[i]));
+        else if (filled[i].empty())
+            (void)Nan::Set(annotated, i, Nan::Null());
+        else
+            (void)Nan::Set(annotated, i, wayIdsToArray(filled[i]));
+    }
+    return annotated;
+}
+
+// The speed bound to an internal way id, INVALID_SPEED for unmatched segments or without speeds
+segment_speed_t boundSpeed(const std::vector<segment_speed_t> *waySpeeds, const wayid_t wayId)
+{
+    return waySpeeds && wayId < waySpeeds->size() ? (*waySpeeds)[wayId] : INVALID_SPEED;
+}
+
+// Looks up the bound speed of the way of each segment
+std::vector<segment_speed_t> boundSpeedsForWays(const std::vector<segment_speed_t> *waySpeeds,
+                                                const annotated_route_t &wayIds)
+{
+    std::vector<segment_speed_t> speeds(wayIds.size());
+    for (std::size_t i{0}; i < wayIds.size(); ++i)
+        speeds[i] = boundSpeed(waySpeeds, wayIds[i]);
+    return speeds;
+}
+
+// Looks up the bound speed of the way of each run
+std::vector<segment_speed_t> boundSpeedsForWays(const std::vector<segment_speed_t> *waySpeeds,
+                                                const annotated_runs_t &runs)
+{
+    std::vector<segment_speed_t> speeds(runs.size());
+    for (std::size_t i{0}; i < runs.size(); ++i)
+        speeds[i] = boundSpeed(waySpeeds, runs[i].way_id);
+    return speeds;
+}
+
+// Builds a JS array of speeds
+v8::Local<v8::Array> speedsToArray(const std::vector<segment_speed_t> &speeds)
+{
+    auto jsSpeeds = Nan::New<v8::Array>(speeds.size());
+    for (std::size_t i{0}; i < speeds.size(); ++i)
+        (void)Nan::Set(jsSpeeds, i, Nan::New<v8::Number>(speeds[i]));
+    return jsSpeeds;
+}
+
+// Hands the speeds over to a Uint8Array without copying them, like wayIdsToTypedArray
+v8::Local<v8::Uint8Array> speedsToTypedArray(std::vector<segment_speed_t> speeds)
+{
+    auto *const storage = new std::vector<segment_speed_t>(std::move(speeds));
+    const auto length = storage->size();
+    const auto buffer =
+        Nan::NewBuffer(
+            reinterpret_cast<char *>(storage->data()), length,
+            [](char *, void *hint) { delete static_cast<std::vector<segment_speed_t> *>(hint); },
+            storage)
+            .ToLocalChecked();
+    return buffer.As<v8::Uint8Array>();
+}
+
+bool isInstanceOf(const v8::Local<v8::Value> value, const Nan::Persistent<v8::Function> &ctor)
+{
+    return value->IsObject() &&
+           value->InstanceOf(Nan::GetCurrentContext(), Nan::New(ctor)).FromMaybe(false);
+}
+
+// Output options shared by the annotate methods
+struct OutputOptions
+{
+    bool runs = false;
+    std::uint32_t fillGaps = 0;
+    bool waySpeeds = false;
+};
+
+// Gap filling searches grow quickly with the number of hops
+const constexpr std::uint32_t MAX_FILL_GAPS_HOPS = 10;
+
+// Reads the output options, returns an error message if they are invalid
+const char *getOutputOptions(const v8::Local<v8::Object> options, OutputOptions &output)
+{
+    const auto runsValue = Nan::Get(options, Nan::New("runs").ToLocalChecked()).ToLocalChecked();
+    if (!runsValue->IsUndefined())
+    {
+        if (!runsValue->IsBoolean())
+            return "runs option should be a boolean";
+        output.runs = Nan::To<bool>(runsValue).FromJust();
+    }
+
+    const auto fillGapsValue =
+        Nan::Get(options, Nan::New("fillGaps").ToLocalChecked()).ToLocalChecked();
+    if (!fillGapsValue->IsUndefined())
+    {
+        std::size_t hops = 0;
+        if (!toSize(fillGapsValue, hops) || hops < 1 || hops > MAX_FILL_GAPS_HOPS)
+            return "fillGaps option should be a whole number of hops between 1 and 10";
+        output.fillGaps = static_cast<std::uint32_t>(hops);
+    }
+
+    const auto waySpeedsValue =
+        Nan::Get(options, Nan::New("waySpeeds").ToLocalChecked()).ToLocalChecked();
+    if (!waySpeedsValue->IsUndefined())
+    {
+        if (!waySpeedsValue->IsBoolean())
+            return "waySpeeds option should be a boolean";
+        output.waySpeeds = Nan::To<bool>(waySpeedsValue).FromJust();
+    }
+
+    if (output.runs && output.fillGaps > 0)
+        return "runs and fillGaps options can't be combined";
+    if (output.waySpeeds && output.fillGaps > 0)
+        return "waySpeeds and fillGaps options can't be combined";
+    return nullptr;
+}
+} // namespace
+
 NAN_MODULE_INIT(Annotator::Init)
 {
     const auto whoami = Nan::New("Annotator").ToLocalChecked();
@@ -22,7 +236,13 @@ NAN_MODULE_INIT(Annotator::Init)
     SetPrototypeMethod(fnTp, "loadOSMExtract", loadOSMExtract);
     SetPrototypeMethod(fnTp, "annotateRouteFromNodeIds", annotateRouteFromNodeIds);
     SetPrototypeMethod(fnTp, "annotateRouteFromLonLats", annotateRouteFromLonLats);
+    SetPrototypeMethod(fnTp, "aggregateRouteFromNodeIds", aggregateRouteFromNodeIds);
+    SetPrototypeMethod(fnTp, "loadSegmentSpeedCSV", loadSegmentSpeedCSV);
+    SetPrototypeMethod(fnTp, "getRouteSpeedsFromNodeIds", getRouteSpeedsFromNodeIds);
+    SetPrototypeMethod(fnTp, "bindWaySpeeds", bindWaySpeeds);
     SetPrototypeMethod(fnTp, "getAllTagsForWayId", getAllTagsForWayId);
+    SetPrototypeMethod(fnTp, "getTagsForWayIds", getTagsForWayIds);
+    SetPrototypeMethod(fnTp, "getCacheStats", getCacheStats);
 
     const auto fn = Nan::GetFunction(fnTp).ToLocalChecked();
 
@@ -34,36 +254,69 @@ NAN_MODULE_INIT(Annotator::Init)
 NAN_METHOD(Annotator::New)
 {
     bool coordinates = false;
+    RouteAnnotator::Options annotatorOptions;
     if (info.Length() != 0)
     {
         if (!info[0]->IsObject())
             return Nan::ThrowTypeError("Options should be an object");
         const auto options = info[0].As<v8::Object>();
-        auto tryParseCoordinates = Nan::Get(options, Nan::New("coordinates").ToLocalChecked());
-        if (!tryParseCoordinates.IsEmpty())
+        const auto names = Nan::GetOwnPropertyNames(options).ToLocalChecked();
+        for (std::uint32_t idx = 0; idx < names->Length(); ++idx)
         {
-            auto parsedCoords = tryParseCoordinates.ToLocalChecked();
-            if (parsedCoords->IsBoolean())
+            const auto name = Nan::Get(names, idx).ToLocalChecked();
+            const auto value = Nan::Get(options, name).ToLocalChecked();
+            const std::string key{*Nan::Utf8String(name)};
+
+            if (key == "coordinates")
+            {
+                if (!value->IsBoolean())
+                    return Nan::ThrowTypeError("Coordinates value should be a boolean");
+                coordinates = Nan::To<bool>(value).FromJust();
+            }
+            else if (key == "cacheSize")
+            {
+                if (!toSize(value, annotatorOptions.route_cache_size))
+                    return Nan::ThrowTypeError("cacheSize value should be a non-negative integer");
+            }
+            else if (key == "coordinateCacheSize")
+            {
+                if (!toSize(value, annotatorOptions.coordinate_cache_size))
+                    return Nan::ThrowTypeError(
+                        "coordinateCacheSize value should be a non-negative integer");
+            }
+            else if (key == "parallelChunkSize")
+            {
+                if (!toSize(value, annotatorOptions.parallel_chunk_size))
+                    return Nan::ThrowTypeError(
+                        "parallelChunkSize value should be a non-negative integer");
+            }
+            else if (key == "snapRadius")
+            {
+                const auto radius = value->IsNumber() ? Nan::To<double>(value).FromJust() : 0.0;
+                if (!(radius > 0) || !std::isfinite(radius))
+                    return Nan::ThrowTypeError(
+                        "snapRadius value should be a positive, finite number");
+                annotatorOptions.snap_radius = radius;
+            }
+            else if (key == "snapCandidates")
             {
-                coordinates = Nan::To<bool>(parsedCoords).FromJust();
+                if (!toSize(value, annotatorOptions.snap_candidates) ||
+                    annotatorOptions.snap_candidates < 1)
+                    return Nan::ThrowTypeError("snapCandidates value should be an integer >= 1");
             }
             else
             {
-                return Nan::ThrowTypeError("Coordinates value should be a boolean");
+                // we don't accept any other options
+                return Nan::ThrowError("Unrecognized annotator options");
             }
         }
-        else
-        {
-            // options object isn't empty, and it doesn't have a 'coordinates' option
-            // we don't accept any other options right now
-            return Nan::ThrowError("Unrecognized annotator options");
-        }
     }
 
     if (info.IsConstructCall())
     {
         auto *const self = new Annotator;
         self->createRTree = coordinates;
+        self->annotatorOptions = annotatorOptions;
         self->Wrap(info.This());
         info.GetReturnValue().Set(info.This());
     }
@@ -145,6 +398,53 @@ NAN_METHOD(Annotator::loadOSMExtract)
     if (osm_paths.empty())
         return Nan::ThrowError("No file paths found");
 
+    struct RTreeBuilder final : Nan::AsyncWorker
+    {
+        explicit RTreeBuilder(Annotator &self_, std::shared_ptr<Database> database_)
+            : Nan::AsyncWorker(nullptr, "annotator:osm.buildrtree"), self{self_},
+              database{std::move(database_)}
+        {
+            // Keep the annotator alive until the waiting requests have been handed over
+            SaveToPersistent("annotator", self.handle());
+        }
+
+        void Execute() override
+        {
+            try
+            {
+                database->build_rtree();
+            }
+            catch (const std::exception &e)
+            {
+                return SetErrorMessage(e.what());
+            }
+        }
+
+        void HandleOKCallback() override { release(); }
+
+        // Waiting requests fail on their own with the missing coordinate index
+        void HandleErrorCallback() override { release(); }
+
+        void release()
+        {
+            // A newer extract may have been loaded meanwhile, with requests waiting for its own
+            // build; only the requests made for this database are queued
+            if (self.database == database)
+                self.rtreePending = false;
+
+            auto &pending = self.pendingCoordinateWorkers;
+            const auto waiting = std::stable_partition(
+                pending.begin(), pending.end(),
+                [this](const auto &worker) { return worker.first != database; });
+            for (auto it = waiting; it != pending.end(); ++it)
+                Nan::AsyncQueueWorker(it->second);
+            pending.erase(waiting, pending.end());
+        }
+
+        Annotator &self;
+        std::shared_ptr<Database> database;
+    };
+
     struct OSMLoader final : Nan::AsyncWorker
     {
         explicit OSMLoader(Annotator &self_,
@@ -161,13 +461,11 @@ NAN_METHOD(Annotator::loadOSMExtract)
             try
             {
                 // Note: provide strong exception safety guarantee (rollback)
-                auto database = std::make_unique<Database>(self.createRTree);
+                database = std::make_shared<Database>(self.createRTree);
+                // Node id lookups don't need the coordinate index, don't make them wait for it
+                database->deferRTree = true;
                 Extractor extractor{osm_paths, *database, tag_path};
-                auto annotator = std::make_unique<RouteAnnotator>(*database);
-
-                // Transactionally swap (noexcept)
-                swap(self.database, database);
-                swap(self.annotator, annotator);
+                annotator = std::make_shared<RouteAnnotator>(*database, self.annotatorOptions);
             }
             catch (const std::exception &e)
             {
@@ -178,6 +476,19 @@ NAN_METHOD(Annotator::loadOSMExtract)
         void HandleOKCallback() override
         {
             Nan::HandleScope scope;
+
+            // Transactionally swap (noexcept).  This happens on the main thread so that
+            // requests never see a database whose coordinate index state is unknown.
+            swap(self.database, database);
+            swap(self.annotator, annotator);
+            // Speeds are stored per node pair and way of the old extract
+            self.edgeSpeeds.reset();
+            self.waySpeeds.reset();
+
+            self.rtreePending = self.database->rtree_pending();
+            if (self.rtreePending)
+                Nan::AsyncQueueWorker(new RTreeBuilder{self, self.database});
+
             const constexpr auto argc = 1u;
             v8::Local<v8::Value> argv[argc] = {Nan::Null()};
             callback->Call(argc, argv, async_resource);
@@ -186,6 +497,8 @@ NAN_METHOD(Annotator::loadOSMExtract)
         Annotator &self;
         std::vector<std::string> osm_paths;
         std::string tag_path;
+        std::shared_ptr<Database> database;
+        std::shared_ptr<RouteAnnotator> annotator;
     };
 
     auto *callback = info.Length() == 3 ? new Nan::Callback{info[2].As<v8::Function>()}
@@ -201,69 +514,109 @@ NAN_METHOD(Annotator::annotateRouteFromNodeIds)
     if (!self->database || !self->annotator)
         return Nan::ThrowError("No OSM data loaded");
 
-    if (info.Length() != 2 || !info[0]->IsArray() || !info[1]->IsFunction())
+    // Either (nodeIds, callback) or (nodeIds, options, callback)
+    const auto argc = info.Length();
+    if ((argc != 2 && argc != 3) ||
+        (!info[0]->IsArray() && !info[0]->IsFloat64Array() && !info[0]->IsBigUint64Array()) ||
+        !info[argc - 1]->IsFunction() || (argc == 3 && !info[1]->IsObject()))
         return Nan::ThrowTypeError("Array of node ids and callback expected");
 
-    const auto jsNodeIds = info[0].As<v8::Array>();
-
-    // Guard against empty or one nodeId for which no wayId can be assigned
-    if (jsNodeIds->Length() < 2)
-        return Nan::ThrowTypeError("At least two node ids required");
-
-    std::vector<external_nodeid_t> externalIds(jsNodeIds->Length());
-
-    for (std::size_t i{0}; i < jsNodeIds->Length(); ++i)
+    OutputOptions output;
+    if (argc == 3)
     {
-        const auto nodeIdValue = Nan::Get(jsNodeIds, i).ToLocalChecked();
-
-        if (!nodeIdValue->IsNumber())
-            return Nan::ThrowTypeError("Array of number type expected");
+        if (const auto error = getOutputOptions(info[1].As<v8::Object>(), output))
+            return Nan::ThrowTypeError(error);
+    }
 
-        // Javascript has no UInt64 type, we have to go through floating point types.
-        // Only safe until Number.MAX_SAFE_INTEGER, which is 2^53-1, guard with checked cast.
-        const auto nodeIdDouble = Nan::To<double>(nodeIdValue).FromJust();
+    std::vector<external_nodeid_t> externalIds;
+    const bool typedArray = !info[0]->IsArray();
+    if (typedArray && output.fillGaps > 0)
+        return Nan::ThrowTypeError("fillGaps option can't be used with typed arrays");
 
+    if (info[0]->IsBigUint64Array())
+    {
+        // Already 64 bit unsigned integers: a single copy
+        const Nan::TypedArrayContents<std::uint64_t> jsNodeIds(info[0]);
+        if (jsNodeIds.length() < 2)
+            return Nan::ThrowTypeError("At least two node ids required");
+        externalIds.assign(*jsNodeIds, *jsNodeIds + jsNodeIds.length());
+    }
+    else if (info[0]->IsFloat64Array())
+    {
+        const Nan::TypedArrayContents<double> jsNodeIds(info[0]);
+        if (jsNodeIds.length() < 2)
+            return Nan::ThrowTypeError("At least two node ids required");
+        externalIds.resize(jsNodeIds.length());
         try
         {
-            const auto nodeId = boost::numeric_cast<external_nodeid_t>(nodeIdDouble);
-            externalIds[i] = nodeId;
+            for (std::size_t i{0}; i < jsNodeIds.length(); ++i)
+                externalIds[i] = boost::numeric_cast<external_nodeid_t>((*jsNodeIds)[i]);
         }
         catch (const boost::numeric::bad_numeric_cast &e)
         {
             return Nan::ThrowError(e.what());
-        };
+        }
+    }
+    else
+    {
+        const auto error = parseNodeIds(info[0].As<v8::Array>(), externalIds);
+        if (!error.empty())
+            return Nan::ThrowTypeError(error.c_str());
     }
 
     struct WayIdsFromNodeIdsLoader final : Nan::AsyncWorker
     {
         explicit WayIdsFromNodeIdsLoader(Annotator &self_,
                                          Nan::Callback *callback,
-                                         std::vector<external_nodeid_t> externalIds_)
-            : Nan::AsyncWorker(callback, "annotator:osm.annotatefromnodeids"), self{self_},
-              externalIds{std::move(externalIds_)}
+                                         std::vector<external_nodeid_t> externalIds_,
+                                         bool typedArray_,
+                                         OutputOptions output_)
+            : Nan::AsyncWorker(callback, "annotator:osm.annotatefromnodeids"),
+              database{self_.database}, annotator{self_.annotator},
+              externalIds{std::move(externalIds_)}, typedArray{typedArray_}, output{output_},
+              waySpeeds{self_.waySpeeds}
         {
         }
 
         void Execute() override
         {
-            const auto internalIds = self.annotator->external_to_internal(externalIds);
-            wayIds = self.annotator->annotateRoute(internalIds);
+            // The way speeds are indexed by the way ids of the extract they were queued with,
+            // which stays alive even if OSM data is reloaded in the meantime
+            const auto internalIds = annotator->external_to_internal(externalIds);
+            wayIds = annotator->annotateRoute(internalIds);
+            if (output.runs)
+                wayRuns = RouteAnnotator::collapse_runs(wayIds);
+            else if (output.fillGaps > 0)
+                filled = annotator->fill_gaps(internalIds, wayIds, output.fillGaps);
+            if (output.waySpeeds)
+                speeds = output.runs ? boundSpeedsForWays(waySpeeds.get(), wayRuns)
+                                     : boundSpeedsForWays(waySpeeds.get(), wayIds);
         }
 
         void HandleOKCallback() override
         {
             Nan::HandleScope scope;
 
-            auto annotated = Nan::New<v8::Array>(wayIds.size());
+            v8::Local<v8::Value> annotated;
+            if (output.runs)
+                annotated = typedArray ? v8::Local<v8::Value>(runsToTypedArray(std::move(wayRuns)))
+                                       : runsToArray(wayRuns);
+            else if (output.fillGaps > 0)
+                annotated = filledToArray(wayIds, filled);
+            else if (typedArray)
+                annotated = wayIdsToTypedArray(std::move(wayIds));
+            else
+                annotated = wayIdsToArray(wayIds);
 
-            for (std::size_t i{0}; i < wayIds.size(); ++i)
+            if (output.waySpeeds)
             {
-                const auto wayId = wayIds[i];
-
-                if (wayId == INVALID_WAYID)
-                    (void)Nan::Set(annotated, i, Nan::Null());
-                else
-                    (void)Nan::Set(annotated, i, Nan::New<v8::Number>(wayIds[i]));
+                const constexpr auto argc = 3u;
+                v8::Local<v8::Value> argv[argc] = {
+                    Nan::Null(), annotated,
+                    typedArray ? v8::Local<v8::Value>(speedsToTypedArray(std::move(speeds)))
+                               : speedsToArray(speeds)};
+                callback->Call(argc, argv, async_resource);
+                return;
             }
 
             const constexpr auto argc = 2u;
@@ -272,13 +625,21 @@ NAN_METHOD(Annotator::annotateRouteFromNodeIds)
             callback->Call(argc, argv, async_resource);
         }
 
-        Annotator &self;
+        std::shared_ptr<Database> database;
+        std::shared_ptr<RouteAnnotator> annotator;
         std::vector<external_nodeid_t> externalIds;
+        bool typedArray;
+        OutputOptions output;
+        std::shared_ptr<std::vector<segment_speed_t>> waySpeeds;
         annotated_route_t wayIds;
+        annotated_runs_t wayRuns;
+        std::vector<annotated_route_t> filled;
+        std::vector<segment_speed_t> speeds;
     };
 
-    auto *callback = new Nan::Callback{info[1].As<v8::Function>()};
-    Nan::AsyncQueueWorker(new WayIdsFromNodeIdsLoader{*self, callback, std::move(externalIds)});
+    auto *callback = new Nan::Callback{info[argc - 1].As<v8::Function>()};
+    Nan::AsyncQueueWorker(
+        new WayIdsFromNodeIdsLoader{*self, callback, std::move(externalIds), typedArray, output});
 }
 
 NAN_METHOD(Annotator::annotateRouteFromLonLats)
@@ -288,48 +649,108 @@ NAN_METHOD(Annotator::annotateRouteFromLonLats)
     if (!self->database || !self->annotator)
         return Nan::ThrowError("No OSM data loaded");
 
-    if (info.Length() != 2 || !info[0]->IsArray() || !info[1]->IsFunction())
-        return Nan::ThrowTypeError("Array of [lon, lat] arrays and callback expected");
-
-    auto jsLonLats = info[0].As<v8::Array>();
+    // Either (coordinates, callback) or (coordinates, options, callback)
+    const auto argc = info.Length();
+    if ((argc != 2 && argc != 3) ||
+        (!info[0]->IsArray() && !info[0]->IsString() && !info[0]->IsFloat64Array()) ||
+        !info[argc - 1]->IsFunction() || (argc == 3 && !info[1]->IsObject()))
+        return Nan::ThrowTypeError(
+            "Array of [lon, lat] arrays (or an encoded polyline), and callback expected");
 
-    // Guard against empty or one coordinate for which no wayId can be assigned
-    if (jsLonLats->Length() < 2)
-        return Nan::ThrowTypeError("At least 2 coordinates must be supplied");
+    unsigned precision = 5;
+    OutputOptions output;
+    if (argc == 3)
+    {
+        const auto options = info[1].As<v8::Object>();
+        if (const auto error = getOutputOptions(options, output))
+            return Nan::ThrowTypeError(error);
+        const auto precisionValue =
+            Nan::Get(options, Nan::New("precision").ToLocalChecked()).ToLocalChecked();
+        if (!precisionValue->IsUndefined())
+        {
+            std::size_t digits = 0;
+            if (!toSize(precisionValue, digits) || (digits != 5 && digits != 6))
+                return Nan::ThrowTypeError("Polyline precision should be 5 or 6");
+            precision = static_cast<unsigned>(digits);
+        }
+    }
 
-    std::vector<point_t> coordinates(jsLonLats->Length());
+    std::vector<point_t> coordinates;
+    std::string polyline;
+    const bool typedArray = info[0]->IsFloat64Array();
+    if (typedArray && output.fillGaps > 0)
+        return Nan::ThrowTypeError("fillGaps option can't be used with typed arrays");
 
-    for (std::size_t i{0}; i < jsLonLats->Length(); ++i)
+    if (typedArray)
+    {
+        // Interleaved lon, lat, lon, lat, ..
+        const Nan::TypedArrayContents<double> jsLonLats(info[0]);
+        if (jsLonLats.length() % 2 != 0)
+            return Nan::ThrowTypeError("Float64Array of interleaved lon, lat values expected");
+        if (jsLonLats.length() < 4)
+            return Nan::ThrowTypeError("At least 2 coordinates must be supplied");
+
+        coordinates.resize(jsLonLats.length() / 2);
+        for (std::size_t i{0}; i < coordinates.size(); ++i)
+            coordinates[i] = {(*jsLonLats)[2 * i], (*jsLonLats)[2 * i + 1]};
+    }
+    else if (info[0]->IsString())
     {
-        auto lonLatValue = Nan::Get(jsLonLats, i).ToLocalChecked();
+        // Encoded polylines are decoded on the threadpool, not here
+        const Nan::Utf8String utf8String(info[0]);
+        if (!(*utf8String))
+            return Nan::ThrowError("Unable to convert to Utf8String");
+        polyline.assign(*utf8String, utf8String.length());
+    }
+    else
+    {
+        auto jsLonLats = info[0].As<v8::Array>();
+
+        // Guard against empty or one coordinate for which no wayId can be assigned
+        if (jsLonLats->Length() < 2)
+            return Nan::ThrowTypeError("At least 2 coordinates must be supplied");
+
+        coordinates.resize(jsLonLats->Length());
 
-        if (!lonLatValue->IsArray())
-            return Nan::ThrowTypeError("Array of [lon, lat] expected");
+        for (std::size_t i{0}; i < jsLonLats->Length(); ++i)
+        {
+            auto lonLatValue = Nan::Get(jsLonLats, i).ToLocalChecked();
+
+            if (!lonLatValue->IsArray())
+                return Nan::ThrowTypeError("Array of [lon, lat] expected");
 
-        auto lonLatArray = lonLatValue.As<v8::Array>();
+            auto lonLatArray = lonLatValue.As<v8::Array>();
 
-        if (lonLatArray->Length() != 2)
-            return Nan::ThrowTypeError("Array of [lon, lat] expected");
+            if (lonLatArray->Length() != 2)
+                return Nan::ThrowTypeError("Array of [lon, lat] expected");
 
-        const auto lonValue = Nan::Get(lonLatArray, 0).ToLocalChecked();
-        const auto latValue = Nan::Get(lonLatArray, 1).ToLocalChecked();
+            const auto lonValue = Nan::Get(lonLatArray, 0).ToLocalChecked();
+            const auto latValue = Nan::Get(lonLatArray, 1).ToLocalChecked();
 
-        if (!lonValue->IsNumber() || !latValue->IsNumber())
-            return Nan::ThrowTypeError("Array of two numbers [lon, lat] expected");
+            if (!lonValue->IsNumber() || !latValue->IsNumber())
+                return Nan::ThrowTypeError("Array of two numbers [lon, lat] expected");
 
-        const auto lon = Nan::To<double>(lonValue).FromJust();
-        const auto lat = Nan::To<double>(latValue).FromJust();
+            const auto lon = Nan::To<double>(lonValue).FromJust();
+            const auto lat = Nan::To<double>(latValue).FromJust();
 
-        coordinates[i] = {lon, lat};
+            coordinates[i] = {lon, lat};
+        }
     }
 
     struct WayIdsFromLonLatsLoader final : Nan::AsyncWorker
     {
         explicit WayIdsFromLonLatsLoader(Annotator &self_,
                                          Nan::Callback *callback,
-                                         std::vector<point_t> coordinates_)
-            : Nan::AsyncWorker(callback, "annotator:osm.annotatefromlonlats"), self{self_},
-              coordinates{std::move(coordinates_)}
+                                         std::vector<point_t> coordinates_,
+                                         std::string polyline_,
+                                         unsigned precision_,
+                                         bool typedArray_,
+                                         OutputOptions output_)
+            : Nan::AsyncWorker(callback, "annotator:osm.annotatefromlonlats"),
+              database{self_.database}, annotator{self_.annotator},
+              coordinates{std::move(coordinates_)}, polyline{std::move(polyline_)},
+              precision{precision_}, typedArray{typedArray_}, output{output_},
+              waySpeeds{self_.waySpeeds}
         {
         }
 
@@ -337,8 +758,23 @@ NAN_METHOD(Annotator::annotateRouteFromLonLats)
         {
             try
             {
-                const auto internalIds = self.annotator->coordinates_to_internal(coordinates);
-                wayIds = self.annotator->annotateRoute(internalIds);
+                if (coordinates.empty())
+                {
+                    coordinates = decode_polyline(polyline, precision);
+                    if (coordinates.size() < 2)
+                        return SetErrorMessage("At least 2 coordinates must be supplied");
+                }
+                // Runs on the extract it was made for, even if it waited for the coordinate index
+                // while OSM data was reloaded
+                const auto internalIds = annotator->coordinates_to_internal(coordinates);
+                wayIds = annotator->annotateRoute(internalIds);
+                if (output.runs)
+                    wayRuns = RouteAnnotator::collapse_runs(wayIds);
+                else if (output.fillGaps > 0)
+                    filled = annotator->fill_gaps(internalIds, wayIds, output.fillGaps);
+                if (output.waySpeeds)
+                    speeds = output.runs ? boundSpeedsForWays(waySpeeds.get(), wayRuns)
+                                         : boundSpeedsForWays(waySpeeds.get(), wayIds);
             }
             catch (const RouteAnnotator::RtreeError &e)
             {
@@ -354,16 +790,26 @@ NAN_METHOD(Annotator::annotateRouteFromLonLats)
         {
             Nan::HandleScope scope;
 
-            auto annotated = Nan::New<v8::Array>(wayIds.size());
+            v8::Local<v8::Value> annotated;
+            if (output.runs)
+                annotated = typedArray ? v8::Local<v8::Value>(runsToTypedArray(std::move(wayRuns)))
+                                       : runsToArray(wayRuns);
+            else if (output.fillGaps > 0)
+                annotated = filledToArray(wayIds, filled);
+            else if (typedArray)
+                annotated = wayIdsToTypedArray(std::move(wayIds));
+            else
+                annotated = wayIdsToArray(wayIds);
 
-            for (std::size_t i{0}; i < wayIds.size(); ++i)
+            if (output.waySpeeds)
             {
-                const auto wayId = wayIds[i];
-
-                if (wayId == INVALID_WAYID)
-                    (void)Nan::Set(annotated, i, Nan::Null());
-                else
-                    (void)Nan::Set(annotated, i, Nan::New<v8::Number>(wayIds[i]));
+                const constexpr auto argc = 3u;
+                v8::Local<v8::Value> argv[argc] = {
+                    Nan::Null(), annotated,
+                    typedArray ? v8::Local<v8::Value>(speedsToTypedArray(std::move(speeds)))
+                               : speedsToArray(speeds)};
+                callback->Call(argc, argv, async_resource);
+                return;
             }
 
             const constexpr auto argc = 2u;
@@ -372,13 +818,358 @@ NAN_METHOD(Annotator::annotateRouteFromLonLats)
             callback->Call(argc, argv, async_resource);
         }
 
-        Annotator &self;
+        std::shared_ptr<Database> database;
+        std::shared_ptr<RouteAnnotator> annotator;
         std::vector<point_t> coordinates;
+        std::string polyline;
+        unsigned precision;
+        bool typedArray;
+        OutputOptions output;
+        std::shared_ptr<std::vector<segment_speed_t>> waySpeeds;
         annotated_route_t wayIds;
+        annotated_runs_t wayRuns;
+        std::vector<annotated_route_t> filled;
+        std::vector<segment_speed_t> speeds;
+    };
+
+    auto *callback = new Nan::Callback{info[argc - 1].As<v8::Function>()};
+    auto *const worker = new WayIdsFromLonLatsLoader{*self, callback, std::move(coordinates),
+                                                     std::move(polyline), precision, typedArray,
+                                                     output};
+
+    // Wait for the coordinate index if it is still being built
+    if (self->rtreePending)
+        self->pendingCoordinateWorkers.emplace_back(self->database, worker);
+    else
+        Nan::AsyncQueueWorker(worker);
+}
+
+NAN_METHOD(Annotator::aggregateRouteFromNodeIds)
+{
+    auto *const self = Nan::ObjectWrap::Unwrap<Annotator>(info.Holder());
+
+    if (!self->database || !self->annotator)
+        return Nan::ThrowError("No OSM data loaded");
+
+    if (info.Length() != 3 || !info[0]->IsArray() || !info[1]->IsArray() ||
+        !info[2]->IsFunction())
+        return Nan::ThrowTypeError("Array of node ids, array of tag keys and callback expected");
+
+    std::vector<external_nodeid_t> externalIds;
+    const auto error = parseNodeIds(info[0].As<v8::Array>(), externalIds);
+    if (!error.empty())
+        return Nan::ThrowTypeError(error.c_str());
+
+    // Each key once, a repeated key would replace its lengths in the result
+    const auto jsKeys = info[1].As<v8::Array>();
+    std::vector<std::string> keys;
+    for (std::uint32_t i = 0; i < jsKeys->Length(); ++i)
+    {
+        const auto keyValue = Nan::Get(jsKeys, i).ToLocalChecked();
+        if (!keyValue->IsString())
+            return Nan::ThrowTypeError("Array of string tag keys expected");
+        const Nan::Utf8String utf8Key(keyValue);
+        std::string key(*utf8Key, utf8Key.length());
+        if (std::find(keys.begin(), keys.end(), key) == keys.end())
+            keys.push_back(std::move(key));
+    }
+
+    struct AggregateFromNodeIdsLoader final : Nan::AsyncWorker
+    {
+        explicit AggregateFromNodeIdsLoader(Annotator &self_,
+                                            Nan::Callback *callback,
+                                            std::vector<external_nodeid_t> externalIds_,
+                                            std::vector<std::string> keys_)
+            : Nan::AsyncWorker(callback, "annotator:osm.aggregatefromnodeids"),
+              database{self_.database}, annotator{self_.annotator},
+              externalIds{std::move(externalIds_)}, keys{std::move(keys_)}
+        {
+        }
+
+        void Execute() override
+        {
+            try
+            {
+                // Runs on the extract it was made for, even if it waited for the coordinate index
+                // while OSM data was reloaded
+                const auto internalIds = annotator->external_to_internal(externalIds);
+                lengths = annotator->aggregate_by_tags(internalIds, keys);
+            }
+            catch (const RouteAnnotator::RtreeError &e)
+            {
+                return SetErrorMessage("Annotator not created with coordinates support");
+            }
+            catch (const std::exception &e)
+            {
+                return SetErrorMessage(e.what());
+            }
+        }
+
+        void HandleOKCallback() override
+        {
+            Nan::HandleScope scope;
+
+            auto result = Nan::New<v8::Object>();
+            for (std::size_t i = 0; i < keys.size(); ++i)
+            {
+                auto values = Nan::New<v8::Object>();
+                for (const auto &value : lengths[i])
+                {
+                    Nan::Set(values, Nan::New(std::cref(value.first)).ToLocalChecked(),
+                             Nan::New<v8::Number>(value.second));
+                }
+                Nan::Set(result, Nan::New(std::cref(keys[i])).ToLocalChecked(), values);
+            }
+
+            const constexpr auto argc = 2u;
+            v8::Local<v8::Value> argv[argc] = {Nan::Null(), result};
+
+            callback->Call(argc, argv, async_resource);
+        }
+
+        std::shared_ptr<Database> database;
+        std::shared_ptr<RouteAnnotator> annotator;
+        std::vector<external_nodeid_t> externalIds;
+        std::vector<std::string> keys;
+        std::vector<std::unordered_map<std::string, double>> lengths;
+    };
+
+    auto *callback = new Nan::Callback{info[2].As<v8::Function>()};
+    auto *const worker =
+        new AggregateFromNodeIdsLoader{*self, callback, std::move(externalIds), std::move(keys)};
+
+    // Segment lengths come from the node coordinates, which are ready with the coordinate index
+    if (self->rtreePending)
+        self->pendingCoordinateWorkers.emplace_back(self->database, worker);
+    else
+        Nan::AsyncQueueWorker(worker);
+}
+
+NAN_METHOD(Annotator::loadSegmentSpeedCSV)
+{
+    auto *const self = Nan::ObjectWrap::Unwrap<Annotator>(info.Holder());
+
+    if (!self->database || !self->annotator)
+        return Nan::ThrowError("No OSM data loaded");
+
+    if (info.Length() != 2 || (!info[0]->IsString() && !info[0]->IsArray()) ||
+        !info[1]->IsFunction())
+        return Nan::ThrowTypeError("String (or array of strings) and callback expected");
+
+    std::vector<std::string> paths;
+
+    if (info[0]->IsString())
+    {
+        const Nan::Utf8String utf8String(info[0]);
+
+        if (!(*utf8String))
+            return Nan::ThrowError("Unable to convert to Utf8String");
+
+        paths.push_back({*utf8String, *utf8String + utf8String.length()});
+    }
+    else
+    {
+        auto arr = v8::Local<v8::Array>::Cast(info[0]);
+        if (arr->Length() < 1)
+            return Nan::ThrowTypeError("Array must contain at least one filename");
+
+        for (std::uint32_t idx = 0; idx < arr->Length(); ++idx)
+        {
+            const Nan::Utf8String utf8String(Nan::Get(arr, idx).ToLocalChecked());
+
+            if (!(*utf8String))
+                return Nan::ThrowError("Unable to convert to Utf8String");
+
+            paths.push_back({*utf8String, *utf8String + utf8String.length()});
+        }
+    }
+
+    struct EdgeSpeedLoader final : Nan::AsyncWorker
+    {
+        explicit EdgeSpeedLoader(Annotator &self_,
+                                 Nan::Callback *callback,
+                                 std::vector<std::string> paths_)
+            : Nan::AsyncWorker(callback, "annotator:speed.loadedges"), self{self_},
+              database{self_.database}, paths{std::move(paths_)}
+        {
+        }
+
+        void Execute() override
+        {
+            try
+            {
+                map = std::make_shared<EdgeSpeedMap>(database);
+                for (const auto &path : paths)
+                {
+                    map->loadCSV(path);
+                }
+            }
+            catch (const std::exception &e)
+            {
+                return SetErrorMessage(e.what());
+            }
+        }
+
+        void HandleOKCallback() override
+        {
+            Nan::HandleScope scope;
+
+            // The speeds belong to the node pairs of the extract they were loaded for
+            if (self.database != database)
+            {
+                v8::Local<v8::Value> argv[1] = {
+                    Nan::Error("OSM data was reloaded while loading segment speeds")};
+                callback->Call(1, argv, async_resource);
+                return;
+            }
+
+            swap(self.edgeSpeeds, map);
+            const constexpr auto argc = 1u;
+            v8::Local<v8::Value> argv[argc] = {Nan::Null()};
+            callback->Call(argc, argv, async_resource);
+        }
+
+        Annotator &self;
+        std::shared_ptr<Database> database;
+        std::vector<std::string> paths;
+        std::shared_ptr<EdgeSpeedMap> map;
+    };
+
+    auto *callback = new Nan::Callback{info[1].As<v8::Function>()};
+    Nan::AsyncQueueWorker(new EdgeSpeedLoader{*self, callback, std::move(paths)});
+}
+
+NAN_METHOD(Annotator::getRouteSpeedsFromNodeIds)
+{
+    auto *const self = Nan::ObjectWrap::Unwrap<Annotator>(info.Holder());
+
+    if (!self->database || !self->annotator)
+        return Nan::ThrowError("No OSM data loaded");
+
+    if (info.Length() != 2 || !info[0]->IsArray() || !info[1]->IsFunction())
+        return Nan::ThrowTypeError("Array of node ids and callback expected");
+
+    std::vector<external_nodeid_t> externalIds;
+    const auto error = parseNodeIds(info[0].As<v8::Array>(), externalIds);
+    if (!error.empty())
+        return Nan::ThrowTypeError(error.c_str());
+
+    struct SpeedsFromNodeIdsLoader final : Nan::AsyncWorker
+    {
+        explicit SpeedsFromNodeIdsLoader(Annotator &self_,
+                                         Nan::Callback *callback,
+                                         std::vector<external_nodeid_t> externalIds_)
+            : Nan::AsyncWorker(callback, "annotator:speed.speedsfromnodeids"),
+              database{self_.database}, annotator{self_.annotator}, edgeSpeeds{self_.edgeSpeeds},
+              externalIds{std::move(externalIds_)}
+        {
+        }
+
+        void Execute() override
+        {
+            // The speeds belong to the extract they were queued with, which stays alive even if
+            // OSM data is reloaded in the meantime
+            const auto internalIds = annotator->external_to_internal(externalIds);
+            if (edgeSpeeds)
+            {
+                speeds = edgeSpeeds->getValues(internalIds, wayIds);
+            }
+            else
+            {
+                wayIds = annotator->annotateRoute(internalIds);
+                speeds.assign(wayIds.size(), INVALID_SPEED);
+            }
+        }
+
+        void HandleOKCallback() override
+        {
+            Nan::HandleScope scope;
+
+            auto jsSpeeds = Nan::New<v8::Array>(speeds.size());
+            for (std::size_t i{0}; i < speeds.size(); ++i)
+                (void)Nan::Set(jsSpeeds, i, Nan::New<v8::Number>(speeds[i]));
+
+            const constexpr auto argc = 3u;
+            v8::Local<v8::Value> argv[argc] = {Nan::Null(), wayIdsToArray(wayIds), jsSpeeds};
+
+            callback->Call(argc, argv, async_resource);
+        }
+
+        std::shared_ptr<Database> database;
+        std::shared_ptr<RouteAnnotator> annotator;
+        std::shared_ptr<EdgeSpeedMap> edgeSpeeds;
+        std::vector<external_nodeid_t> externalIds;
+        annotated_route_t wayIds;
+        std::vector<segment_speed_t> speeds;
     };
 
     auto *callback = new Nan::Callback{info[1].As<v8::Function>()};
-    Nan::AsyncQueueWorker(new WayIdsFromLonLatsLoader{*self, callback, std::move(coordinates)});
+    Nan::AsyncQueueWorker(new SpeedsFromNodeIdsLoader{*self, callback, std::move(externalIds)});
+}
+
+NAN_METHOD(Annotator::bindWaySpeeds)
+{
+    auto *const self = Nan::ObjectWrap::Unwrap<Annotator>(info.Holder());
+
+    if (!self->database || !self->annotator)
+        return Nan::ThrowError("No OSM data loaded");
+
+    if (info.Length() != 2 || !isInstanceOf(info[0], WaySpeedLookup::constructor()) ||
+        !info[1]->IsFunction())
+        return Nan::ThrowTypeError("WaySpeedLookup and callback expected");
+
+    const auto *const wayLookup =
+        Nan::ObjectWrap::Unwrap<WaySpeedLookup>(info[0].As<v8::Object>());
+
+    struct WaySpeedBinder final : Nan::AsyncWorker
+    {
+        explicit WaySpeedBinder(Annotator &self_,
+                                Nan::Callback *callback,
+                                std::shared_ptr<WaySpeedMap> ways_)
+            : Nan::AsyncWorker(callback, "annotator:speed.bindways"), self{self_},
+              database{self_.database}, ways{std::move(ways_)}
+        {
+        }
+
+        void Execute() override
+        {
+            // One speed per internal way id, in the order of the ids
+            const auto &externalWayIds = database->internal_to_external_way_id_map;
+            if (ways && !externalWayIds.empty())
+                speeds = std::make_shared<std::vector<segment_speed_t>>(
+                    ways->getValues(externalWayIds));
+            else
+                speeds = std::make_shared<std::vector<segment_speed_t>>(externalWayIds.size(),
+                                                                        INVALID_SPEED);
+        }
+
+        void HandleOKCallback() override
+        {
+            Nan::HandleScope scope;
+
+            // The speeds are indexed by the way ids of the extract they were bound to
+            if (self.database != database)
+            {
+                v8::Local<v8::Value> argv[1] = {
+                    Nan::Error("OSM data was reloaded while binding way speeds")};
+                callback->Call(1, argv, async_resource);
+                return;
+            }
+
+            swap(self.waySpeeds, speeds);
+            const constexpr auto argc = 1u;
+            v8::Local<v8::Value> argv[argc] = {Nan::Null()};
+            callback->Call(argc, argv, async_resource);
+        }
+
+        Annotator &self;
+        std::shared_ptr<Database> database;
+        std::shared_ptr<WaySpeedMap> ways;
+        std::shared_ptr<std::vector<segment_speed_t>> speeds;
+    };
+
+    auto *callback = new Nan::Callback{info[1].As<v8::Function>()};
+    Nan::AsyncQueueWorker(new WaySpeedBinder{*self, callback, wayLookup->datamap});
 }
 
 NAN_METHOD(Annotator::getAllTagsForWayId)
@@ -396,12 +1187,12 @@ NAN_METHOD(Annotator::getAllTagsForWayId)
     struct TagsForWayIdLoader final : Nan::AsyncWorker
     {
         explicit TagsForWayIdLoader(Annotator &self_, Nan::Callback *callback, wayid_t wayId_)
-            : Nan::AsyncWorker(callback, "annotator:osm.gettagsforids"), self{self_},
-              wayId{std::move(wayId_)}
+            : Nan::AsyncWorker(callback, "annotator:osm.gettagsforids"),
+              database{self_.database}, annotator{self_.annotator}, wayId{std::move(wayId_)}
         {
         }
 
-        void Execute() override { range = self.annotator->get_tag_range(wayId); }
+        void Execute() override { range = annotator->get_tag_range(wayId); }
 
         void HandleOKCallback() override
         {
@@ -411,15 +1202,15 @@ NAN_METHOD(Annotator::getAllTagsForWayId)
 
             for (auto i = range.first; i < range.second; ++i)
             {
-                const auto key = self.annotator->get_tag_key(i);
-                const auto value = self.annotator->get_tag_value(i);
+                const auto key = annotator->get_tag_key(i);
+                const auto value = annotator->get_tag_value(i);
 
                 Nan::Set(tags, Nan::New(std::cref(key)).ToLocalChecked(),
                          Nan::New(std::cref(value)).ToLocalChecked());
             }
 
             Nan::Set(tags, Nan::New("_way_id").ToLocalChecked(),
-                     Nan::New(std::to_string(self.annotator->get_external_way_id(wayId)))
+                     Nan::New(std::to_string(annotator->get_external_way_id(wayId)))
                          .ToLocalChecked());
 
             const constexpr auto argc = 2u;
@@ -428,7 +1219,8 @@ NAN_METHOD(Annotator::getAllTagsForWayId)
             callback->Call(argc, argv, async_resource);
         }
 
-        Annotator &self;
+        std::shared_ptr<Database> database;
+        std::shared_ptr<RouteAnnotator> annotator;
         wayid_t wayId;
         tagrange_t range;
     };
@@ -437,6 +1229,169 @@ NAN_METHOD(Annotator::getAllTagsForWayId)
     Nan::AsyncQueueWorker(new TagsForWayIdLoader{*self, callback, std::move(wayId)});
 }
 
+NAN_METHOD(Annotator::getTagsForWayIds)
+{
+    auto *const self = Nan::ObjectWrap::Unwrap<Annotator>(info.Holder());
+
+    if (!self->database || !self->annotator)
+        return Nan::ThrowError("No OSM data loaded");
+
+    if (info.Length() != 2 || !info[0]->IsArray() || !info[1]->IsFunction())
+        return Nan::ThrowTypeError("Array of way IDs and a callback expected");
+
+    const auto jsWayIds = info[0].As<v8::Array>();
+    std::vector<wayid_t> wayIds(jsWayIds->Length());
+
+    for (std::uint32_t i = 0; i < jsWayIds->Length(); ++i)
+    {
+        const auto wayIdValue = Nan::Get(jsWayIds, i).ToLocalChecked();
+        if (!wayIdValue->IsNumber())
+            return Nan::ThrowTypeError("Array of numeric way IDs expected");
+        wayIds[i] = Nan::To<wayid_t>(wayIdValue).FromJust();
+    }
+
+    struct TagsForWayIdsLoader final : Nan::AsyncWorker
+    {
+        explicit TagsForWayIdsLoader(Annotator &self_,
+                                     Nan::Callback *callback,
+                                     std::vector<wayid_t> wayIds_)
+            : Nan::AsyncWorker(callback, "annotator:osm.gettagsforwayids"),
+              database{self_.database}, annotator{self_.annotator}, wayIds{std::move(wayIds_)}
+        {
+        }
+
+        void Execute() override
+        {
+            // Resolve every distinct way once; repeated ids share the result
+            const auto wayCount = annotator->get_way_count();
+            slots.resize(wayIds.size());
+            std::unordered_map<wayid_t, std::size_t> seen;
+
+            for (std::size_t i = 0; i < wayIds.size(); ++i)
+            {
+                const auto wayId = wayIds[i];
+                if (wayId >= wayCount)
+                {
+                    slots[i] = INVALID_SLOT;
+                    continue;
+                }
+
+                const auto inserted = seen.emplace(wayId, ways.size());
+                slots[i] = inserted.first->second;
+                if (!inserted.second)
+                    continue;
+
+                ways.emplace_back();
+                auto &way = ways.back();
+                way.externalId = std::to_string(annotator->get_external_way_id(wayId));
+
+                const auto range = annotator->get_tag_range(wayId);
+                for (auto t = range.first; t < range.second; ++t)
+                {
+                    const auto keyId = annotator->get_tag_key_id(t);
+                    way.tags.emplace_back(keyId, annotator->get_tag_value(t));
+                    if (keys.find(keyId) == keys.end())
+                        keys.emplace(keyId, annotator->get_string(keyId));
+                }
+            }
+        }
+
+        void HandleOKCallback() override
+        {
+            Nan::HandleScope scope;
+            auto *const isolate = v8::Isolate::GetCurrent();
+
+            // Keys are shared by many ways: create each as an internalized string only once
+            std::unordered_map<stringid_t, v8::Local<v8::String>> jsKeys;
+            for (const auto &key : keys)
+            {
+                const auto jsKey =
+                    v8::String::NewFromUtf8(isolate, key.second.data(),
+                                            v8::NewStringType::kInternalized,
+                                            static_cast<int>(key.second.size()))
+                        .ToLocalChecked();
+                jsKeys.emplace(key.first, jsKey);
+            }
+            const auto jsWayIdKey = Nan::New("_way_id").ToLocalChecked();
+
+            std::vector<v8::Local<v8::Object>> jsWays;
+            jsWays.reserve(ways.size());
+            for (const auto &way : ways)
+            {
+                auto tags = Nan::New<v8::Object>();
+                for (const auto &tag : way.tags)
+                {
+                    Nan::Set(tags, jsKeys[tag.first],
+                             Nan::New(std::cref(tag.second)).ToLocalChecked());
+                }
+                Nan::Set(tags, jsWayIdKey, Nan::New(std::cref(way.externalId)).ToLocalChecked());
+                jsWays.push_back(tags);
+            }
+
+            auto results = Nan::New<v8::Array>(slots.size());
+            for (std::size_t i = 0; i < slots.size(); ++i)
+            {
+                if (slots[i] == INVALID_SLOT)
+                    (void)Nan::Set(results, i, Nan::Null());
+                else
+                    (void)Nan::Set(results, i, jsWays[slots[i]]);
+            }
+
+            const constexpr auto argc = 2u;
+            v8::Local<v8::Value> argv[argc] = {Nan::Null(), results};
+
+            callback->Call(argc, argv, async_resource);
+        }
+
+        struct WayTags
+        {
+            std::string externalId;
+            std::vector<std::pair<stringid_t, std::string>> tags;
+        };
+
+        const std::size_t INVALID_SLOT = std::numeric_limits<std::size_t>::max();
+
+        std::shared_ptr<Database> database;
+        std::shared_ptr<RouteAnnotator> annotator;
+        std::vector<wayid_t> wayIds;
+        // For every requested id, the index of its entry in `ways`
+        std::vector<std::size_t> slots;
+        std::vector<WayTags> ways;
+        std::unordered_map<stringid_t, std::string> keys;
+    };
+
+    auto *callback = new Nan::Callback{info[1].As<v8::Function>()};
+    Nan::AsyncQueueWorker(new TagsForWayIdsLoader{*self, callback, std::move(wayIds)});
+}
+
+NAN_METHOD(Annotator::getCacheStats)
+{
+    auto *const self = Nan::ObjectWrap::Unwrap<Annotator>(info.Holder());
+
+    if (!self->database || !self->annotator)
+        return Nan::ThrowError("No OSM data loaded");
+
+    const auto toObject = [](const RouteAnnotator::CacheStats &stats) {
+        auto result = Nan::New<v8::Object>();
+        Nan::Set(result, Nan::New("hits").ToLocalChecked(),
+                 Nan::New<v8::Number>(static_cast<double>(stats.hits)));
+        Nan::Set(result, Nan::New("misses").ToLocalChecked(),
+                 Nan::New<v8::Number>(static_cast<double>(stats.misses)));
+        Nan::Set(result, Nan::New("size").ToLocalChecked(),
+                 Nan::New<v8::Number>(static_cast<double>(stats.size)));
+        Nan::Set(result, Nan::New("capacity").ToLocalChecked(),
+                 Nan::New<v8::Number>(static_cast<double>(stats.capacity)));
+        return result;
+    };
+
+    // Route cache counters at the top level, coordinate cache counters nested
+    auto result = toObject(self->annotator->get_cache_stats());
+    Nan::Set(result, Nan::New("coordinates").ToLocalChecked(),
+             toObject(self->annotator->get_coordinate_cache_stats()));
+
+    info.GetReturnValue().Set(result);
+}
+
 Nan::Persistent<v8::Function> &Annotator::constructor()
 {
     static Nan::Persistent<v8::Function> init;
@@ -2,11 +2,13 @@
 
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include <nan.h>
 
 #include "annotator.hpp"
 #include "database.hpp"
+#include "edge_speed_map.hpp"
 
 class Annotator final : public Nan::ObjectWrap
 {
@@ -21,20 +23,61 @@ class Annotator final : public Nan::ObjectWrap
     /* Member function for Javascript object to parse and load the OSM extract */
     static NAN_METHOD(loadOSMExtract);
 
-    /* Member function for Javascript object: [nodeId, nodeId, ..] -> [wayId, wayId, ..] */
+    /* Member function for Javascript object: [nodeId, nodeId, ..] -> [wayId, wayId, ..]
+     * or, with {runs: true}: -> [[wayId, start, count], ..] */
     static NAN_METHOD(annotateRouteFromNodeIds);
 
-    /* Member function for Javascript object: [[lon, lat], [lon, lat]] -> [wayId, wayId, ..] */
+    /* Member function for Javascript object: [[lon, lat], [lon, lat]] -> [wayId, wayId, ..]
+     * or: encoded polyline -> [wayId, wayId, ..] */
     static NAN_METHOD(annotateRouteFromLonLats);
 
+    /* Member function for Javascript object: [nodeId, nodeId, ..], [key, ..]
+     * -> {key: {value: metres, ..}, ..} */
+    static NAN_METHOD(aggregateRouteFromNodeIds);
+
+    /* Member function for Javascript object to load segment speeds for the loaded extract */
+    static NAN_METHOD(loadSegmentSpeedCSV);
+
+    /* Member function for Javascript object: [nodeId, nodeId, ..]
+     * -> [wayId, wayId, ..], [speed, speed, ..] */
+    static NAN_METHOD(getRouteSpeedsFromNodeIds);
+
+    /* Member function for Javascript object to look up the speeds of a WaySpeedLookup for
+     * every way of the loaded extract, returned by the annotate methods with {waySpeeds: true} */
+    static NAN_METHOD(bindWaySpeeds);
+
     /* Member function for Javascript object: wayId -> [[key, value], [key, value]] */
     static NAN_METHOD(getAllTagsForWayId);
 
+    /* Member function for Javascript object: [wayId, wayId, ..] -> [{key: value}, ..] */
+    static NAN_METHOD(getTagsForWayIds);
+
+    /* Member function for Javascript object: () -> {hits, misses, size, capacity, coordinates} */
+    static NAN_METHOD(getCacheStats);
+
     /* Thread-safe singleton constructor */
     static Nan::Persistent<v8::Function> &constructor();
 
-    /* Wrapping Annotator; both database and annotator do not provide default ctor: wrap in ptr */
+    /* Wrapping Annotator; both database and annotator do not provide default ctor: wrap in ptr.
+     * Shared with the requests that need them to match the speeds they were queued with */
     bool createRTree = false;
-    std::unique_ptr<Database> database;
-    std::unique_ptr<RouteAnnotator> annotator;
+    RouteAnnotator::Options annotatorOptions;
+    std::shared_ptr<Database> database;
+    std::shared_ptr<RouteAnnotator> annotator;
+
+    /* Segment speeds stored against the node pairs of database, dropped when a new extract
+     * is loaded */
+    std::shared_ptr<EdgeSpeedMap> edgeSpeeds;
+
+    /* Way speeds indexed by internal way id of database, dropped when a new extract is loaded */
+    std::shared_ptr<std::vector<segment_speed_t>> waySpeeds;
+
+    /* The coordinate index is built in the background after loading; requests that need
+     * coordinates made in the meantime wait here, with the database they were made for, and are
+     * queued once its index is ready */
+    bool rtreePending = false;
+    std::vector<std::pair<std::shared_ptr<Database>, Nan::AsyncWorker *>> pendingCoordinateWorkers;
+
+    /* Reads the database to resolve speeds together with the speed lookups */
+    friend class SpeedFallbackLookup;
 };
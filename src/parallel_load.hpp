@@ -0,0 +1,298 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "compressed_file.hpp"
+#include "speed_csv.hpp"
+#include "thread_pool.hpp"
+
+/**
+ * Loads speed files on several threads.
+ *
+ * A file is cut into chunks at line starts, and each round parses one chunk
+ * per thread into rows of its own.  The rows of the round are then stored in
+ * the order of the chunks, so that a later row for the same key replaces an
+ * earlier one, as in a load on a single thread.  Rounds bound the memory held
+ * by parsed rows to a few chunks per thread.
+ *
+ * Gzip compressed files are decompressed in blocks, on a thread that works on
+ * the next block while the rows of one are loaded.
+ */
+namespace parallel_load
+{
+
+/**
+ * The number of threads to use for a requested count, 0 for one per worker of
+ * ThreadPool::shared(), which has one per hardware thread
+ */
+inline std::size_t thread_count(const std::size_t threads)
+{
+    if (threads > 0)
+        return threads;
+    return ThreadPool::shared().size();
+}
+
+/**
+ * The chunk size for a file of bytes, split evenly between the threads.  A
+ * chunk is at least MIN_CHUNK_BYTES so that it's worth a thread, and at most
+ * MAX_CHUNK_BYTES to bound the rows held per round.
+ */
+constexpr std::size_t MIN_CHUNK_BYTES = 64 << 10;
+constexpr std::size_t MAX_CHUNK_BYTES = 16 << 20;
+
+inline std::size_t chunk_bytes(const std::size_t bytes, const std::size_t threads)
+{
+    return std::min(MAX_CHUNK_BYTES, std::max(MIN_CHUNK_BYTES, (bytes + threads - 1) / threads));
+}
+
+/**
+ * Calls f(i) for each i in [0, count), on up to threads threads.  The calling
+ * thread takes part, with the workers of ThreadPool::shared(), so that loads
+ * running at once share a bounded number of threads.
+ */
+template <typename F> void for_each_index(const std::size_t count, std::size_t threads, F &&f)
+{
+    ThreadPool::shared().for_each_index(count, threads, std::forward<F>(f));
+}
+
+namespace detail
+{
+
+// The start of the first line that begins at least chunk_bytes after first, or last
+inline const char *next_chunk(const char *first, const char *last, const std::size_t chunk_bytes)
+{
+    if (static_cast<std::size_t>(last - first) <= chunk_bytes)
+        return last;
+    const auto newline = std::memchr(first + chunk_bytes, '\n', last - first - chunk_bytes);
+    if (newline == nullptr)
+        return last;
+    // Keep blank lines with the chunk before them, so that no chunk starts with a line break
+    auto position = static_cast<const char *>(newline) + 1;
+    while (position != last && (*position == '\n' || *position == '\r'))
+        ++position;
+    return position;
+}
+
+// The start of the last line that doesn't start with a line break, or first if there's none
+inline const char *last_row_start(const char *first, const char *last)
+{
+    for (auto position = last - (last != first); position > first; --position)
+    {
+        if (*(position - 1) == '\n' && *position != '\n' && *position != '\r')
+            return position;
+    }
+    return first;
+}
+
+// Whether [first, last) ends with a single line break, and not with a blank line
+inline bool ends_with_single_line_break(const char *first, const char *last)
+{
+    auto position = last;
+    while (position != first && (*(position - 1) == '\n' || *(position - 1) == '\r'))
+        --position;
+    return speed_csv::detail::parse_eol(position, last) && position == last;
+}
+
+} // namespace detail
+
+/**
+ * Parses and stores the rows of [first, last) on several threads
+ *
+ * A chunk that doesn't parse to its end may hold an invalid row, or be cut
+ * where a single threaded load wouldn't have accepted a line start: after a
+ * blank line, or inside the datasource of a way.  Everything from that chunk
+ * on is left to parse_rest, so that the rows stored and the position of an
+ * error are those of a single threaded load.
+ *
+ * @param threads the number of threads, see thread_count
+ * @param chunk_bytes the size a chunk grows to before it's cut at the next line, see
+ *     chunk_bytes
+ * @param parse_chunk parse_chunk(first, last, chunk) parses rows into a Chunk, and returns
+ *     where it stopped as the speed_csv parsers do.  Runs on several threads at once.
+ * @param store store(chunks, count) stores the rows of the first count chunks of a round
+ * @param parse_rest parse_rest(first, last) parses and stores the remaining rows on the
+ *     calling thread, and returns where it stopped
+ * @return the end of the input, or a position on the first invalid line
+ */
+template <typename Chunk, typename ParseChunk, typename Store, typename ParseRest>
+const char *load(const char *first,
+                 const char *last,
+                 std::size_t threads,
+                 const std::size_t chunk_bytes,
+                 ParseChunk &&parse_chunk,
+                 Store &&store,
+                 ParseRest &&parse_rest)
+{
+    threads = thread_count(threads);
+    if (threads == 1 || static_cast<std::size_t>(last - first) <= chunk_bytes)
+        return parse_rest(first, last);
+
+    std::vector<Chunk> chunks(threads);
+    std::vector<const char *> starts;
+    std::vector<const char *> stops(threads);
+    while (first != last)
+    {
+        starts.assign(1, first);
+        while (starts.size() <= threads && starts.back() != last)
+            starts.push_back(detail::next_chunk(starts.back(), last, chunk_bytes));
+        const auto count = starts.size() - 1;
+
+        for_each_index(count, threads, [&](const std::size_t i) {
+            chunks[i] = Chunk{};
+            stops[i] = parse_chunk(starts[i], starts[i + 1], chunks[i]);
+        });
+
+        std::size_t parsed = 0;
+        while (parsed < count && stops[parsed] == starts[parsed + 1] &&
+               (starts[parsed + 1] == last ||
+                detail::ends_with_single_line_break(starts[parsed], starts[parsed + 1])))
+            ++parsed;
+
+        store(chunks, parsed);
+        if (parsed < count)
+            return parse_rest(starts[parsed], last);
+        first = starts[count];
+    }
+    return first;
+}
+
+namespace detail
+{
+
+// The decompressed bytes per block of a gzip file
+constexpr std::size_t GZIP_BLOCK_BYTES = 32 << 20;
+
+template <typename Chunk, typename ParseChunk, typename Store, typename ParseRest>
+std::string load_gzip(const std::string &filename,
+                      const std::size_t threads,
+                      const std::size_t block_bytes,
+                      ParseChunk &parse_chunk,
+                      Store &store,
+                      ParseRest &parse_rest)
+{
+    GzipFile file(filename);
+    const auto read_block = [&file, block_bytes]() {
+        std::vector<char> block(block_bytes);
+        block.resize(file.read(block.data(), block.size()));
+        return block;
+    };
+
+    // The text that hasn't been loaded yet, which starts at a line, and the number of lines
+    // before it
+    std::vector<char> text;
+    std::size_t lines = 0;
+    bool end = false;
+    auto next = std::async(std::launch::async, read_block);
+    const auto append_block = [&]() {
+        const auto block = next.get();
+        end = block.size() < block_bytes;
+        if (!end)
+            next = std::async(std::launch::async, read_block);
+        text.insert(text.end(), block.begin(), block.end());
+    };
+    const auto parse_error = [&](const std::size_t stop) {
+        // The message has the whole line, which may continue in the next blocks
+        while (!end && std::find(text.begin() + stop, text.end(), '\n') == text.end())
+            append_block();
+        return speed_csv::parse_error(filename, text.data(), text.data() + stop,
+                                      text.data() + text.size(), lines);
+    };
+
+    while (true)
+    {
+        append_block();
+
+        // Rows up to the start of the last line, which may continue in the next block
+        const char *first = text.data();
+        const auto last = first + text.size();
+        const auto rows_end = end ? last : last_row_start(first, last);
+        const auto stop = load<Chunk>(first, rows_end, threads,
+                                      chunk_bytes(rows_end - first, threads), parse_chunk, store,
+                                      parse_rest);
+        if (stop != rows_end)
+            return parse_error(stop - first);
+        if (end)
+            return std::string();
+
+        // More rows follow, after a single line break and no blank lines
+        if (rows_end != first &&
+            (*first == '\n' || *first == '\r' || !ends_with_single_line_break(first, rows_end)))
+            return parse_error(rows_end - first);
+
+        lines += std::count(first, rows_end, '\n');
+        text.erase(text.begin(), text.begin() + (rows_end - first));
+    }
+}
+
+} // namespace detail
+
+/**
+ * Loads CSV data in memory with load()
+ *
+ * @param name the name of the data in error messages
+ * @return the message for the line that couldn't be parsed, or an empty string
+ * @throws std::runtime_error if the data is compressed
+ */
+template <typename Chunk, typename ParseChunk, typename Store, typename ParseRest>
+std::string load_buffer(const std::string &name,
+                        const char *first,
+                        const char *last,
+                        std::size_t threads,
+                        ParseChunk &&parse_chunk,
+                        Store &&store,
+                        ParseRest &&parse_rest)
+{
+    if (detect_compression(first, last) != Compression::None)
+        throw std::runtime_error(name +
+                                 " is compressed, compressed data can only be loaded from files");
+
+    threads = thread_count(threads);
+    const auto stop = load<Chunk>(first, last, threads, chunk_bytes(last - first, threads),
+                                  parse_chunk, store, parse_rest);
+    if (stop == last)
+        return std::string();
+    return speed_csv::parse_error(name, first, stop, last);
+}
+
+/**
+ * Loads a file with load(), memory mapped, or decompressed in blocks if it's gzip
+ * compressed.  Gzip files are loaded a block at a time, and unlike the other
+ * files a way's datasource can't span lines there.
+ *
+ * @return the message for the line that couldn't be parsed, or an empty string
+ * @throws std::runtime_error if the file can't be read, or is zstd compressed
+ */
+template <typename Chunk, typename ParseChunk, typename Store, typename ParseRest>
+std::string load_file(const std::string &filename,
+                      const std::size_t threads,
+                      ParseChunk &&parse_chunk,
+                      Store &&store,
+                      ParseRest &&parse_rest)
+{
+    switch (detect_compression(filename))
+    {
+    case Compression::Gzip:
+        return detail::load_gzip<Chunk>(filename, thread_count(threads), detail::GZIP_BLOCK_BYTES,
+                                        parse_chunk, store, parse_rest);
+    case Compression::Zstd:
+        throw std::runtime_error(filename +
+                                 " is zstd compressed, only gzip compressed files can be loaded");
+    case Compression::None:
+        break;
+    }
+
+    boost::iostreams::mapped_file_source mmap(filename);
+    return load_buffer<Chunk>(filename, mmap.begin(), mmap.end(), threads, parse_chunk, store,
+                              parse_rest);
+}
+
+} // namespace parallel_load
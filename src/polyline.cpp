@@ -0,0 +1,59 @@
+#include "polyline.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+// Reads one zigzag-encoded varint value starting at `pos`, advancing `pos` past it
+std::int64_t decode_value(const std::string &encoded, std::size_t &pos)
+{
+    std::uint64_t result = 0;
+    unsigned shift = 0;
+    while (true)
+    {
+        if (pos >= encoded.size())
+            throw std::runtime_error("Polyline ends in the middle of a value");
+
+        const auto chunk = static_cast<unsigned char>(encoded[pos++]);
+        if (chunk < 63 || chunk > 126)
+            throw std::runtime_error("Invalid character in polyline at position " +
+                                     std::to_string(pos - 1));
+        if (shift > 60)
+            throw std::runtime_error("Polyline value out of range at position " +
+                                     std::to_string(pos - 1));
+
+        const std::uint64_t bits = chunk - 63;
+        result |= (bits & 0x1f) << shift;
+        shift += 5;
+        if (bits < 0x20)
+            break;
+    }
+    return (result & 1) ? ~static_cast<std::int64_t>(result >> 1)
+                        : static_cast<std::int64_t>(result >> 1);
+}
+} // namespace
+
+std::vector<point_t> decode_polyline(const std::string &encoded, const unsigned precision)
+{
+    if (precision != 5 && precision != 6)
+        throw std::runtime_error("Polyline precision must be 5 or 6");
+
+    const double factor = std::pow(10.0, precision);
+
+    std::vector<point_t> points;
+    // Every point takes at least two characters
+    points.reserve(encoded.size() / 2);
+
+    std::size_t pos = 0;
+    std::int64_t lat = 0;
+    std::int64_t lon = 0;
+    while (pos < encoded.size())
+    {
+        // Polylines store lat before lon, our points are lon/lat
+        lat += decode_value(encoded, pos);
+        lon += decode_value(encoded, pos);
+        points.emplace_back(lon / factor, lat / factor);
+    }
+    return points;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+/**
+ * Decodes a Google encoded polyline into lon/lat coordinates.
+ *
+ * @param encoded the encoded polyline string
+ * @param precision the number of decimal places the polyline was encoded
+ *     with, 5 for the original Google format or 6 for the OSRM/Valhalla format
+ * @return a vector of lon/lat coordinates
+ * @throws std::runtime_error if the string isn't a valid polyline
+ */
+std::vector<point_t> decode_polyline(const std::string &encoded, const unsigned precision = 5);
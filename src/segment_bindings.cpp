@@ -1,8 +1,29 @@
 #include "segment_bindings.hpp"
+#include "binding_utils.hpp"
 #include "types.hpp"
 #include <algorithm>
 #include <vector>
 
+namespace
+{
+// Reads the frozen option of the load methods, throws a TypeError and returns false if it
+// isn't a boolean
+bool getFrozenOption(const v8::Local<v8::Object> options, bool &frozen)
+{
+    const auto frozenValue =
+        Nan::Get(options, Nan::New("frozen").ToLocalChecked()).ToLocalChecked();
+    if (frozenValue->IsUndefined())
+        return true;
+    if (!frozenValue->IsBoolean())
+    {
+        Nan::ThrowTypeError("frozen option should be a boolean");
+        return false;
+    }
+    frozen = Nan::To<bool>(frozenValue).FromJust();
+    return true;
+}
+} // namespace
+
 NAN_MODULE_INIT(SegmentSpeedLookup::Init)
 {
     const auto whoami = Nan::New("SegmentSpeedLookup").ToLocalChecked();
@@ -12,7 +33,11 @@ NAN_MODULE_INIT(SegmentSpeedLookup::Init)
     fnTp->InstanceTemplate()->SetInternalFieldCount(1);
 
     SetPrototypeMethod(fnTp, "loadCSV", loadCSV);
+    SetPrototypeMethod(fnTp, "loadCSVFromBuffer", loadCSVFromBuffer);
     SetPrototypeMethod(fnTp, "getRouteSpeeds", getRouteSpeeds);
+    SetPrototypeMethod(fnTp, "getRouteSpeedStats", getRouteSpeedStats);
+    SetPrototypeMethod(fnTp, "getFilterStats", getFilterStats);
+    SetPrototypeMethod(fnTp, "getStorageStats", getStorageStats);
 
     const auto fn = Nan::GetFunction(fnTp).ToLocalChecked();
     constructor().Reset(fn);
@@ -42,15 +67,21 @@ NAN_METHOD(SegmentSpeedLookup::New)
  * Loads a csv file asynchronously
  * @function loadCSV
  * @param {string} path the path to the CSV file to load
+ * @param {object} [options] {frozen: true} stores the segments in a compact read-only form
  * @param {function} callback function to call when the file is done loading
  */
 NAN_METHOD(SegmentSpeedLookup::loadCSV)
 {
     // In case we already loaded a dataset, this function will transactionally swap in a new one
-    if (info.Length() != 2 || (!info[0]->IsString() && !info[0]->IsArray()) ||
-        !info[1]->IsFunction())
+    const auto argc = info.Length();
+    if ((argc != 2 && argc != 3) || (!info[0]->IsString() && !info[0]->IsArray()) ||
+        !info[argc - 1]->IsFunction() || (argc == 3 && !info[1]->IsObject()))
         return Nan::ThrowTypeError("String (or array of strings) and callback expected");
 
+    bool frozen = false;
+    if (argc == 3 && !getFrozenOption(info[1].As<v8::Object>(), frozen))
+        return;
+
     std::vector<std::string> paths;
 
     if (info[0]->IsString())
@@ -88,8 +119,10 @@ NAN_METHOD(SegmentSpeedLookup::loadCSV)
     {
         explicit CSVLoader(v8::Local<v8::Object> self_,
                            Nan::Callback *callback,
-                           std::vector<std::string> paths_)
-            : Nan::AsyncWorker(callback, "annotator:speed.load"), paths{std::move(paths_)}
+                           std::vector<std::string> paths_,
+                           bool frozen_)
+            : Nan::AsyncWorker(callback, "annotator:speed.load"), paths{std::move(paths_)},
+              frozen{frozen_}
         {
             SaveToPersistent("self", self_);
         }
@@ -103,6 +136,8 @@ NAN_METHOD(SegmentSpeedLookup::loadCSV)
                 {
                     map->loadCSV(path);
                 }
+                if (frozen)
+                    map->freeze();
             }
             catch (const std::exception &e)
             {
@@ -124,11 +159,86 @@ NAN_METHOD(SegmentSpeedLookup::loadCSV)
         }
 
         std::vector<std::string> paths;
+        bool frozen;
+        std::shared_ptr<SegmentSpeedMap> map;
+    };
+
+    auto *callback = new Nan::Callback{info[argc - 1].As<v8::Function>()};
+    Nan::AsyncQueueWorker(new CSVLoader{info.Holder(), callback, std::move(paths), frozen});
+}
+
+/**
+ * Loads CSV data from a Buffer asynchronously.  The data is parsed in place, without a copy or
+ * a temporary file.
+ * @function loadCSVFromBuffer
+ * @param {Buffer} buffer the CSV data, which must not be modified before the callback is called
+ * @param {object} [options] {frozen: true} stores the segments in a compact read-only form
+ * @param {function} callback function to call when the data is done loading
+ */
+NAN_METHOD(SegmentSpeedLookup::loadCSVFromBuffer)
+{
+    // In case we already loaded a dataset, this function will transactionally swap in a new one
+    const auto argc = info.Length();
+    if ((argc != 2 && argc != 3) || !node::Buffer::HasInstance(info[0]) ||
+        !info[argc - 1]->IsFunction() || (argc == 3 && !info[1]->IsObject()))
+        return Nan::ThrowTypeError("Buffer and callback expected");
+
+    bool frozen = false;
+    if (argc == 3 && !getFrozenOption(info[1].As<v8::Object>(), frozen))
+        return;
+
+    struct BufferLoader final : Nan::AsyncWorker
+    {
+        explicit BufferLoader(v8::Local<v8::Object> self_,
+                              Nan::Callback *callback,
+                              v8::Local<v8::Object> buffer,
+                              bool frozen_)
+            : Nan::AsyncWorker(callback, "annotator:speed.load"),
+              data{node::Buffer::Data(buffer)}, size{node::Buffer::Length(buffer)},
+              frozen{frozen_}
+        {
+            SaveToPersistent("self", self_);
+            // Keeps the buffer alive while its data is parsed in the worker
+            SaveToPersistent("buffer", buffer);
+        }
+
+        void Execute() override
+        {
+            try
+            {
+                map = std::make_shared<SegmentSpeedMap>();
+                map->loadCSVBuffer(data, size, "buffer");
+                if (frozen)
+                    map->freeze();
+            }
+            catch (const std::exception &e)
+            {
+                return SetErrorMessage(e.what());
+            }
+        }
+
+        void HandleOKCallback() override
+        {
+            Nan::HandleScope scope;
+            auto self = GetFromPersistent("self")
+                            ->ToObject(v8::Isolate::GetCurrent()->GetCurrentContext())
+                            .ToLocalChecked();
+            auto *unwrapped = Nan::ObjectWrap::Unwrap<SegmentSpeedLookup>(self);
+            swap(unwrapped->datamap, map);
+            const constexpr auto argc = 1u;
+            v8::Local<v8::Value> argv[argc] = {Nan::Null()};
+            callback->Call(argc, argv, async_resource);
+        }
+
+        const char *data;
+        std::size_t size;
+        bool frozen;
         std::shared_ptr<SegmentSpeedMap> map;
     };
 
-    auto *callback = new Nan::Callback{info[1].As<v8::Function>()};
-    Nan::AsyncQueueWorker(new CSVLoader{info.Holder(), callback, std::move(paths)});
+    auto *callback = new Nan::Callback{info[argc - 1].As<v8::Function>()};
+    Nan::AsyncQueueWorker(
+        new BufferLoader{info.Holder(), callback, info[0].As<v8::Object>(), frozen});
 }
 
 /**
@@ -223,6 +333,139 @@ NAN_METHOD(SegmentSpeedLookup::getRouteSpeeds)
         new Worker{self->datamap, new Nan::Callback{callback}, std::move(nodes_to_query)});
 }
 
+/**
+ * Summarises the speeds for pairs of nodes
+ * @function getRouteSpeedStats
+ * @param {array} nodes an array of node IDs to look up in pairs
+ * @param {function} callback receives {min, max, mean, harmonicMean, coverage, valid, total}
+ * @example
+ *   container.getRouteSpeedStats([23,43,12],(err,stats) => {
+ *      console.log(stats.harmonicMean);
+ *   });
+ */
+NAN_METHOD(SegmentSpeedLookup::getRouteSpeedStats)
+{
+    auto *const self = Nan::ObjectWrap::Unwrap<SegmentSpeedLookup>(info.Holder());
+
+    if (info.Length() != 2 || !info[0]->IsArray() || !info[1]->IsFunction())
+        return Nan::ThrowTypeError("Two arguments expected: nodeIds (Array), Callback");
+
+    auto callback = info[1].As<v8::Function>();
+    const auto jsNodeIds = info[0].As<v8::Array>();
+    // Guard against empty or one nodeId for which no wayId can be assigned
+    if (jsNodeIds->Length() < 2)
+        return Nan::ThrowTypeError(
+            "getRouteSpeedStats expects 'nodeIds' (Array(Number)) of at least length 2");
+
+    std::vector<external_nodeid_t> nodes_to_query(jsNodeIds->Length());
+
+    for (uint32_t i = 0; i < jsNodeIds->Length(); ++i)
+    {
+        v8::Local<v8::Value> jsNodeId = Nan::Get(jsNodeIds, i).ToLocalChecked();
+        if (!jsNodeId->IsNumber())
+            return Nan::ThrowTypeError("NodeIds must be an array of numbers");
+        auto signedNodeId = Nan::To<int64_t>(jsNodeId).FromJust();
+        if (signedNodeId < 0)
+            return Nan::ThrowTypeError(
+                "getRouteSpeedStats expects 'nodeId' within (Array(Number))to be non-negative");
+
+        external_nodeid_t nodeId = static_cast<external_nodeid_t>(signedNodeId);
+        nodes_to_query[i] = nodeId;
+    }
+
+    struct Worker final : Nan::AsyncWorker
+    {
+        using Base = Nan::AsyncWorker;
+
+        Worker(std::shared_ptr<SegmentSpeedMap> datamap_,
+               Nan::Callback *callback,
+               std::vector<external_nodeid_t> nodeIds)
+            : Base(callback, "annotator:speed.statsfromnodeids"), datamap{datamap_},
+              nodeIds(std::move(nodeIds))
+        {
+        }
+
+        void Execute() override
+        {
+            if (datamap)
+            {
+                stats = compute_speed_stats(datamap->getValues(nodeIds));
+            }
+            else
+            {
+                stats = compute_speed_stats(
+                    std::vector<segment_speed_t>(nodeIds.size() - 1, INVALID_SPEED));
+            }
+        }
+
+        void HandleOKCallback() override
+        {
+            Nan::HandleScope scope;
+
+            const auto argc = 2u;
+            v8::Local<v8::Value> argv[argc] = {Nan::Null(), speedStatsToObject(stats)};
+
+            callback->Call(argc, argv, async_resource);
+        }
+
+        std::shared_ptr<SegmentSpeedMap> datamap;
+        std::vector<external_nodeid_t> nodeIds;
+        SpeedStats stats;
+    };
+
+    Nan::AsyncQueueWorker(
+        new Worker{self->datamap, new Nan::Callback{callback}, std::move(nodes_to_query)});
+}
+
+/**
+ * Reports the filter that answers lookups for segments without a speed
+ * @function getFilterStats
+ * @return {object} {keys, bytes, falsePositiveRate}, all 0 if no CSV is loaded
+ */
+NAN_METHOD(SegmentSpeedLookup::getFilterStats)
+{
+    auto *const self = Nan::ObjectWrap::Unwrap<SegmentSpeedLookup>(info.Holder());
+
+    if (info.Length() != 0)
+        return Nan::ThrowTypeError("No arguments expected");
+
+    BlockedBloomFilter::Stats stats{0, 0, 0};
+    if (self->datamap)
+        stats = self->datamap->filterStats();
+
+    auto result = Nan::New<v8::Object>();
+    Nan::Set(result, Nan::New("keys").ToLocalChecked(),
+             Nan::New<v8::Number>(static_cast<double>(stats.keys)));
+    Nan::Set(result, Nan::New("bytes").ToLocalChecked(),
+             Nan::New<v8::Number>(static_cast<double>(stats.memory_bytes)));
+    Nan::Set(result, Nan::New("falsePositiveRate").ToLocalChecked(),
+             Nan::New<v8::Number>(stats.false_positive_rate));
+    info.GetReturnValue().Set(result);
+}
+
+/**
+ * Reports how the loaded segments are stored
+ * @function getStorageStats
+ * @return {object} {segments, bytes, frozen}, bytes is an estimate that leaves out the filter
+ */
+NAN_METHOD(SegmentSpeedLookup::getStorageStats)
+{
+    auto *const self = Nan::ObjectWrap::Unwrap<SegmentSpeedLookup>(info.Holder());
+
+    if (info.Length() != 0)
+        return Nan::ThrowTypeError("No arguments expected");
+
+    const auto &map = self->datamap;
+    auto result = Nan::New<v8::Object>();
+    Nan::Set(result, Nan::New("segments").ToLocalChecked(),
+             Nan::New<v8::Number>(map ? static_cast<double>(map->size()) : 0));
+    Nan::Set(result, Nan::New("bytes").ToLocalChecked(),
+             Nan::New<v8::Number>(map ? static_cast<double>(map->memoryBytes()) : 0));
+    Nan::Set(result, Nan::New("frozen").ToLocalChecked(),
+             Nan::New<v8::Boolean>(map && map->isFrozen()));
+    info.GetReturnValue().Set(result);
+}
+
 Nan::Persistent<v8::Function> &SegmentSpeedLookup::constructor()
 {
     static Nan::Persistent<v8::Function> init;
@@ -14,9 +14,20 @@ class SegmentSpeedLookup : public Nan::ObjectWrap
 
     static NAN_METHOD(loadCSV);
 
+    static NAN_METHOD(loadCSVFromBuffer);
+
     static NAN_METHOD(getRouteSpeeds);
 
+    static NAN_METHOD(getRouteSpeedStats);
+
+    static NAN_METHOD(getFilterStats);
+
+    static NAN_METHOD(getStorageStats);
+
     static Nan::Persistent<v8::Function> &constructor(); // CPP Land
 
     std::shared_ptr<SegmentSpeedMap> datamap; // if you want async call
+
+    // Reads datamap to resolve speeds together with the other lookups
+    friend class SpeedFallbackLookup;
 };
@@ -1,16 +1,51 @@
 #include "segment_speed_map.hpp"
+#include "batch_lookup.hpp"
+#include "parallel_load.hpp"
+#include "speed_csv.hpp"
 #include <sparsepp/spp.h>
 
-#include <boost/fusion/adapted/std_pair.hpp>
-#include <boost/iostreams/device/mapped_file.hpp>
-#include <boost/spirit/include/phoenix.hpp>
-#include <boost/spirit/include/qi.hpp>
-#include <boost/spirit/include/support_line_pos_iterator.hpp>
-
+#include <algorithm>
 #include <iostream>
+#include <tuple>
 
 using spp::sparse_hash_map;
 
+namespace
+{
+void write_varint(std::vector<std::uint8_t> &bytes, std::uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        bytes.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<std::uint8_t>(value));
+}
+
+std::uint64_t read_varint(const std::uint8_t *&bytes)
+{
+    std::uint64_t value = 0;
+    for (unsigned shift = 0;; shift += 7)
+    {
+        const auto byte = *bytes++;
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if (byte < 0x80)
+            return value;
+    }
+}
+
+// The first to id of a group is stored relative to the from id, which may be larger
+std::uint64_t zigzag(const std::int64_t value)
+{
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(const std::uint64_t value)
+{
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+} // namespace
+
 SegmentSpeedMap::SegmentSpeedMap(){};
 
 SegmentSpeedMap::SegmentSpeedMap(const std::string &input_filename) { loadCSV(input_filename); }
@@ -23,36 +58,109 @@ SegmentSpeedMap::SegmentSpeedMap(const std::vector<std::string> &input_filenames
     }
 }
 
-void SegmentSpeedMap::loadCSV(const std::string &input_filename)
+struct SegmentSpeedMap::LoadChunk
+{
+    // Speeds in km/h, by shard
+    std::array<std::vector<std::pair<Segment, segment_speed_t>>, SHARDS> segments;
+    // Rows with a speed out of range, reported once the chunk is stored
+    std::vector<
+        std::tuple<external_nodeid_t, external_nodeid_t, std::uint32_t, speed_csv::SpeedUnit>>
+        invalid;
+};
+
+void SegmentSpeedMap::loadCSV(const std::string &input_filename, const std::size_t threads)
+{
+    loadRows(input_filename, threads, [&input_filename](const std::size_t thread_count,
+                                                        auto &parse_chunk, auto &store,
+                                                        auto &parse_rest) {
+        return parallel_load::load_file<LoadChunk>(input_filename, thread_count, parse_chunk,
+                                                    store, parse_rest);
+    });
+}
+
+void SegmentSpeedMap::loadCSVBuffer(const char *data,
+                                    const std::size_t size,
+                                    const std::string &name,
+                                    const std::size_t threads)
+{
+    loadRows(name, threads, [data, size, &name](const std::size_t thread_count, auto &parse_chunk,
+                                                auto &store, auto &parse_rest) {
+        return parallel_load::load_buffer<LoadChunk>(name, data, data + size, thread_count,
+                                                     parse_chunk, store, parse_rest);
+    });
+}
+
+template <typename LoadRows>
+void SegmentSpeedMap::loadRows(const std::string &name,
+                               const std::size_t threads,
+                               LoadRows &&load_rows)
 {
-    namespace ph = boost::phoenix;
-    namespace qi = boost::spirit::qi;
+    if (frozen)
+        throw std::runtime_error("Can't load " + name + " into a frozen SegmentSpeedMap");
+
+    const auto add_row = [this](const external_nodeid_t from, const external_nodeid_t to,
+                                const std::uint32_t speed, const speed_csv::SpeedUnit unit) {
+        if (unit == speed_csv::SpeedUnit::None)
+            add(from, to, speed);
+        else
+            add_with_unit(from, to, speed, unit == speed_csv::SpeedUnit::Mph);
+    };
+
+    const auto parse_chunk = [](const char *first, const char *last, LoadChunk &chunk) {
+        return speed_csv::parse_segment_speeds(
+            first, last,
+            [&chunk](const external_nodeid_t from, const external_nodeid_t to,
+                     const std::uint32_t speed, const speed_csv::SpeedUnit unit) {
+                const auto kph = speed_to_kph(speed, unit == speed_csv::SpeedUnit::Mph);
+                if (kph > INVALID_SPEED - 1)
+                    chunk.invalid.emplace_back(from, to, speed, unit);
+                else
+                    chunk.segments[shardIndex(filterHash(from, to))].emplace_back(
+                        Segment(from, to), static_cast<segment_speed_t>(kph));
+            });
+    };
+
+    const auto thread_count = parallel_load::thread_count(threads);
+    const auto store = [this, thread_count, &add_row](std::vector<LoadChunk> &chunks,
+                                                      const std::size_t count) {
+        // Each shard takes its rows from the chunks in file order, the last row wins
+        parallel_load::for_each_index(SHARDS, thread_count, [&](const std::size_t shard) {
+            auto &table = annotations[shard];
+            std::size_t rows = table.size();
+            for (std::size_t i = 0; i < count; ++i)
+                rows += chunks[i].segments[shard].size();
+            table.reserve(rows);
 
-    boost::iostreams::mapped_file_source mmap(input_filename);
-    auto first = mmap.begin(), last = mmap.end();
-    qi::parse(first, last,
-              (
-                  // parse data that does not have mph or kph data
-                  ((qi::ulong_long >> ',' >> qi::ulong_long >> ',' >>
-                    qi::uint_)[ph::bind(&SegmentSpeedMap::add, this, qi::_1, qi::_2, qi::_3)]) |
-                  // if the above fails, try to parse data checking for mph or kph.
-                  ((qi::ulong_long >> ',' >> qi::ulong_long >> ',' >>
-                    ("mph" >> qi::attr(true) | "kph" >> qi::attr(false) | "" >> qi::attr(false)) >>
-                    ',' >> qi::uint_)[ph::bind(&SegmentSpeedMap::add_with_unit, this, qi::_1,
-                                               qi::_2, qi::_4, qi::_3)])) %
-                      qi::eol >>
-                  *qi::eol);
+            for (std::size_t i = 0; i < count; ++i)
+                for (const auto &segment : chunks[i].segments[shard])
+                    table[segment.first] = segment.second;
+        });
+        for (std::size_t i = 0; i < count; ++i)
+            for (const auto &row : chunks[i].invalid)
+                add_row(std::get<0>(row), std::get<1>(row), std::get<2>(row), std::get<3>(row));
+    };
 
-    if (first != last)
+    const auto parse_rest = [&add_row](const char *first, const char *last) {
+        return speed_csv::parse_segment_speeds(first, last, add_row);
+    };
+
+    std::string error;
+    try
+    {
+        error = load_rows(thread_count, parse_chunk, store, parse_rest);
+    }
+    catch (...)
     {
-        auto bol = first - 1;
-        while (bol > mmap.begin() && *bol != '\n')
-            --bol;
-        auto line_number = std::count(mmap.begin(), first, '\n') + 1;
-        throw std::runtime_error("CSV parsing failed at " + input_filename + ':' +
-                                 std::to_string(line_number) + ": " +
-                                 std::string(bol + 1, std::find(first, last, '\n')));
+        // A compressed file may turn out to be corrupt after some of its rows were stored
+        buildFilter();
+        throw;
     }
+
+    // Also covers the rows read before a parse error
+    buildFilter();
+
+    if (!error.empty())
+        throw std::runtime_error(error);
 }
 
 void SegmentSpeedMap::add_with_unit(const external_nodeid_t &from,
@@ -62,7 +170,7 @@ void SegmentSpeedMap::add_with_unit(const external_nodeid_t &from,
 {
     if (mph)
     {
-        std::uint32_t s = std::round(speed * kKmPerMile);
+        const auto s = speed_to_kph(speed, mph);
 
         if (s > INVALID_SPEED - 1)
         {
@@ -71,7 +179,8 @@ void SegmentSpeedMap::add_with_unit(const external_nodeid_t &from,
                       << std::endl;
         }
         else
-            annotations[Segment(from, to)] = s;
+            annotations[shardIndex(filterHash(from, to))][Segment(from, to)] =
+                static_cast<segment_speed_t>(s);
     }
     else
     {
@@ -83,7 +192,7 @@ void SegmentSpeedMap::add_with_unit(const external_nodeid_t &from,
                       << std::endl;
         }
         else
-            annotations[Segment(from, to)] = speed;
+            annotations[shardIndex(filterHash(from, to))][Segment(from, to)] = speed;
     }
 }
 
@@ -99,20 +208,136 @@ void SegmentSpeedMap::add(const external_nodeid_t &from,
         return;
     }
 
-    annotations[Segment(from, to)] = speed;
+    annotations[shardIndex(filterHash(from, to))][Segment(from, to)] = speed;
+}
+
+void SegmentSpeedMap::buildFilter()
+{
+    filter.reset(size());
+    for (const auto &shard : annotations)
+        for (const auto &annotation : shard)
+            filter.insert(filterHash(annotation.first.from, annotation.first.to));
+}
+
+BlockedBloomFilter::Stats SegmentSpeedMap::filterStats() const { return filter.stats(); }
+
+void SegmentSpeedMap::freeze()
+{
+    if (frozen)
+        return;
+
+    std::vector<std::pair<Segment, segment_speed_t>> segments;
+    segments.reserve(size());
+    // Release each shard once copied, the sorted copy is the peak
+    for (auto &shard : annotations)
+    {
+        segments.insert(segments.end(), shard.begin(), shard.end());
+        shard_t().swap(shard);
+    }
+    std::sort(segments.begin(), segments.end(), [](const auto &lhs, const auto &rhs) {
+        return lhs.first.from < rhs.first.from ||
+               (lhs.first.from == rhs.first.from && lhs.first.to < rhs.first.to);
+    });
+
+    std::vector<std::uint64_t> froms;
+    std::vector<std::uint64_t> group_starts;
+    std::vector<std::uint64_t> group_bytes;
+    frozen_speeds.reserve(segments.size());
+    for (std::size_t i = 0; i < segments.size(); ++i)
+    {
+        const auto &segment = segments[i].first;
+        if (i == 0 || segment.from != segments[i - 1].first.from)
+        {
+            froms.push_back(segment.from);
+            group_starts.push_back(i);
+            group_bytes.push_back(frozen_tos.size());
+            write_varint(frozen_tos, zigzag(static_cast<std::int64_t>(segment.to - segment.from)));
+        }
+        else
+        {
+            write_varint(frozen_tos, segment.to - segments[i - 1].first.to);
+        }
+        frozen_speeds.push_back(segments[i].second);
+    }
+    frozen_tos.shrink_to_fit();
+
+    frozen_froms = EliasFano(froms);
+    frozen_group_starts = EliasFano(group_starts);
+    frozen_group_bytes = EliasFano(group_bytes);
+    frozen = true;
+}
+
+std::size_t SegmentSpeedMap::size() const
+{
+    if (frozen)
+        return frozen_speeds.size();
+
+    std::size_t segments = 0;
+    for (const auto &shard : annotations)
+        segments += shard.size();
+    return segments;
+}
+
+std::size_t SegmentSpeedMap::memoryBytes() const
+{
+    if (!frozen)
+        return size() * sizeof(shard_t::value_type);
+
+    return frozen_froms.memory_bytes() + frozen_group_starts.memory_bytes() +
+           frozen_group_bytes.memory_bytes() + frozen_tos.size() + frozen_speeds.size();
+}
+
+segment_speed_t SegmentSpeedMap::frozenValue(const external_nodeid_t from,
+                                             const external_nodeid_t to) const
+{
+    std::uint64_t found;
+    const auto group = frozen_froms.lower_bound(from, found);
+    if (group == frozen_froms.size() || found != from)
+        return INVALID_SPEED;
+
+    auto segment = frozen_group_starts[group];
+    const auto end =
+        group + 1 < frozen_froms.size() ? frozen_group_starts[group + 1] : frozen_speeds.size();
+    const auto *bytes = frozen_tos.data() + frozen_group_bytes[group];
+    external_nodeid_t current = from + unzigzag(read_varint(bytes));
+    // The to ids of a group are sorted, stop once past the one we look for
+    while (current < to && ++segment < end)
+        current += read_varint(bytes);
+
+    if (segment < end && current == to)
+        return frozen_speeds[segment];
+    return INVALID_SPEED;
 }
 
 bool SegmentSpeedMap::hasKey(const external_nodeid_t &from, const external_nodeid_t &to) const
 {
-    return annotations.count(Segment(from, to)) > 0;
+    const auto hash = filterHash(from, to);
+    if (!filter.maybe_contains(hash))
+        return false;
+    if (frozen)
+        return frozenValue(from, to) != INVALID_SPEED;
+    return annotations[shardIndex(hash)].count(Segment(from, to)) > 0;
 }
 
 segment_speed_t SegmentSpeedMap::getValue(const external_nodeid_t &from,
                                           const external_nodeid_t &to) const
 {
+    if (frozen)
+    {
+        const auto speed = frozenValue(from, to);
+        if (speed == INVALID_SPEED)
+        {
+            throw std::runtime_error("Segment from NodeID " + std::to_string(from) +
+                                     " to NodeId " + std::to_string(to) +
+                                     " doesn't exist in the frozen map.");
+        }
+        return speed;
+    }
+
     // Save the result of find so that we don't need to repeat the lookup to get the value
-    auto result = annotations.find(Segment(from, to));
-    if (result == annotations.end())
+    const auto &shard = annotations[shardIndex(filterHash(from, to))];
+    auto result = shard.find(Segment(from, to));
+    if (result == shard.end())
     {
         throw std::runtime_error("Segment from NodeID " + std::to_string(from) + " to NodeId " +
                                  std::to_string(to) + " doesn't exist in the hashmap.");
@@ -133,19 +358,33 @@ SegmentSpeedMap::getValues(const std::vector<external_nodeid_t> &route) const
     }
 
     speeds.resize(route.size() - 1);
-    for (std::size_t segment_index = 0; segment_index < speeds.size(); ++segment_index)
-    {
-        auto from = route[segment_index];
-        auto to = route[segment_index + 1];
-        auto result = annotations.find(Segment(from, to));
-        if (result == annotations.end())
-        {
-            speeds[segment_index] = INVALID_SPEED;
-        }
-        else
-        {
-            speeds[segment_index] = result->second;
-        }
-    }
+    // Most segments have no speed and are answered by the filter, prefetch its blocks
+    batch_lookup(
+        speeds.size(),
+        [&route](const std::size_t i) { return filterHash(route[i], route[i + 1]); },
+        [this](const std::uint64_t hash) { filter.prefetch(hash); },
+        [&](const std::size_t segment_index, const std::uint64_t hash) {
+            if (!filter.maybe_contains(hash))
+            {
+                speeds[segment_index] = INVALID_SPEED;
+                return;
+            }
+            if (frozen)
+            {
+                speeds[segment_index] =
+                    frozenValue(route[segment_index], route[segment_index + 1]);
+                return;
+            }
+            const auto &shard = annotations[shardIndex(hash)];
+            auto result = shard.find(Segment(route[segment_index], route[segment_index + 1]));
+            if (result == shard.end())
+            {
+                speeds[segment_index] = INVALID_SPEED;
+            }
+            else
+            {
+                speeds[segment_index] = result->second;
+            }
+        });
     return speeds;
 }
@@ -1,11 +1,14 @@
 #ifndef SEGMENT_SPEED_MAP_H
 #define SEGMENT_SPEED_MAP_H
 
+#include <array>
 #include <fstream>
 #include <iostream>
 #include <sparsepp/spp.h>
 #include <vector>
 
+#include "bloom_filter.hpp"
+#include "elias_fano.hpp"
 #include "types.hpp"
 
 using spp::sparse_hash_map;
@@ -61,9 +64,29 @@ class SegmentSpeedMap
     SegmentSpeedMap(const std::vector<std::string> &input_filenames);
 
     /**
-     * Parses and loads another CSV file into the existing data
+     * Parses and loads another CSV file into the existing data.
+     *
+     * Large files are parsed in chunks on several threads, and each shard of
+     * the map is filled on a thread of its own.  A segment that is in the file
+     * more than once keeps the speed of its last row.
+     *
+     * @param threads the number of threads, 0 for one per hardware thread
+     * @throws a runtime_exception if the map is frozen.
      */
-    void loadCSV(const std::string &input_filename);
+    void loadCSV(const std::string &input_filename, const std::size_t threads = 0);
+
+    /**
+     * Parses and loads CSV data in memory into the existing data, as loadCSV
+     * does for a file.  The data is parsed in place.
+     *
+     * @param name the name of the data in error messages
+     * @param threads the number of threads, 0 for one per hardware thread
+     * @throws a runtime_exception if the map is frozen, or the data is compressed.
+     */
+    void loadCSVBuffer(const char *data,
+                       const std::size_t size,
+                       const std::string &name,
+                       const std::size_t threads = 0);
 
     /**
      * Adds a single to/from pair value with support for unit.
@@ -98,8 +121,87 @@ class SegmentSpeedMap
      */
     std::vector<segment_speed_t> getValues(const std::vector<external_nodeid_t> &route) const;
 
+    /**
+     * Reports the size and false positive rate of the filter that answers
+     * lookups for segments without a speed
+     */
+    BlockedBloomFilter::Stats filterStats() const;
+
+    /**
+     * Moves the segments from the hashtable into a compact read-only form,
+     * once all CSV files are loaded.
+     *
+     * Segments are sorted by from and to node.  The distinct from ids, and
+     * where each group of segments with the same from id starts, are Elias-Fano
+     * encoded.  The to ids of a group are varint encoded, the first relative to
+     * the from id and the rest as deltas, and speeds are kept in a parallel
+     * array.  That takes a few bytes per segment instead of the hashtable's
+     * 16 byte keys, for lookups that decode one group.
+     */
+    void freeze();
+
+    bool isFrozen() const { return frozen; }
+
+    /**
+     * The number of segments with a speed
+     */
+    std::size_t size() const;
+
+    /**
+     * Estimates the memory used by the stored segments and speeds, not
+     * counting the filter
+     */
+    std::size_t memoryBytes() const;
+
   private:
-    sparse_hash_map<Segment, segment_speed_t> annotations;
+    // The rows of one chunk of CSV data
+    struct LoadChunk;
+
+    /**
+     * Loads rows with load_rows(threads, parse_chunk, store, parse_rest), which
+     * returns the parse error or an empty string, then rebuilds the filter
+     */
+    template <typename LoadRows>
+    void loadRows(const std::string &name, const std::size_t threads, LoadRows &&load_rows);
+
+    // Segments are spread over shards by the top bits of their filter hash, so that
+    // loading can fill the shards in parallel
+    static constexpr std::size_t SHARD_BITS = 4;
+    static constexpr std::size_t SHARDS = std::size_t{1} << SHARD_BITS;
+
+    typedef sparse_hash_map<Segment, segment_speed_t> shard_t;
+
+    static std::size_t shardIndex(const std::uint64_t hash)
+    {
+        return static_cast<std::size_t>(hash >> (64 - SHARD_BITS));
+    }
+
+    /**
+     * Rebuilds the presence filter over all segments, after loading
+     */
+    void buildFilter();
+
+    static std::uint64_t filterHash(const external_nodeid_t from, const external_nodeid_t to)
+    {
+        return BlockedBloomFilter::mix_hash(BlockedBloomFilter::mix_hash(from) ^ to);
+    }
+
+    /**
+     * Looks up a segment in the frozen form
+     * @return the speed, or INVALID_SPEED if the segment has none
+     */
+    segment_speed_t frozenValue(const external_nodeid_t from, const external_nodeid_t to) const;
+
+    std::array<shard_t, SHARDS> annotations;
+    BlockedBloomFilter filter;
+
+    // Set by freeze(), see there for the layout
+    bool frozen = false;
+    EliasFano frozen_froms;
+    EliasFano frozen_group_starts;
+    EliasFano frozen_group_bytes;
+    std::vector<std::uint8_t> frozen_tos;
+    std::vector<segment_speed_t> frozen_speeds;
 };
 
 #endif
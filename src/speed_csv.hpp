@@ -0,0 +1,354 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Parsers for the speed CSV files.
+ *
+ * Segment files have from,to,speed or from,to,unit,speed rows, way files
+ * way,datasource,unit,speed rows, where the unit is mph, kph or empty.  Rows
+ * are separated by single line breaks (\n, \r\n or \r), and the file may end
+ * with any number of line breaks.  This is the language the Boost.Spirit
+ * grammars used before accepted, parsed in a single pass: digit runs are
+ * found 16 bytes at a time with SSE2 where available, and numbers of up to 16
+ * digits are converted 8 digits at a time.  Short from,to,speed rows, most of
+ * a segment file, are split from the positions of their delimiters in 32 bytes.
+ *
+ * The parsers return where they stopped: the end of the input if all of it
+ * was parsed, or a position on the first line that isn't a valid row.  The
+ * rows before that line have been passed to the callback.
+ */
+namespace speed_csv
+{
+
+/**
+ * The unit column of a segment row
+ */
+enum class SpeedUnit
+{
+    // No unit column, the speed is in km/h
+    None,
+    // kph or an empty unit column
+    Kph,
+    Mph
+};
+
+namespace detail
+{
+
+#if defined(__SSE2__)
+// Bits set for the bytes of 16 that aren't digits
+inline unsigned non_digits(const __m128i bytes)
+{
+    // Bytes that aren't digits are outside 0..9 once '0' is subtracted, as signed bytes
+    const auto values = _mm_sub_epi8(bytes, _mm_set1_epi8('0'));
+    return static_cast<unsigned>(
+        _mm_movemask_epi8(_mm_or_si128(_mm_cmplt_epi8(values, _mm_setzero_si128()),
+                                       _mm_cmpgt_epi8(values, _mm_set1_epi8(9)))));
+}
+
+inline unsigned matches(const __m128i bytes, const char c)
+{
+    return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(c))));
+}
+#endif
+
+// The number of ASCII digits at the start of [first, last)
+inline std::size_t count_digits(const char *first, const char *last)
+{
+    std::size_t count = 0;
+#if defined(__SSE2__)
+    while (last - first - count >= 16)
+    {
+        const auto mask =
+            non_digits(_mm_loadu_si128(reinterpret_cast<const __m128i *>(first + count)));
+        if (mask != 0)
+            return count + __builtin_ctz(mask);
+        count += 16;
+    }
+#endif
+    while (first + count != last && static_cast<unsigned char>(first[count] - '0') <= 9)
+        ++count;
+    return count;
+}
+
+// Converts 1 to 8 digits, with 8 bytes readable from digits
+inline std::uint64_t convert_digits(const char *digits, const std::size_t count)
+{
+    std::uint64_t chunk;
+    std::memcpy(&chunk, digits, sizeof(chunk));
+    // Digits become 0..9 bytes, the first one in the lowest byte.  Bytes after the digits
+    // may borrow from each other but are shifted out, leaving leading zeros.
+    chunk -= 0x3030303030303030ull;
+    chunk <<= 8 * (8 - count);
+    // Combine pairs of digits, then pairs of pairs, then the two halves
+    chunk = (chunk * 10) + (chunk >> 8);
+    chunk = (((chunk & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) +
+             (((chunk >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >>
+            32;
+    return chunk;
+}
+
+// Converts 1 to 16 digits, with 16 bytes readable from digits
+inline std::uint64_t convert_number(const char *digits, const std::size_t count)
+{
+    if (count <= 8)
+        return convert_digits(digits, count);
+    return convert_digits(digits, count - 8) * 100000000ull +
+           convert_digits(digits + count - 8, 8);
+}
+
+/**
+ * Parses an unsigned integer that fits T, advancing first past it
+ */
+template <typename T> bool parse_uint(const char *&first, const char *last, T &value)
+{
+    const auto count = count_digits(first, last);
+    if (count == 0)
+        return false;
+
+    std::uint64_t result = 0;
+    if (count <= 16 && last - first >= 16)
+    {
+        result = convert_number(first, count);
+    }
+    else
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const std::uint64_t digit = first[i] - '0';
+            if (result > (std::numeric_limits<std::uint64_t>::max() - digit) / 10)
+                return false;
+            result = result * 10 + digit;
+        }
+    }
+
+    if (result > std::numeric_limits<T>::max())
+        return false;
+    value = static_cast<T>(result);
+    first += count;
+    return true;
+}
+
+#if defined(__SSE2__)
+/**
+ * Parses the common from,to,speed row that ends with \n within 32 bytes, from the
+ * positions of its delimiters.  Needs 48 bytes readable, and leaves every other row
+ * to the general parser.
+ */
+inline bool parse_short_segment_row(const char *&first,
+                                    std::uint64_t &from,
+                                    std::uint64_t &to,
+                                    std::uint32_t &speed)
+{
+    const auto low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+    const auto high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first + 16));
+    const auto newlines = matches(low, '\n') | (matches(high, '\n') << 16);
+    if (newlines == 0)
+        return false;
+
+    const auto end = static_cast<std::size_t>(__builtin_ctz(newlines));
+    const auto row = (1u << end) - 1;
+    const auto commas = (matches(low, ',') | (matches(high, ',') << 16)) & row;
+    // Only digits and two commas before the line break
+    if (((non_digits(low) | (non_digits(high) << 16)) & row) != commas ||
+        __builtin_popcount(commas) != 2)
+        return false;
+
+    const auto first_comma = static_cast<std::size_t>(__builtin_ctz(commas));
+    const auto second_comma = static_cast<std::size_t>(__builtin_ctz(commas & (commas - 1)));
+    const auto speed_digits = end - second_comma - 1;
+    if (first_comma == 0 || second_comma - first_comma - 1 == 0 || speed_digits == 0 ||
+        first_comma > 16 || second_comma - first_comma - 1 > 16 || speed_digits > 9)
+        return false;
+
+    from = convert_number(first, first_comma);
+    to = convert_number(first + first_comma + 1, second_comma - first_comma - 1);
+    speed = static_cast<std::uint32_t>(convert_number(first + second_comma + 1, speed_digits));
+    first += end;
+    return true;
+}
+#endif
+
+inline bool parse_char(const char *&first, const char *last, const char c)
+{
+    if (first == last || *first != c)
+        return false;
+    ++first;
+    return true;
+}
+
+inline bool parse_literal(const char *&first, const char *last, const char (&literal)[4])
+{
+    if (last - first < 3 || std::memcmp(first, literal, 3) != 0)
+        return false;
+    first += 3;
+    return true;
+}
+
+// Finds the next occurrence of c in [first, last), or last
+inline const char *find_char(const char *first, const char *last, const char c)
+{
+    const auto found = std::memchr(first, c, last - first);
+    return found ? static_cast<const char *>(found) : last;
+}
+
+// Parses an optional mph or kph unit, true for mph
+inline bool parse_unit(const char *&first, const char *last)
+{
+    if (parse_literal(first, last, "mph"))
+        return true;
+    parse_literal(first, last, "kph");
+    return false;
+}
+
+inline bool parse_eol(const char *&first, const char *last)
+{
+    if (first == last)
+        return false;
+    if (*first == '\n')
+    {
+        ++first;
+        return true;
+    }
+    if (*first == '\r')
+    {
+        ++first;
+        if (first != last && *first == '\n')
+            ++first;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Parses rows separated by single line breaks, then trailing line breaks
+ *
+ * @param parse_row parse_row(first) parses a row, advancing first, and returns false if the
+ *     row is invalid
+ * @param optional whether the input may have no rows
+ */
+template <typename ParseRow>
+const char *
+parse_rows(const char *first, const char *last, const bool optional, ParseRow &&parse_row)
+{
+    auto position = first;
+    if (!parse_row(position))
+    {
+        if (!optional)
+            return first;
+        position = first;
+    }
+    else
+    {
+        // After each row: the end, or a line break and another row
+        while (position != last)
+        {
+            auto next = position;
+            if (!parse_eol(next, last) || !parse_row(next))
+                break;
+            position = next;
+        }
+    }
+
+    while (parse_eol(position, last))
+        ;
+    return position;
+}
+
+} // namespace detail
+
+/**
+ * Parses from,to,speed and from,to,unit,speed rows
+ *
+ * @param add add(from, to, speed, unit) is called for each row
+ * @return the end of the input, or a position on the first invalid line
+ */
+template <typename Add>
+const char *parse_segment_speeds(const char *first, const char *last, Add &&add)
+{
+    using namespace detail;
+    return parse_rows(first, last, false, [&](const char *&position) {
+        std::uint64_t from, to;
+        std::uint32_t speed;
+#if defined(__SSE2__)
+        if (last - position >= 48 && parse_short_segment_row(position, from, to, speed))
+        {
+            add(from, to, speed, SpeedUnit::None);
+            return true;
+        }
+#endif
+        if (!parse_uint(position, last, from) || !parse_char(position, last, ',') ||
+            !parse_uint(position, last, to) || !parse_char(position, last, ','))
+            return false;
+
+        if (parse_uint(position, last, speed))
+        {
+            add(from, to, speed, SpeedUnit::None);
+            return true;
+        }
+
+        const auto mph = parse_unit(position, last);
+        if (!parse_char(position, last, ',') || !parse_uint(position, last, speed))
+            return false;
+        add(from, to, speed, mph ? SpeedUnit::Mph : SpeedUnit::Kph);
+        return true;
+    });
+}
+
+/**
+ * Parses way,datasource,unit,speed rows.  The datasource is anything up to the next comma.
+ *
+ * @param add add(way, mph, speed) is called for each row
+ * @return the end of the input, or a position on the first invalid line
+ */
+template <typename Add> const char *parse_way_speeds(const char *first, const char *last, Add &&add)
+{
+    using namespace detail;
+    return parse_rows(first, last, true, [&](const char *&position) {
+        std::uint32_t way, speed;
+        if (!parse_uint(position, last, way) || !parse_char(position, last, ','))
+            return false;
+        position = find_char(position, last, ',');
+
+        if (!parse_char(position, last, ','))
+            return false;
+        const auto mph = parse_unit(position, last);
+        if (!parse_char(position, last, ',') || !parse_uint(position, last, speed))
+            return false;
+        add(way, mph, speed);
+        return true;
+    });
+}
+
+/**
+ * The message for a CSV file that couldn't be parsed, with the line where parsing stopped
+ *
+ * @param begin the start of the file, or of the lines in memory
+ * @param stop where parsing stopped
+ * @param end the end of the file, or of the lines in memory
+ * @param lines the number of lines before begin
+ */
+inline std::string parse_error(const std::string &filename,
+                               const char *begin,
+                               const char *stop,
+                               const char *end,
+                               const std::size_t lines = 0)
+{
+    auto bol = stop;
+    while (bol > begin && *(bol - 1) != '\n')
+        --bol;
+    const auto line_number = lines + std::count(begin, stop, '\n') + 1;
+    return "CSV parsing failed at " + filename + ':' + std::to_string(line_number) + ": " +
+           std::string(bol, std::find(stop, end, '\n'));
+}
+
+} // namespace speed_csv
@@ -0,0 +1,143 @@
+#include "speed_fallback.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <unordered_map>
+
+SpeedFallback::SpeedFallback(const Database *db,
+                             const SegmentSpeedMap *segments,
+                             const WaySpeedMap *ways)
+    : db(db), segments(segments), ways(ways)
+{
+}
+
+FallbackSpeeds SpeedFallback::getValues(const std::vector<external_nodeid_t> &route) const
+{
+    FallbackSpeeds result;
+    if (route.size() < 2)
+        return result;
+
+    const auto segment_count = route.size() - 1;
+    if (segments)
+        result.speeds = segments->getValues(route);
+    else
+        result.speeds.assign(segment_count, INVALID_SPEED);
+    result.sources.assign(segment_count, SpeedSource::None);
+
+    // Segments the first source didn't know about, with the way they belong to
+    std::vector<std::size_t> misses;
+    std::vector<wayid_t> miss_ways;
+    for (std::size_t i = 0; i < segment_count; ++i)
+    {
+        if (result.speeds[i] != INVALID_SPEED)
+        {
+            result.sources[i] = SpeedSource::Segment;
+            continue;
+        }
+        if (!db)
+            continue;
+        const auto way_id = find_way(route[i], route[i + 1]);
+        if (way_id == INVALID_WAYID)
+            continue;
+        misses.push_back(i);
+        miss_ways.push_back(way_id);
+    }
+    if (misses.empty())
+        return result;
+
+    if (ways)
+    {
+        std::vector<wayid_t> external_ways(miss_ways.size());
+        for (std::size_t m = 0; m < miss_ways.size(); ++m)
+            external_ways[m] = db->internal_to_external_way_id_map[miss_ways[m]];
+
+        const auto way_speeds = ways->getValues(external_ways);
+        for (std::size_t m = 0; m < misses.size(); ++m)
+        {
+            if (way_speeds[m] == INVALID_SPEED)
+                continue;
+            result.speeds[misses[m]] = way_speeds[m];
+            result.sources[misses[m]] = SpeedSource::Way;
+        }
+    }
+
+    // Strings can't be looked up by value once the database is compacted, so check each
+    // key string id we come across once.  Routes mostly stay on a way for several segments,
+    // so the maxspeed of the last way is remembered too.
+    std::unordered_map<stringid_t, bool> is_maxspeed;
+    wayid_t last_way = INVALID_WAYID;
+    segment_speed_t last_speed = INVALID_SPEED;
+    for (std::size_t m = 0; m < misses.size(); ++m)
+    {
+        if (result.sources[misses[m]] != SpeedSource::None)
+            continue;
+
+        const auto way_id = miss_ways[m];
+        if (way_id != last_way && way_id < db->way_tag_ranges.size())
+        {
+            last_way = way_id;
+            last_speed = INVALID_SPEED;
+            const auto range = db->way_tag_ranges[way_id];
+            for (auto t = range.first; t < range.second; ++t)
+            {
+                const auto key_id = db->key_value_pairs[t].first;
+                auto found = is_maxspeed.find(key_id);
+                if (found == is_maxspeed.end())
+                    found = is_maxspeed.emplace(key_id, db->getstring(key_id) == "maxspeed").first;
+                if (!found->second)
+                    continue;
+                segment_speed_t speed;
+                if (parse_maxspeed(db->getstring(db->key_value_pairs[t].second), speed))
+                    last_speed = speed;
+                break;
+            }
+        }
+        if (way_id == last_way && last_speed != INVALID_SPEED)
+        {
+            result.speeds[misses[m]] = last_speed;
+            result.sources[misses[m]] = SpeedSource::Maxspeed;
+        }
+    }
+    return result;
+}
+
+bool SpeedFallback::parse_maxspeed(const std::string &value, segment_speed_t &speed)
+{
+    const char *begin = value.c_str();
+    char *end = nullptr;
+    const double number = std::strtod(begin, &end);
+    if (end == begin || !(number >= 0))
+        return false;
+
+    while (*end == ' ')
+        ++end;
+    const std::string unit(end);
+
+    double kmh;
+    if (unit.empty() || unit == "km/h" || unit == "kmh" || unit == "kph")
+        kmh = number;
+    else if (unit == "mph")
+        kmh = number * kKmPerMile;
+    else
+        return false;
+
+    const auto rounded = std::round(kmh);
+    if (rounded > INVALID_SPEED - 1)
+        return false;
+    speed = static_cast<segment_speed_t>(rounded);
+    return true;
+}
+
+wayid_t SpeedFallback::find_way(const external_nodeid_t from, const external_nodeid_t to) const
+{
+    const auto a = db->external_internal_map.find(from);
+    const auto b = db->external_internal_map.find(to);
+    if (a == db->external_internal_map.end() || b == db->external_internal_map.end())
+        return INVALID_WAYID;
+
+    // Node pairs are stored with the lower internal id first
+    const auto pair = a->second < b->second ? std::make_pair(a->second, b->second)
+                                            : std::make_pair(b->second, a->second);
+    const auto found = db->pair_way_map.find(pair);
+    return found == db->pair_way_map.end() ? INVALID_WAYID : found->second.id;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "database.hpp"
+#include "segment_speed_map.hpp"
+#include "types.hpp"
+#include "way_speed_map.hpp"
+
+/**
+ * Where the speed for a segment came from.  The values are part of the
+ * Javascript API, so don't renumber them.
+ */
+enum class SpeedSource : std::uint8_t
+{
+    None = 0,
+    Segment = 1,
+    Way = 2,
+    Maxspeed = 3
+};
+
+/**
+ * The speed for each segment of a route, and the source each speed came from
+ */
+struct FallbackSpeeds
+{
+    std::vector<segment_speed_t> speeds;
+    std::vector<SpeedSource> sources;
+};
+
+/**
+ * Resolves the speed of each segment of a route through a chain of sources:
+ * the segment speed for the node pair, then the speed for the way the node
+ * pair belongs to, then the maxspeed tag of that way.
+ *
+ * None of the sources are owned, and any of them may be null, in which case
+ * that step of the chain is skipped.
+ */
+class SpeedFallback
+{
+  public:
+    /**
+     * Constructs the fallback chain.
+     *
+     * @param db the database used to find the way for a node pair and its tags
+     * @param segments segment speeds, keyed by OSM node id pairs
+     * @param ways way speeds, keyed by OSM way id
+     */
+    SpeedFallback(const Database *db, const SegmentSpeedMap *segments, const WaySpeedMap *ways);
+
+    /**
+     * Given a list of nodes, returns the speed for each sequential pair.
+     * Pairs that none of the sources know about get INVALID_SPEED and
+     * SpeedSource::None.
+     *
+     * @param route a list of OSM node ids
+     * @return the speed and its source for each pair of nodes
+     */
+    FallbackSpeeds getValues(const std::vector<external_nodeid_t> &route) const;
+
+    /**
+     * Parses the value of a maxspeed tag in km/h or mph, e.g. "50", "50 km/h"
+     * or "30 mph".  Symbolic values like "none" or "DE:urban" aren't parsed.
+     *
+     * @param value the tag value
+     * @param speed receives the speed in km/h
+     * @return true if the value was a speed below INVALID_SPEED
+     */
+    static bool parse_maxspeed(const std::string &value, segment_speed_t &speed);
+
+  private:
+    // Finds the internal way id for a pair of OSM nodes, INVALID_WAYID if there is none
+    wayid_t find_way(const external_nodeid_t from, const external_nodeid_t to) const;
+
+    const Database *db;
+    const SegmentSpeedMap *segments;
+    const WaySpeedMap *ways;
+};
@@ -0,0 +1,44 @@
+#include "speed_stats.hpp"
+
+#include <algorithm>
+
+SpeedStats compute_speed_stats(const std::vector<segment_speed_t> &speeds)
+{
+    SpeedStats stats;
+    stats.total = speeds.size();
+
+    double sum = 0;
+    double inverse_sum = 0;
+    bool stopped = false;
+    for (const auto speed : speeds)
+    {
+        if (speed == INVALID_SPEED)
+            continue;
+
+        if (stats.valid == 0)
+        {
+            stats.min = speed;
+            stats.max = speed;
+        }
+        else
+        {
+            stats.min = std::min<double>(stats.min, speed);
+            stats.max = std::max<double>(stats.max, speed);
+        }
+        ++stats.valid;
+        sum += speed;
+        if (speed == 0)
+            stopped = true;
+        else
+            inverse_sum += 1.0 / speed;
+    }
+
+    if (stats.valid > 0)
+    {
+        stats.mean = sum / stats.valid;
+        stats.harmonic_mean = stopped ? 0 : stats.valid / inverse_sum;
+    }
+    if (stats.total > 0)
+        stats.coverage = static_cast<double>(stats.valid) / stats.total;
+    return stats;
+}
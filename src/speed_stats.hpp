@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "types.hpp"
+
+/**
+ * Summary statistics for the speeds along a route.  Segments with
+ * INVALID_SPEED are left out of the speed figures and only count towards
+ * the coverage.
+ */
+struct SpeedStats
+{
+    // The smallest, largest and average speed of the segments that have one
+    double min = 0;
+    double max = 0;
+    double mean = 0;
+    // The travel time weighted mean, assuming segments of equal length: the
+    // number of segments divided by the sum of the inverse speeds.  0 if any
+    // segment has a speed of 0.
+    double harmonic_mean = 0;
+    // The share of segments that have a speed, between 0 and 1
+    double coverage = 0;
+    // The number of segments that have a speed, the speed figures are only
+    // meaningful if this isn't 0
+    std::size_t valid = 0;
+    std::size_t total = 0;
+};
+
+/**
+ * Computes summary statistics for the speeds of a route.
+ *
+ * @param speeds the speed of each segment, as returned by getValues
+ * @return the statistics, all zero for an empty route
+ */
+SpeedStats compute_speed_stats(const std::vector<segment_speed_t> &speeds);
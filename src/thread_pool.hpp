@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads for the parallel parts of requests.
+ *
+ * Requests already run on libuv's threadpool, so rather than starting threads
+ * of their own they share the workers of ThreadPool::shared(), however many
+ * run at once.  The calling thread takes part in its own work, so a request
+ * keeps making progress while every worker is busy with other requests.
+ */
+class ThreadPool
+{
+  public:
+    explicit ThreadPool(const std::size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * The pool shared by the process, with one worker per hardware thread
+     */
+    static ThreadPool &shared();
+
+    /**
+     * The number of workers
+     */
+    std::size_t size() const { return workers.size(); }
+
+    /**
+     * Calls f(i) for each i in [0, count), on the calling thread and up to
+     * threads - 1 workers.  Indices are handed out one at a time so that
+     * uneven tasks balance out.
+     *
+     * @throws the first exception thrown by f, once every call has returned
+     */
+    template <typename F> void for_each_index(const std::size_t count, std::size_t threads, F &&f);
+
+  private:
+    void post(std::function<void()> task);
+    void work();
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stopping = false;
+};
+
+template <typename F>
+void ThreadPool::for_each_index(const std::size_t count, std::size_t threads, F &&f)
+{
+    threads = std::min({threads, count, size() + 1});
+    if (threads <= 1)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            f(i);
+        return;
+    }
+
+    // Shared with the workers, which may only get to their task once every index is taken
+    struct State
+    {
+        std::atomic<std::size_t> next{0};
+        std::size_t finished = 0;
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    const auto state = std::make_shared<State>();
+
+    // f is only called for indices taken before the calling thread returns
+    const auto work = [state, count, &f]() {
+        std::size_t finished = 0;
+        std::exception_ptr error;
+        for (auto i = state->next++; i < count; i = state->next++)
+        {
+            try
+            {
+                f(i);
+            }
+            catch (...)
+            {
+                if (!error)
+                    error = std::current_exception();
+            }
+            ++finished;
+        }
+        if (finished == 0)
+            return;
+
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (error && !state->error)
+            state->error = error;
+        state->finished += finished;
+        if (state->finished == count)
+            state->done.notify_all();
+    };
+
+    for (std::size_t i = 1; i < threads; ++i)
+        post(work);
+    work();
+
+    // The error is taken out of the state, which a worker may be the last to release
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done.wait(lock, [&state, count]() { return state->finished == count; });
+        error = std::move(state->error);
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
@@ -1,8 +1,11 @@
 #pragma once
 
 #include <boost/geometry.hpp>
+#include <boost/geometry/geometries/register/point.hpp>
 #include <boost/geometry/index/rtree.hpp>
 
+#include <cmath>
+#include <cstdint>
 #include <unordered_map>
 
 // Type declarations for node ids and way ids.  We don't need the full 64 bits
@@ -12,13 +15,29 @@ typedef std::uint32_t internal_nodeid_t;
 typedef std::uint32_t wayid_t;
 typedef std::uint8_t segment_speed_t;
 
+typedef std::uint32_t edgeid_t;
+
 constexpr float kKmPerMile = 1.609344f;
 
-// Way ID, and whether it the node pair for it is stored forward or backward
+// A speed in km/h, converted from mph if mph is set and rounded.  Wide enough for any 32 bit speed
+// in mph, so that it can be range checked before it is narrowed.
+inline std::uint64_t speed_to_kph(const std::uint32_t speed, const bool mph)
+{
+    if (!mph)
+        return speed;
+    return static_cast<std::uint64_t>(std::round(speed * static_cast<double>(kKmPerMile)));
+}
+
+static constexpr edgeid_t INVALID_EDGEID = std::numeric_limits<edgeid_t>::max();
+
+// Way ID, and whether it the node pair for it is stored forward or backward.
+// Node pairs are numbered densely as they are added, so data for them can be
+// kept in arrays indexed by edge id.
 typedef struct
 {
     wayid_t id;
     bool forward;
+    edgeid_t edge = INVALID_EDGEID;
 } way_storage_t;
 
 static constexpr segment_speed_t INVALID_SPEED = std::numeric_limits<segment_speed_t>::max();
@@ -30,7 +49,37 @@ static constexpr wayid_t INVALID_WAYID = std::numeric_limits<wayid_t>::max();
 typedef boost::geometry::model::
     point<double, 2, boost::geometry::cs::spherical_equatorial<boost::geometry::degree>>
         point_t;
-typedef std::pair<point_t, internal_nodeid_t> value_t;
+
+// Coordinates in the coordinate index are stored as integers with 7 decimal
+// places (the same as osmium::Location), which is about 1cm of precision and
+// half the size of a pair of doubles.
+static constexpr double COORDINATE_PRECISION = 1e7;
+
+struct fixed_point_t
+{
+    fixed_point_t() : lon(0), lat(0) {}
+    fixed_point_t(const std::int32_t lon, const std::int32_t lat) : lon(lon), lat(lat) {}
+    fixed_point_t(const point_t &point)
+        : lon(static_cast<std::int32_t>(std::round(point.get<0>() * COORDINATE_PRECISION))),
+          lat(static_cast<std::int32_t>(std::round(point.get<1>() * COORDINATE_PRECISION)))
+    {
+    }
+
+    point_t to_point() const
+    {
+        return point_t{lon / COORDINATE_PRECISION, lat / COORDINATE_PRECISION};
+    }
+
+    std::int32_t lon;
+    std::int32_t lat;
+};
+
+// The index itself is planar over the fixed point values, distances are
+// computed on the sphere once candidates have been found.
+BOOST_GEOMETRY_REGISTER_POINT_2D(
+    fixed_point_t, std::int32_t, boost::geometry::cs::cartesian, lon, lat)
+
+typedef std::pair<fixed_point_t, internal_nodeid_t> value_t;
 
 // Data types for our lookup tables
 typedef std::pair<internal_nodeid_t, internal_nodeid_t> internal_nodepair_t;
@@ -39,6 +88,15 @@ typedef std::unordered_map<external_nodeid_t, internal_nodeid_t> external_intern
 
 typedef std::vector<wayid_t> annotated_route_t;
 
+// A run of consecutive route segments that touch the same way
+struct way_run_t
+{
+    wayid_t way_id;
+    std::uint32_t start;
+    std::uint32_t count;
+};
+typedef std::vector<way_run_t> annotated_runs_t;
+
 // Every unique string gets an ID of this type
 typedef std::uint32_t stringid_t;
 
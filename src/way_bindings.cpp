@@ -1,8 +1,35 @@
 #include "way_bindings.hpp"
+#include "binding_utils.hpp"
 #include "types.hpp"
 #include <algorithm>
 #include <vector>
 
+namespace
+{
+// Reads the storage option of the load methods, throws a TypeError and returns false if it
+// isn't 'hashtable' or 'radix'
+bool getStorageOption(const v8::Local<v8::Object> options, WaySpeedMap::Storage &storage)
+{
+    const auto storageValue =
+        Nan::Get(options, Nan::New("storage").ToLocalChecked()).ToLocalChecked();
+    if (storageValue->IsUndefined())
+        return true;
+
+    const Nan::Utf8String storageName(storageValue);
+    const std::string name = storageValue->IsString() && *storageName ? *storageName : "";
+    if (name == "radix")
+        storage = WaySpeedMap::Storage::Radix;
+    else if (name == "hashtable")
+        storage = WaySpeedMap::Storage::Hashtable;
+    else
+    {
+        Nan::ThrowTypeError("storage option should be 'hashtable' or 'radix'");
+        return false;
+    }
+    return true;
+}
+} // namespace
+
 NAN_MODULE_INIT(WaySpeedLookup::Init)
 {
     const auto whoami = Nan::New("WaySpeedLookup").ToLocalChecked();
@@ -12,7 +39,11 @@ NAN_MODULE_INIT(WaySpeedLookup::Init)
     fnTp->InstanceTemplate()->SetInternalFieldCount(1);
 
     SetPrototypeMethod(fnTp, "loadCSV", loadCSV);
+    SetPrototypeMethod(fnTp, "loadCSVFromBuffer", loadCSVFromBuffer);
     SetPrototypeMethod(fnTp, "getRouteSpeeds", getRouteSpeeds);
+    SetPrototypeMethod(fnTp, "getRouteSpeedStats", getRouteSpeedStats);
+    SetPrototypeMethod(fnTp, "getFilterStats", getFilterStats);
+    SetPrototypeMethod(fnTp, "getStorageStats", getStorageStats);
 
     const auto fn = Nan::GetFunction(fnTp).ToLocalChecked();
     constructor().Reset(fn);
@@ -42,15 +73,22 @@ NAN_METHOD(WaySpeedLookup::New)
  * Loads a csv file asynchronously
  * @function loadCSV
  * @param {string} path the path to the CSV file to load
+ * @param {object} [options] {storage: 'radix'} stores speeds in a table indexed by way id
+ *     instead of a hashtable
  * @param {function} callback function to call when the file is done loading
  */
 NAN_METHOD(WaySpeedLookup::loadCSV)
 {
     // In case we already loaded a dataset, this function will transactionally swap in a new one
-    if (info.Length() != 2 || (!info[0]->IsString() && !info[0]->IsArray()) ||
-        !info[1]->IsFunction())
+    const auto argc = info.Length();
+    if ((argc != 2 && argc != 3) || (!info[0]->IsString() && !info[0]->IsArray()) ||
+        !info[argc - 1]->IsFunction() || (argc == 3 && !info[1]->IsObject()))
         return Nan::ThrowTypeError("String (or array of strings) and callback expected");
 
+    auto storage = WaySpeedMap::Storage::Hashtable;
+    if (argc == 3 && !getStorageOption(info[1].As<v8::Object>(), storage))
+        return;
+
     std::vector<std::string> paths;
 
     if (info[0]->IsString())
@@ -88,8 +126,10 @@ NAN_METHOD(WaySpeedLookup::loadCSV)
     {
         explicit CSVLoader(v8::Local<v8::Object> self_,
                            Nan::Callback *callback,
-                           std::vector<std::string> paths_)
-            : Nan::AsyncWorker(callback, "annotator:speed.load"), paths{std::move(paths_)}
+                           std::vector<std::string> paths_,
+                           WaySpeedMap::Storage storage_)
+            : Nan::AsyncWorker(callback, "annotator:speed.load"), paths{std::move(paths_)},
+              storage{storage_}
         {
             SaveToPersistent("self", self_);
         }
@@ -98,7 +138,7 @@ NAN_METHOD(WaySpeedLookup::loadCSV)
         {
             try
             {
-                map = std::make_shared<WaySpeedMap>();
+                map = std::make_shared<WaySpeedMap>(storage);
                 for (const auto &path : paths)
                 {
                     map->loadCSV(path);
@@ -124,11 +164,85 @@ NAN_METHOD(WaySpeedLookup::loadCSV)
         }
 
         std::vector<std::string> paths;
+        WaySpeedMap::Storage storage;
+        std::shared_ptr<WaySpeedMap> map;
+    };
+
+    auto *callback = new Nan::Callback{info[argc - 1].As<v8::Function>()};
+    Nan::AsyncQueueWorker(new CSVLoader{info.Holder(), callback, std::move(paths), storage});
+}
+
+/**
+ * Loads CSV data from a Buffer asynchronously.  The data is parsed in place, without a copy or
+ * a temporary file.
+ * @function loadCSVFromBuffer
+ * @param {Buffer} buffer the CSV data, which must not be modified before the callback is called
+ * @param {object} [options] {storage: 'radix'} stores speeds in a table indexed by way id
+ *     instead of a hashtable
+ * @param {function} callback function to call when the data is done loading
+ */
+NAN_METHOD(WaySpeedLookup::loadCSVFromBuffer)
+{
+    // In case we already loaded a dataset, this function will transactionally swap in a new one
+    const auto argc = info.Length();
+    if ((argc != 2 && argc != 3) || !node::Buffer::HasInstance(info[0]) ||
+        !info[argc - 1]->IsFunction() || (argc == 3 && !info[1]->IsObject()))
+        return Nan::ThrowTypeError("Buffer and callback expected");
+
+    auto storage = WaySpeedMap::Storage::Hashtable;
+    if (argc == 3 && !getStorageOption(info[1].As<v8::Object>(), storage))
+        return;
+
+    struct BufferLoader final : Nan::AsyncWorker
+    {
+        explicit BufferLoader(v8::Local<v8::Object> self_,
+                              Nan::Callback *callback,
+                              v8::Local<v8::Object> buffer,
+                              WaySpeedMap::Storage storage_)
+            : Nan::AsyncWorker(callback, "annotator:speed.load"),
+              data{node::Buffer::Data(buffer)}, size{node::Buffer::Length(buffer)},
+              storage{storage_}
+        {
+            SaveToPersistent("self", self_);
+            // Keeps the buffer alive while its data is parsed in the worker
+            SaveToPersistent("buffer", buffer);
+        }
+
+        void Execute() override
+        {
+            try
+            {
+                map = std::make_shared<WaySpeedMap>(storage);
+                map->loadCSVBuffer(data, size, "buffer");
+            }
+            catch (const std::exception &e)
+            {
+                return SetErrorMessage(e.what());
+            }
+        }
+
+        void HandleOKCallback() override
+        {
+            Nan::HandleScope scope;
+            auto self = GetFromPersistent("self")
+                            ->ToObject(v8::Isolate::GetCurrent()->GetCurrentContext())
+                            .ToLocalChecked();
+            auto *unwrapped = Nan::ObjectWrap::Unwrap<WaySpeedLookup>(self);
+            swap(unwrapped->datamap, map);
+            const constexpr auto argc = 1u;
+            v8::Local<v8::Value> argv[argc] = {Nan::Null()};
+            callback->Call(argc, argv, async_resource);
+        }
+
+        const char *data;
+        std::size_t size;
+        WaySpeedMap::Storage storage;
         std::shared_ptr<WaySpeedMap> map;
     };
 
-    auto *callback = new Nan::Callback{info[1].As<v8::Function>()};
-    Nan::AsyncQueueWorker(new CSVLoader{info.Holder(), callback, std::move(paths)});
+    auto *callback = new Nan::Callback{info[argc - 1].As<v8::Function>()};
+    Nan::AsyncQueueWorker(
+        new BufferLoader{info.Holder(), callback, info[0].As<v8::Object>(), storage});
 }
 
 /**
@@ -223,6 +337,140 @@ NAN_METHOD(WaySpeedLookup::getRouteSpeeds)
         new Worker{self->datamap, new Nan::Callback{callback}, std::move(ways_to_query)});
 }
 
+/**
+ * Summarises the speeds for ways
+ * @function getRouteSpeedStats
+ * @param {array} ways an array of ways IDs to look up
+ * @param {function} callback receives {min, max, mean, harmonicMean, coverage, valid, total}
+ * @example
+ *   container.getRouteSpeedStats([23,43,12],(err,stats) => {
+ *      console.log(stats.harmonicMean);
+ *   });
+ */
+NAN_METHOD(WaySpeedLookup::getRouteSpeedStats)
+{
+    auto *const self = Nan::ObjectWrap::Unwrap<WaySpeedLookup>(info.Holder());
+
+    if (info.Length() != 2 || !info[0]->IsArray() || !info[1]->IsFunction())
+        return Nan::ThrowTypeError("Two arguments expected: waysIds (Array), Callback");
+
+    auto callback = info[1].As<v8::Function>();
+    const auto jsWayIds = info[0].As<v8::Array>();
+    // Guard against empty or one nodeId for which no wayId can be assigned
+    if (jsWayIds->Length() < 1)
+        return Nan::ThrowTypeError(
+            "getRouteSpeedStats expects 'wayIds' (Array(Number)) of at least length 1");
+
+    std::vector<wayid_t> ways_to_query(jsWayIds->Length());
+
+    for (uint32_t i = 0; i < jsWayIds->Length(); ++i)
+    {
+        v8::Local<v8::Value> jsWayId = Nan::Get(jsWayIds, i).ToLocalChecked();
+        if (!jsWayId->IsNumber())
+            return Nan::ThrowTypeError("WayIds must be an array of numbers");
+        auto signedWayId = Nan::To<int32_t>(jsWayId).FromJust();
+        if (signedWayId < 0)
+            return Nan::ThrowTypeError(
+                "getRouteSpeedStats expects 'wayId' within (Array(Number))to be non-negative");
+
+        wayid_t wayId = static_cast<wayid_t>(signedWayId);
+        ways_to_query[i] = wayId;
+    }
+
+    struct Worker final : Nan::AsyncWorker
+    {
+        using Base = Nan::AsyncWorker;
+
+        Worker(std::shared_ptr<WaySpeedMap> datamap_,
+               Nan::Callback *callback,
+               std::vector<wayid_t> wayIds)
+            : Base(callback, "annotator:speed.statsfromwayids"), datamap{datamap_},
+              wayIds(std::move(wayIds))
+        {
+        }
+
+        void Execute() override
+        {
+            if (datamap)
+            {
+                stats = compute_speed_stats(datamap->getValues(wayIds));
+            }
+            else
+            {
+                stats = compute_speed_stats(
+                    std::vector<segment_speed_t>(wayIds.size(), INVALID_SPEED));
+            }
+        }
+
+        void HandleOKCallback() override
+        {
+            Nan::HandleScope scope;
+
+            const auto argc = 2u;
+            v8::Local<v8::Value> argv[argc] = {Nan::Null(), speedStatsToObject(stats)};
+
+            callback->Call(argc, argv, async_resource);
+        }
+
+        std::shared_ptr<WaySpeedMap> datamap;
+        std::vector<wayid_t> wayIds;
+        SpeedStats stats;
+    };
+
+    Nan::AsyncQueueWorker(
+        new Worker{self->datamap, new Nan::Callback{callback}, std::move(ways_to_query)});
+}
+
+/**
+ * Reports the filter that answers lookups for ways without a speed
+ * @function getFilterStats
+ * @return {object} {keys, bytes, falsePositiveRate}, all 0 if no CSV is loaded
+ */
+NAN_METHOD(WaySpeedLookup::getFilterStats)
+{
+    auto *const self = Nan::ObjectWrap::Unwrap<WaySpeedLookup>(info.Holder());
+
+    if (info.Length() != 0)
+        return Nan::ThrowTypeError("No arguments expected");
+
+    BlockedBloomFilter::Stats stats{0, 0, 0};
+    if (self->datamap)
+        stats = self->datamap->filterStats();
+
+    auto result = Nan::New<v8::Object>();
+    Nan::Set(result, Nan::New("keys").ToLocalChecked(),
+             Nan::New<v8::Number>(static_cast<double>(stats.keys)));
+    Nan::Set(result, Nan::New("bytes").ToLocalChecked(),
+             Nan::New<v8::Number>(static_cast<double>(stats.memory_bytes)));
+    Nan::Set(result, Nan::New("falsePositiveRate").ToLocalChecked(),
+             Nan::New<v8::Number>(stats.false_positive_rate));
+    info.GetReturnValue().Set(result);
+}
+
+/**
+ * Reports how the loaded way speeds are stored
+ * @function getStorageStats
+ * @return {object} {ways, bytes, storage}, bytes is an estimate that leaves out the filter
+ */
+NAN_METHOD(WaySpeedLookup::getStorageStats)
+{
+    auto *const self = Nan::ObjectWrap::Unwrap<WaySpeedLookup>(info.Holder());
+
+    if (info.Length() != 0)
+        return Nan::ThrowTypeError("No arguments expected");
+
+    const auto &map = self->datamap;
+    const bool radix = map && map->storage() == WaySpeedMap::Storage::Radix;
+    auto result = Nan::New<v8::Object>();
+    Nan::Set(result, Nan::New("ways").ToLocalChecked(),
+             Nan::New<v8::Number>(map ? static_cast<double>(map->size()) : 0));
+    Nan::Set(result, Nan::New("bytes").ToLocalChecked(),
+             Nan::New<v8::Number>(map ? static_cast<double>(map->memoryBytes()) : 0));
+    Nan::Set(result, Nan::New("storage").ToLocalChecked(),
+             Nan::New(radix ? "radix" : "hashtable").ToLocalChecked());
+    info.GetReturnValue().Set(result);
+}
+
 Nan::Persistent<v8::Function> &WaySpeedLookup::constructor()
 {
     static Nan::Persistent<v8::Function> init;
@@ -14,9 +14,22 @@ class WaySpeedLookup : public Nan::ObjectWrap
 
     static NAN_METHOD(loadCSV);
 
+    static NAN_METHOD(loadCSVFromBuffer);
+
     static NAN_METHOD(getRouteSpeeds);
 
+    static NAN_METHOD(getRouteSpeedStats);
+
+    static NAN_METHOD(getFilterStats);
+
+    static NAN_METHOD(getStorageStats);
+
     static Nan::Persistent<v8::Function> &constructor(); // CPP Land
 
     std::shared_ptr<WaySpeedMap> datamap; // if you want async call
+
+    // Read datamap to resolve speeds together with the other lookups, or to bind the speeds
+    // to the ways of an extract
+    friend class SpeedFallbackLookup;
+    friend class Annotator;
 };
@@ -1,22 +1,25 @@
 #include "way_speed_map.hpp"
+#include "batch_lookup.hpp"
+#include "parallel_load.hpp"
+#include "speed_csv.hpp"
 #include <sparsepp/spp.h>
 
-#include <boost/fusion/adapted/std_pair.hpp>
-#include <boost/iostreams/device/mapped_file.hpp>
-#include <boost/spirit/include/phoenix.hpp>
-#include <boost/spirit/include/qi.hpp>
-#include <boost/spirit/include/support_line_pos_iterator.hpp>
-
 #include <cmath>
 #include <iostream>
+#include <tuple>
 
 using spp::sparse_hash_map;
 
-WaySpeedMap::WaySpeedMap(){};
+WaySpeedMap::WaySpeedMap(const Storage storage) : storage_type(storage){};
 
-WaySpeedMap::WaySpeedMap(const std::string &input_filename) { loadCSV(input_filename); }
+WaySpeedMap::WaySpeedMap(const std::string &input_filename, const Storage storage)
+    : storage_type(storage)
+{
+    loadCSV(input_filename);
+}
 
-WaySpeedMap::WaySpeedMap(const std::vector<std::string> &input_filenames)
+WaySpeedMap::WaySpeedMap(const std::vector<std::string> &input_filenames, const Storage storage)
+    : storage_type(storage)
 {
     for (const auto &input_filename : input_filenames)
     {
@@ -24,30 +27,106 @@ WaySpeedMap::WaySpeedMap(const std::vector<std::string> &input_filenames)
     }
 }
 
-void WaySpeedMap::loadCSV(const std::string &input_filename)
+struct WaySpeedMap::LoadChunk
 {
-    namespace ph = boost::phoenix;
-    namespace qi = boost::spirit::qi;
-
-    boost::iostreams::mapped_file_source mmap(input_filename);
-    auto first = mmap.begin(), last = mmap.end();
-    qi::parse(first, last,
-              -((qi::uint_ >> ',' >> ((+(qi::char_ - ',')) | "" >> qi::lit("")) >> ',' >>
-                 ("mph" >> qi::attr(true) | "kph" >> qi::attr(false) | "" >> qi::attr(false)) >>
-                 ',' >> qi::uint_)[ph::bind(&WaySpeedMap::add, this, qi::_1, qi::_3, qi::_4)] %
-                qi::eol) >>
-                  *qi::eol);
-
-    if (first != last)
+    // Speeds in km/h, by shard
+    std::array<std::vector<std::pair<wayid_t, segment_speed_t>>, SHARDS> ways;
+    // Rows with a speed out of range, reported once the chunk is stored
+    std::vector<std::tuple<wayid_t, bool, std::uint32_t>> invalid;
+};
+
+void WaySpeedMap::loadCSV(const std::string &input_filename, const std::size_t threads)
+{
+    loadRows(threads, [&input_filename](const std::size_t thread_count, auto &parse_chunk,
+                                        auto &store, auto &parse_rest) {
+        return parallel_load::load_file<LoadChunk>(input_filename, thread_count, parse_chunk,
+                                                    store, parse_rest);
+    });
+}
+
+void WaySpeedMap::loadCSVBuffer(const char *data,
+                                const std::size_t size,
+                                const std::string &name,
+                                const std::size_t threads)
+{
+    loadRows(threads, [data, size, &name](const std::size_t thread_count, auto &parse_chunk,
+                                          auto &store, auto &parse_rest) {
+        return parallel_load::load_buffer<LoadChunk>(name, data, data + size, thread_count,
+                                                     parse_chunk, store, parse_rest);
+    });
+}
+
+template <typename LoadRows>
+void WaySpeedMap::loadRows(const std::size_t threads, LoadRows &&load_rows)
+{
+    const auto add_row = [this](const wayid_t way, const bool mph, const std::uint32_t speed) {
+        add(way, mph, speed);
+    };
+
+    const auto parse_chunk = [](const char *first, const char *last, LoadChunk &chunk) {
+        return speed_csv::parse_way_speeds(
+            first, last, [&chunk](const wayid_t way, const bool mph, const std::uint32_t speed) {
+                const auto kph = speed_to_kph(speed, mph);
+                if (kph > INVALID_SPEED - 1)
+                    chunk.invalid.emplace_back(way, mph, speed);
+                else
+                    chunk.ways[shardIndex(BlockedBloomFilter::mix_hash(way))].emplace_back(
+                        way, static_cast<segment_speed_t>(kph));
+            });
+    };
+
+    const auto thread_count = parallel_load::thread_count(threads);
+    const auto store = [this, thread_count, &add_row](std::vector<LoadChunk> &chunks,
+                                                      const std::size_t count) {
+        if (storage_type == Storage::Radix)
+        {
+            // Stores are cheap, but pages are allocated as they are first used
+            for (std::size_t i = 0; i < count; ++i)
+                for (const auto &shard : chunks[i].ways)
+                    for (const auto &way : shard)
+                        set(way.first, way.second);
+        }
+        else
+        {
+            // Each shard takes its rows from the chunks in file order, the last row wins
+            parallel_load::for_each_index(SHARDS, thread_count, [&](const std::size_t shard) {
+                auto &table = annotations[shard];
+                std::size_t rows = table.size();
+                for (std::size_t i = 0; i < count; ++i)
+                    rows += chunks[i].ways[shard].size();
+                table.reserve(rows);
+
+                for (std::size_t i = 0; i < count; ++i)
+                    for (const auto &way : chunks[i].ways[shard])
+                        table[way.first] = way.second;
+            });
+        }
+        for (std::size_t i = 0; i < count; ++i)
+            for (const auto &row : chunks[i].invalid)
+                add_row(std::get<0>(row), std::get<1>(row), std::get<2>(row));
+    };
+
+    const auto parse_rest = [&add_row](const char *first, const char *last) {
+        return speed_csv::parse_way_speeds(first, last, add_row);
+    };
+
+    std::string error;
+    try
+    {
+        error = load_rows(thread_count, parse_chunk, store, parse_rest);
+    }
+    catch (...)
     {
-        auto bol = first - 1;
-        while (bol > mmap.begin() && *bol != '\n')
-            --bol;
-        auto line_number = std::count(mmap.begin(), first, '\n') + 1;
-        throw std::runtime_error("CSV parsing failed at " + input_filename + ':' +
-                                 std::to_string(line_number) + ": " +
-                                 std::string(bol + 1, std::find(first, last, '\n')));
+        // A compressed file may turn out to be corrupt after some of its rows were stored
+        buildFilter();
+        throw;
     }
+
+    // Also covers the rows read before a parse error
+    buildFilter();
+
+    if (!error.empty())
+        throw std::runtime_error(error);
 }
 
 void WaySpeedMap::add(const wayid_t &way, const bool &mph, const std::uint32_t &speed)
@@ -55,7 +134,7 @@ void WaySpeedMap::add(const wayid_t &way, const bool &mph, const std::uint32_t &
 
     if (mph)
     {
-        std::uint32_t s = std::round(speed * kKmPerMile);
+        const auto s = speed_to_kph(speed, mph);
 
         if (s > INVALID_SPEED - 1)
         {
@@ -63,7 +142,7 @@ void WaySpeedMap::add(const wayid_t &way, const bool &mph, const std::uint32_t &
                       << " Speed: " << std::to_string(s) << std::endl;
         }
         else
-            annotations[way] = s;
+            set(way, static_cast<segment_speed_t>(s));
     }
     else
     {
@@ -73,17 +152,92 @@ void WaySpeedMap::add(const wayid_t &way, const bool &mph, const std::uint32_t &
                       << " Speed: " << std::to_string(speed) << std::endl;
         }
         else
-            annotations[way] = speed;
+            set(way, speed);
+    }
+}
+
+void WaySpeedMap::set(const wayid_t way, const segment_speed_t speed)
+{
+    if (storage_type == Storage::Hashtable)
+    {
+        annotations[shardIndex(BlockedBloomFilter::mix_hash(way))][way] = speed;
+        return;
+    }
+
+    const auto page = way >> PAGE_BITS;
+    if (page >= pages.size())
+        pages.resize(page + 1);
+    if (!pages[page])
+    {
+        pages[page] = std::make_unique<Page>();
+        pages[page]->fill(INVALID_SPEED);
     }
+    auto &value = (*pages[page])[way & (PAGE_SIZE - 1)];
+    if (value == INVALID_SPEED)
+        ++radix_size;
+    value = speed;
+}
+
+void WaySpeedMap::buildFilter()
+{
+    if (storage_type == Storage::Radix)
+        return;
+    filter.reset(size());
+    for (const auto &shard : annotations)
+        for (const auto &annotation : shard)
+            filter.insert(BlockedBloomFilter::mix_hash(annotation.first));
+}
+
+BlockedBloomFilter::Stats WaySpeedMap::filterStats() const { return filter.stats(); }
+
+std::size_t WaySpeedMap::size() const
+{
+    if (storage_type == Storage::Radix)
+        return radix_size;
+
+    std::size_t ways = 0;
+    for (const auto &shard : annotations)
+        ways += shard.size();
+    return ways;
 }
 
-bool WaySpeedMap::hasKey(const wayid_t &way) const { return (annotations.count(way) > 0); }
+std::size_t WaySpeedMap::memoryBytes() const
+{
+    if (storage_type == Storage::Hashtable)
+        return size() * sizeof(shard_t::value_type);
+
+    std::size_t bytes = pages.size() * sizeof(decltype(pages)::value_type);
+    for (const auto &page : pages)
+        if (page)
+            bytes += sizeof(Page);
+    return bytes;
+}
+
+bool WaySpeedMap::hasKey(const wayid_t &way) const
+{
+    if (storage_type == Storage::Radix)
+        return radixValue(way) != INVALID_SPEED;
+    const auto hash = BlockedBloomFilter::mix_hash(way);
+    if (!filter.maybe_contains(hash))
+        return false;
+    return (annotations[shardIndex(hash)].count(way) > 0);
+}
 
 segment_speed_t WaySpeedMap::getValue(const wayid_t &way) const
 {
+    if (storage_type == Storage::Radix)
+    {
+        const auto speed = radixValue(way);
+        if (speed == INVALID_SPEED)
+            throw std::runtime_error("Way ID " + std::to_string(way) +
+                                     " doesn't exist in the radix table.");
+        return speed;
+    }
+
     // Save the result of find so that we don't need to repeat the lookup to get the value
-    auto result = annotations.find(way);
-    if (result == annotations.end())
+    const auto &shard = annotations[shardIndex(BlockedBloomFilter::mix_hash(way))];
+    auto result = shard.find(way);
+    if (result == shard.end())
         throw std::runtime_error("Way ID " + std::to_string(way) +
                                  " doesn't exist in the hashmap.");
 
@@ -98,13 +252,30 @@ std::vector<segment_speed_t> WaySpeedMap::getValues(const std::vector<wayid_t> &
         throw std::runtime_error("Way Array should have at least 1 way ID for getValues method.");
 
     speeds.resize(route.size());
-    for (std::size_t way_index = 0; way_index < speeds.size(); ++way_index)
+    if (storage_type == Storage::Radix)
     {
-        auto result = annotations.find(route[way_index]);
-        if (result == annotations.end())
-            speeds[way_index] = INVALID_SPEED;
-        else
-            speeds[way_index] = result->second;
+        for (std::size_t way_index = 0; way_index < route.size(); ++way_index)
+            speeds[way_index] = radixValue(route[way_index]);
+        return speeds;
     }
+
+    // Most ways have no speed and are answered by the filter, prefetch its blocks
+    batch_lookup(
+        speeds.size(),
+        [&route](const std::size_t i) { return BlockedBloomFilter::mix_hash(route[i]); },
+        [this](const std::uint64_t hash) { filter.prefetch(hash); },
+        [&](const std::size_t way_index, const std::uint64_t hash) {
+            if (!filter.maybe_contains(hash))
+            {
+                speeds[way_index] = INVALID_SPEED;
+                return;
+            }
+            const auto &shard = annotations[shardIndex(hash)];
+            auto result = shard.find(route[way_index]);
+            if (result == shard.end())
+                speeds[way_index] = INVALID_SPEED;
+            else
+                speeds[way_index] = result->second;
+        });
     return speeds;
 }
@@ -1,11 +1,14 @@
 #ifndef WAY_SPEED_MAP_H
 #define WAY_SPEED_MAP_H
 
+#include <array>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <sparsepp/spp.h>
 #include <vector>
 
+#include "bloom_filter.hpp"
 #include "types.hpp"
 
 using spp::sparse_hash_map;
@@ -13,25 +16,59 @@ using spp::sparse_hash_map;
 class WaySpeedMap
 {
   public:
+    /**
+     * How way speeds are stored
+     */
+    enum class Storage
+    {
+        // A hashtable of the ways with a speed, behind a Bloom filter
+        Hashtable,
+        // A table indexed by way id, in pages of PAGE_SIZE ids that are only
+        // allocated once a way in them has a speed.  Every lookup is a single
+        // load, and a populated page takes one byte per id.  Best when ways with
+        // a speed cover most of the id range, as pages are allocated whole.
+        Radix
+    };
+
     /**
      * Do-nothing constructor
      */
-    WaySpeedMap();
+    WaySpeedMap(const Storage storage = Storage::Hashtable);
 
     /**
      * Loads from,to,speed data from a single file
      */
-    WaySpeedMap(const std::string &input_filename);
+    WaySpeedMap(const std::string &input_filename, const Storage storage = Storage::Hashtable);
 
     /**
      * Loads way,speed data from multiple files
      */
-    WaySpeedMap(const std::vector<std::string> &input_filenames);
+    WaySpeedMap(const std::vector<std::string> &input_filenames,
+                const Storage storage = Storage::Hashtable);
 
     /**
-     * Parses and loads another CSV file into the existing data
+     * Parses and loads another CSV file into the existing data.
+     *
+     * Large files are parsed in chunks on several threads, and each shard of
+     * the hashtable is filled on a thread of its own.  A way that is in the
+     * file more than once keeps the speed of its last row.
+     *
+     * @param threads the number of threads, 0 for one per hardware thread
      */
-    void loadCSV(const std::string &input_filename);
+    void loadCSV(const std::string &input_filename, const std::size_t threads = 0);
+
+    /**
+     * Parses and loads CSV data in memory into the existing data, as loadCSV
+     * does for a file.  The data is parsed in place.
+     *
+     * @param name the name of the data in error messages
+     * @param threads the number of threads, 0 for one per hardware thread
+     * @throws a runtime_exception if the data is compressed
+     */
+    void loadCSVBuffer(const char *data,
+                       const std::size_t size,
+                       const std::string &name,
+                       const std::size_t threads = 0);
 
     /**
      * Adds a single way, speed key value pair
@@ -56,8 +93,82 @@ class WaySpeedMap
      */
     std::vector<segment_speed_t> getValues(const std::vector<wayid_t> &ways) const;
 
+    /**
+     * Reports the size and false positive rate of the filter that answers
+     * lookups for ways without a speed
+     */
+    BlockedBloomFilter::Stats filterStats() const;
+
+    Storage storage() const { return storage_type; }
+
+    /**
+     * The number of ways with a speed
+     */
+    std::size_t size() const;
+
+    /**
+     * Estimates the memory used by the stored ways and speeds, not counting
+     * the filter
+     */
+    std::size_t memoryBytes() const;
+
+    static constexpr std::size_t PAGE_BITS = 16;
+    static constexpr std::size_t PAGE_SIZE = std::size_t{1} << PAGE_BITS;
+
   private:
-    sparse_hash_map<wayid_t, segment_speed_t> annotations;
+    // The rows of one chunk of CSV data
+    struct LoadChunk;
+
+    /**
+     * Loads rows with load_rows(threads, parse_chunk, store, parse_rest), which
+     * returns the parse error or an empty string, then rebuilds the filter
+     */
+    template <typename LoadRows> void loadRows(const std::size_t threads, LoadRows &&load_rows);
+
+    // Ways are spread over shards by the top bits of their filter hash, so that
+    // loading can fill the shards in parallel
+    static constexpr std::size_t SHARD_BITS = 4;
+    static constexpr std::size_t SHARDS = std::size_t{1} << SHARD_BITS;
+
+    typedef sparse_hash_map<wayid_t, segment_speed_t> shard_t;
+
+    static std::size_t shardIndex(const std::uint64_t hash)
+    {
+        return static_cast<std::size_t>(hash >> (64 - SHARD_BITS));
+    }
+
+    /**
+     * Rebuilds the presence filter over all ways, after loading.  Radix
+     * storage answers misses with one load and needs no filter.
+     */
+    void buildFilter();
+
+    /**
+     * Stores the speed for a way, replacing any earlier one
+     */
+    void set(const wayid_t way, const segment_speed_t speed);
+
+    /**
+     * Looks up a way in the radix table
+     * @return the speed, or INVALID_SPEED if the way has none
+     */
+    segment_speed_t radixValue(const wayid_t way) const
+    {
+        const auto page = way >> PAGE_BITS;
+        if (page >= pages.size() || !pages[page])
+            return INVALID_SPEED;
+        return (*pages[page])[way & (PAGE_SIZE - 1)];
+    }
+
+    typedef std::array<segment_speed_t, PAGE_SIZE> Page;
+
+    Storage storage_type;
+    std::array<shard_t, SHARDS> annotations;
+    BlockedBloomFilter filter;
+
+    // Radix storage, pages of speeds indexed by the upper bits of the way id
+    std::vector<std::unique_ptr<Page>> pages;
+    std::size_t radix_size = 0;
 };
 
 #endif
@@ -35,6 +35,9 @@ BOOST_AUTO_TEST_CASE(annotator_test_no_rtree)
 
     BOOST_CHECK_EQUAL(annotator.get_tag_key(tagrange.first), "highway");
     BOOST_CHECK_EQUAL(annotator.get_tag_value(tagrange.first), "primary");
+    BOOST_CHECK_EQUAL(annotator.get_tag_key_id(tagrange.first), keyid);
+    BOOST_CHECK_EQUAL(annotator.get_string(keyid), "highway");
+    BOOST_CHECK_EQUAL(annotator.get_way_count(), 1);
 }
 
 BOOST_AUTO_TEST_CASE(annotator_test_basic)
@@ -121,4 +124,278 @@ BOOST_AUTO_TEST_CASE(annotator_test_coordinates)
     BOOST_CHECK_EQUAL(result[3], INVALID_INTERNAL_NODEID);
 }
 
+BOOST_AUTO_TEST_CASE(annotator_test_connected_snapping)
+{
+    // Node 0 is the closest node to the first coordinate, but only node 1
+    // (about 1.1m further east) is connected to node 2.
+    Database db(true);
+    db.used_nodes_list.emplace_back(point_t{1, 1}, 0);
+    db.used_nodes_list.emplace_back(point_t{1.00001, 1}, 1);
+    db.used_nodes_list.emplace_back(point_t{1.001, 1}, 2);
+    db.way_tag_ranges.emplace_back(0, 0);
+    db.pair_way_map.emplace(internal_nodepair_t{1, 2}, way_storage_t{0, true});
+    db.build_rtree();
+    db.compact();
+
+    std::vector<point_t> coordinates{point_t{1.000004, 1}, point_t{1.001, 1}, point_t{3, 3}};
+
+    RouteAnnotator nearest(db);
+    auto result = nearest.coordinates_to_internal(coordinates);
+    BOOST_CHECK_EQUAL(result.size(), 3);
+    BOOST_CHECK_EQUAL(result[0], 0);
+    BOOST_CHECK_EQUAL(result[1], 2);
+    BOOST_CHECK_EQUAL(result[2], INVALID_INTERNAL_NODEID);
+
+    RouteAnnotator::Options options;
+    options.snap_candidates = 4;
+    RouteAnnotator connected(db, options);
+    result = connected.coordinates_to_internal(coordinates);
+    BOOST_CHECK_EQUAL(result.size(), 3);
+    BOOST_CHECK_EQUAL(result[0], 1);
+    BOOST_CHECK_EQUAL(result[1], 2);
+    BOOST_CHECK_EQUAL(result[2], INVALID_INTERNAL_NODEID);
+
+    auto ways = connected.annotateRoute(result);
+    BOOST_CHECK_EQUAL(ways[0], 0);
+
+    // Without a connection to choose by, the closest node still wins
+    coordinates = std::vector<point_t>{point_t{1.000004, 1}};
+    result = connected.coordinates_to_internal(coordinates);
+    BOOST_CHECK_EQUAL(result.size(), 1);
+    BOOST_CHECK_EQUAL(result[0], 0);
+
+    // A smaller radius excludes node 1
+    options.snap_radius = 0.5;
+    RouteAnnotator tight(db, options);
+    coordinates = std::vector<point_t>{point_t{1.000001, 1}, point_t{1.001, 1}};
+    result = tight.coordinates_to_internal(coordinates);
+    BOOST_CHECK_EQUAL(result[0], 0);
+    BOOST_CHECK_EQUAL(result[1], 2);
+}
+
+BOOST_AUTO_TEST_CASE(annotator_test_route_cache)
+{
+
+    Database db(false);
+    db.way_tag_ranges.emplace_back(0, 0);
+    db.pair_way_map.emplace(internal_nodepair_t{0, 1}, way_storage_t{0, true});
+    db.compact();
+
+    RouteAnnotator::Options options;
+    options.route_cache_size = 16;
+    RouteAnnotator annotator(db, options);
+
+    std::vector<internal_nodeid_t> route{2, 0, 1};
+    auto result = annotator.annotateRoute(route);
+    BOOST_CHECK_EQUAL(result.size(), 2);
+    BOOST_CHECK_EQUAL(result[0], INVALID_WAYID);
+    BOOST_CHECK_EQUAL(result[1], 0);
+
+    // The same route again comes from the cache and gives the same answer
+    result = annotator.annotateRoute(route);
+    BOOST_CHECK_EQUAL(result.size(), 2);
+    BOOST_CHECK_EQUAL(result[0], INVALID_WAYID);
+    BOOST_CHECK_EQUAL(result[1], 0);
+
+    auto stats = annotator.get_cache_stats();
+    BOOST_CHECK_EQUAL(stats.hits, 1);
+    BOOST_CHECK_EQUAL(stats.misses, 1);
+    BOOST_CHECK_EQUAL(stats.size, 1);
+    BOOST_CHECK_EQUAL(stats.capacity, 16);
+
+    // Without a cache, the counters stay at zero
+    RouteAnnotator uncached(db);
+    uncached.annotateRoute(route);
+    stats = uncached.get_cache_stats();
+    BOOST_CHECK_EQUAL(stats.hits, 0);
+    BOOST_CHECK_EQUAL(stats.misses, 0);
+}
+
+BOOST_AUTO_TEST_CASE(annotator_test_coordinate_cache)
+{
+    Database db(true);
+    db.used_nodes_list.emplace_back(point_t{1, 1}, 7);
+    db.used_nodes_list.emplace_back(point_t{1.0001, 1}, 8);
+    db.build_rtree();
+    db.compact();
+
+    RouteAnnotator::Options options;
+    options.coordinate_cache_size = 16;
+    RouteAnnotator annotator(db, options);
+
+    // The first and last coordinates fall in the same cell
+    std::vector<point_t> points{point_t{1.00000001, 1}, point_t{1.0001, 1}, point_t{2, 2},
+                                point_t{1.00000002, 1}};
+    auto results = annotator.coordinates_to_internal(points);
+    BOOST_CHECK_EQUAL(results.size(), 4);
+    BOOST_CHECK_EQUAL(results[0], 7);
+    BOOST_CHECK_EQUAL(results[1], 8);
+    BOOST_CHECK_EQUAL(results[2], INVALID_INTERNAL_NODEID);
+    BOOST_CHECK_EQUAL(results[3], 7);
+
+    auto stats = annotator.get_coordinate_cache_stats();
+    BOOST_CHECK_EQUAL(stats.hits, 1);
+    BOOST_CHECK_EQUAL(stats.misses, 3);
+    BOOST_CHECK_EQUAL(stats.size, 3);
+    BOOST_CHECK_EQUAL(stats.capacity, 16);
+
+    // Unmatched coordinates are cached too
+    results = annotator.coordinates_to_internal(points);
+    BOOST_CHECK_EQUAL(results[2], INVALID_INTERNAL_NODEID);
+    stats = annotator.get_coordinate_cache_stats();
+    BOOST_CHECK_EQUAL(stats.hits, 5);
+    BOOST_CHECK_EQUAL(stats.misses, 3);
+
+    // Connected snapping doesn't use the cache
+    options.snap_candidates = 2;
+    RouteAnnotator connected(db, options);
+    connected.coordinates_to_internal(points);
+    stats = connected.get_coordinate_cache_stats();
+    BOOST_CHECK_EQUAL(stats.hits, 0);
+    BOOST_CHECK_EQUAL(stats.capacity, 0);
+}
+
+BOOST_AUTO_TEST_CASE(annotator_test_parallel_chunks)
+{
+    // A long line of nodes, one way per pair, with every tenth pair missing
+    Database db(true);
+    const std::size_t node_count = 1000;
+    for (std::size_t i = 0; i < node_count; ++i)
+    {
+        db.used_nodes_list.emplace_back(point_t{1 + i * 0.0001, 1}, i);
+        if (i + 1 < node_count && i % 10 != 9)
+        {
+            db.pair_way_map.emplace(internal_nodepair_t{i, i + 1}, way_storage_t{static_cast<wayid_t>(i), true});
+        }
+    }
+    db.build_rtree();
+    db.compact();
+
+    std::vector<point_t> points;
+    for (std::size_t i = 0; i < node_count; ++i)
+    {
+        points.emplace_back(1 + i * 0.0001, 1);
+    }
+
+    RouteAnnotator serial(db);
+    RouteAnnotator::Options options;
+    options.parallel_chunk_size = 7;
+    RouteAnnotator parallel(db, options);
+
+    const auto serial_nodes = serial.coordinates_to_internal(points);
+    const auto parallel_nodes = parallel.coordinates_to_internal(points);
+    BOOST_CHECK_EQUAL_COLLECTIONS(serial_nodes.begin(), serial_nodes.end(),
+                                  parallel_nodes.begin(), parallel_nodes.end());
+
+    const auto serial_ways = serial.annotateRoute(serial_nodes);
+    const auto parallel_ways = parallel.annotateRoute(parallel_nodes);
+    BOOST_CHECK_EQUAL(parallel_ways.size(), node_count - 1);
+    BOOST_CHECK_EQUAL_COLLECTIONS(serial_ways.begin(), serial_ways.end(), parallel_ways.begin(),
+                                  parallel_ways.end());
+    BOOST_CHECK_EQUAL(parallel_ways[8], 8);
+    BOOST_CHECK_EQUAL(parallel_ways[9], INVALID_WAYID);
+    BOOST_CHECK_EQUAL(parallel_ways[10], 10);
+}
+
+BOOST_AUTO_TEST_CASE(annotator_test_collapse_runs)
+{
+    const annotated_route_t annotated{4, 4, 4, INVALID_WAYID, 5, 4, 4};
+    const auto runs = RouteAnnotator::collapse_runs(annotated);
+
+    BOOST_CHECK_EQUAL(runs.size(), 4);
+    BOOST_CHECK_EQUAL(runs[0].way_id, 4);
+    BOOST_CHECK_EQUAL(runs[0].start, 0);
+    BOOST_CHECK_EQUAL(runs[0].count, 3);
+    BOOST_CHECK_EQUAL(runs[1].way_id, INVALID_WAYID);
+    BOOST_CHECK_EQUAL(runs[1].start, 3);
+    BOOST_CHECK_EQUAL(runs[1].count, 1);
+    BOOST_CHECK_EQUAL(runs[2].way_id, 5);
+    BOOST_CHECK_EQUAL(runs[2].start, 4);
+    BOOST_CHECK_EQUAL(runs[2].count, 1);
+    BOOST_CHECK_EQUAL(runs[3].way_id, 4);
+    BOOST_CHECK_EQUAL(runs[3].start, 5);
+    BOOST_CHECK_EQUAL(runs[3].count, 2);
+
+    BOOST_CHECK(RouteAnnotator::collapse_runs(annotated_route_t{}).empty());
+}
+
+BOOST_AUTO_TEST_CASE(annotator_test_fill_gaps)
+{
+    // 0 -a- 1 -a- 2 -b- 3 -b- 4, and a longer way round 0 -c- 5 -c- 6 -c- 7 -c- 8 -c- 4
+    Database db(false);
+    db.pair_way_map.emplace(internal_nodepair_t{0, 1}, way_storage_t{10, true});
+    db.pair_way_map.emplace(internal_nodepair_t{1, 2}, way_storage_t{10, true});
+    db.pair_way_map.emplace(internal_nodepair_t{2, 3}, way_storage_t{11, true});
+    db.pair_way_map.emplace(internal_nodepair_t{3, 4}, way_storage_t{11, true});
+    db.pair_way_map.emplace(internal_nodepair_t{0, 5}, way_storage_t{12, true});
+    db.pair_way_map.emplace(internal_nodepair_t{5, 6}, way_storage_t{12, true});
+    db.pair_way_map.emplace(internal_nodepair_t{6, 7}, way_storage_t{12, true});
+    db.pair_way_map.emplace(internal_nodepair_t{7, 8}, way_storage_t{12, true});
+    db.pair_way_map.emplace(internal_nodepair_t{4, 8}, way_storage_t{12, false});
+
+    RouteAnnotator annotator(db);
+
+    // Skips from 0 to 3, continues to 4, jumps to 6, then to an unknown node
+    const std::vector<internal_nodeid_t> route{0, 3, 4, 6, INVALID_INTERNAL_NODEID};
+    const auto annotated = annotator.annotateRoute(route);
+    BOOST_CHECK_EQUAL(annotated[0], INVALID_WAYID);
+    BOOST_CHECK_EQUAL(annotated[1], 11);
+
+    auto filled = annotator.fill_gaps(route, annotated, 2);
+    BOOST_CHECK_EQUAL(filled.size(), 4);
+    BOOST_CHECK(filled[0].empty());
+    BOOST_CHECK(filled[1].empty());
+    BOOST_CHECK(filled[2].empty());
+    BOOST_CHECK(filled[3].empty());
+
+    // The shortest path wins, and repeated way ids are collapsed
+    filled = annotator.fill_gaps(route, annotated, 3);
+    const annotated_route_t expected_gap{10, 11};
+    BOOST_CHECK_EQUAL_COLLECTIONS(filled[0].begin(), filled[0].end(), expected_gap.begin(),
+                                  expected_gap.end());
+    BOOST_CHECK_EQUAL(filled[2].size(), 1);
+    BOOST_CHECK_EQUAL(filled[2][0], 12);
+    BOOST_CHECK(filled[3].empty());
+}
+
+BOOST_AUTO_TEST_CASE(annotator_test_aggregate_by_tags)
+{
+    // Three nodes 0.001 degrees apart along the equator, about 111m each
+    Database db(true);
+    db.used_nodes_list.emplace_back(point_t{0, 0}, 0);
+    db.used_nodes_list.emplace_back(point_t{0.001, 0}, 1);
+    db.used_nodes_list.emplace_back(point_t{0.002, 0}, 2);
+
+    const auto highway = db.addstring("highway");
+    const auto primary = db.addstring("primary");
+    const auto residential = db.addstring("residential");
+    const auto name = db.addstring("name");
+    const auto main_street = db.addstring("Main Street");
+    db.key_value_pairs.emplace_back(highway, primary);
+    db.key_value_pairs.emplace_back(name, main_street);
+    db.key_value_pairs.emplace_back(highway, residential);
+    db.way_tag_ranges.emplace_back(0, 2);
+    db.way_tag_ranges.emplace_back(2, 3);
+    db.pair_way_map.emplace(internal_nodepair_t{0, 1}, way_storage_t{0, true});
+    db.pair_way_map.emplace(internal_nodepair_t{1, 2}, way_storage_t{1, true});
+
+    RouteAnnotator annotator(db);
+    const std::vector<internal_nodeid_t> route{0, 1, 2, 1};
+
+    // Without node coordinates there is nothing to measure
+    BOOST_CHECK_THROW(annotator.aggregate_by_tags(route, {"highway"}), RouteAnnotator::RtreeError);
+
+    db.build_rtree();
+    db.compact();
+
+    const auto lengths = annotator.aggregate_by_tags(route, {"highway", "name", "surface"});
+    BOOST_CHECK_EQUAL(lengths.size(), 3);
+    BOOST_CHECK_EQUAL(lengths[0].size(), 2);
+    BOOST_CHECK_CLOSE(lengths[0].at("primary"), 111.2, 0.1);
+    BOOST_CHECK_CLOSE(lengths[0].at("residential"), 222.4, 0.1);
+    BOOST_CHECK_EQUAL(lengths[1].size(), 1);
+    BOOST_CHECK_CLOSE(lengths[1].at("Main Street"), 111.2, 0.1);
+    BOOST_CHECK(lengths[2].empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,35 @@
+#include <boost/test/unit_test.hpp>
+
+#include "batch_lookup.hpp"
+
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(batch_lookup_test)
+
+BOOST_AUTO_TEST_CASE(batch_lookup_order_test)
+{
+    for (const std::size_t count : {0, 1, 7, 8, 9, 100})
+    {
+        std::vector<std::size_t> prefetched;
+        std::vector<std::size_t> resolved;
+        batch_lookup<8>(count, [](const std::size_t i) { return i * 3; },
+                        [&](const std::uint64_t hash) {
+                            // Never more than a window ahead of the lookups being resolved
+                            BOOST_CHECK_LT(hash / 3, resolved.size() + 8 + 1);
+                            prefetched.push_back(hash / 3);
+                        },
+                        [&](const std::size_t i, const std::uint64_t hash) {
+                            BOOST_CHECK_EQUAL(hash, i * 3);
+                            // Only after its memory was prefetched
+                            BOOST_CHECK_LT(i, prefetched.size());
+                            resolved.push_back(i);
+                        });
+
+        BOOST_CHECK_EQUAL(prefetched.size(), count);
+        BOOST_CHECK_EQUAL(resolved.size(), count);
+        for (std::size_t i = 0; i < resolved.size(); ++i)
+            BOOST_CHECK_EQUAL(resolved[i], i);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
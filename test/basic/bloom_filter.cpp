@@ -0,0 +1,42 @@
+#include <boost/test/unit_test.hpp>
+
+#include "bloom_filter.hpp"
+
+BOOST_AUTO_TEST_SUITE(bloom_filter_test)
+
+BOOST_AUTO_TEST_CASE(bloom_filter_empty_test)
+{
+    BlockedBloomFilter filter;
+    BOOST_CHECK(!filter.maybe_contains(BlockedBloomFilter::mix_hash(1)));
+    BOOST_CHECK_EQUAL(filter.stats().memory_bytes, 0);
+
+    filter.reset(0);
+    filter.insert(BlockedBloomFilter::mix_hash(1));
+    BOOST_CHECK(!filter.maybe_contains(BlockedBloomFilter::mix_hash(1)));
+}
+
+BOOST_AUTO_TEST_CASE(bloom_filter_false_positive_test)
+{
+    const std::uint64_t key_count = 100000;
+    BlockedBloomFilter filter;
+    filter.reset(key_count);
+    for (std::uint64_t key = 0; key < key_count; ++key)
+        filter.insert(BlockedBloomFilter::mix_hash(key * 2));
+
+    // Never a false negative
+    for (std::uint64_t key = 0; key < key_count; ++key)
+        BOOST_REQUIRE(filter.maybe_contains(BlockedBloomFilter::mix_hash(key * 2)));
+
+    std::size_t false_positives = 0;
+    for (std::uint64_t key = 0; key < key_count; ++key)
+        false_positives += filter.maybe_contains(BlockedBloomFilter::mix_hash(key * 2 + 1));
+    const double measured = static_cast<double>(false_positives) / key_count;
+
+    const auto stats = filter.stats();
+    BOOST_CHECK_EQUAL(stats.keys, key_count);
+    BOOST_CHECK_EQUAL(stats.memory_bytes, (key_count * 10 + 511) / 512 * 64);
+    BOOST_CHECK_LT(measured, 0.03);
+    BOOST_CHECK_CLOSE(stats.false_positive_rate, measured, 25);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
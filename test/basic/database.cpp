@@ -29,4 +29,21 @@ BOOST_AUTO_TEST_CASE(database_string_test)
     // BOOST_CHECK_THROW(db.getstring(id+1),std::out_of_range);
 }
 
+BOOST_AUTO_TEST_CASE(database_deferred_rtree_test)
+{
+    Database db(true);
+    db.deferRTree = true;
+    db.used_nodes_list.emplace_back(point_t{1, 1}, 73);
+
+    // Compacting before the RTree exists must keep the nodes it will be built from
+    db.compact();
+    BOOST_CHECK(db.rtree_pending());
+    BOOST_CHECK_EQUAL(db.used_nodes_list.size(), 1);
+
+    db.build_rtree();
+    BOOST_CHECK(!db.rtree_pending());
+    BOOST_CHECK_EQUAL(db.rtree->size(), 1);
+    BOOST_CHECK(db.used_nodes_list.empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
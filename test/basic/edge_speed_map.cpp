@@ -0,0 +1,49 @@
+#include <boost/test/unit_test.hpp>
+
+#include "edge_speed_map.hpp"
+
+BOOST_AUTO_TEST_SUITE(edge_speed_map_test)
+
+BOOST_AUTO_TEST_CASE(edge_speed_map_load_test)
+{
+    auto database = std::make_shared<Database>();
+    auto &db = *database;
+    const std::vector<external_nodeid_t> nodes{86909066, 86909064, 86909061,
+                                               69395079, 69402983, 12345};
+    for (std::size_t i = 0; i < nodes.size(); ++i)
+        db.external_internal_map.emplace(nodes[i], i);
+    db.pair_way_map.emplace(internal_nodepair_t{0, 1}, way_storage_t{0, true, 0});
+    db.pair_way_map.emplace(internal_nodepair_t{1, 2}, way_storage_t{0, true, 1});
+    db.pair_way_map.emplace(internal_nodepair_t{3, 4}, way_storage_t{1, true, 2});
+    db.pair_way_map.emplace(internal_nodepair_t{4, 5}, way_storage_t{1, true, 3});
+
+    EdgeSpeedMap map(database);
+    BOOST_CHECK_EQUAL(map.getValue(0, 1), INVALID_SPEED);
+
+    map.loadCSV("test/congestion/fixtures/congestion.csv");
+
+    // 86909066 -> 86909064 is 79, the other way 80
+    BOOST_CHECK_EQUAL(map.getValue(0, 1), 79);
+    BOOST_CHECK_EQUAL(map.getValue(1, 0), 80);
+    // 69395079 -> 69402983 is 14mph
+    BOOST_CHECK_EQUAL(map.getValue(3, 4), 23);
+    BOOST_CHECK_EQUAL(map.getValue(4, 3), INVALID_SPEED);
+    BOOST_CHECK_EQUAL(map.getValue(0, 2), INVALID_SPEED);
+    // All the other rows are for node pairs that aren't in the database
+    BOOST_CHECK_EQUAL(map.skipped(), 35);
+
+    annotated_route_t way_ids;
+    const auto speeds = map.getValues({0, 1, 2, 1, 0, 3, 4, 5}, way_ids);
+
+    const std::vector<segment_speed_t> expected_speeds{79, 79, 80, 80, 255, 23, 255};
+    const annotated_route_t expected_ways{0, 0, 0, 0, INVALID_WAYID, 1, 1};
+    BOOST_CHECK_EQUAL_COLLECTIONS(speeds.begin(), speeds.end(), expected_speeds.begin(),
+                                  expected_speeds.end());
+    BOOST_CHECK_EQUAL_COLLECTIONS(way_ids.begin(), way_ids.end(), expected_ways.begin(),
+                                  expected_ways.end());
+
+    BOOST_CHECK(map.getValues({0}, way_ids).empty());
+    BOOST_CHECK(way_ids.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,104 @@
+#include <boost/test/unit_test.hpp>
+
+#include "elias_fano.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(elias_fano_test)
+
+BOOST_AUTO_TEST_CASE(elias_fano_empty_test)
+{
+    EliasFano empty;
+    std::uint64_t value;
+    BOOST_CHECK_EQUAL(empty.size(), 0);
+    BOOST_CHECK_EQUAL(empty.lower_bound(0, value), 0);
+
+    EliasFano zero({0});
+    BOOST_CHECK_EQUAL(zero[0], 0);
+    BOOST_CHECK_EQUAL(zero.lower_bound(0, value), 0);
+    BOOST_CHECK_EQUAL(value, 0);
+    BOOST_CHECK_EQUAL(zero.lower_bound(1, value), 1);
+
+    BOOST_CHECK_THROW(EliasFano({3, 2}), std::runtime_error);
+    BOOST_CHECK_THROW(EliasFano({1, 5, 3}), std::runtime_error);
+    // Unsorted values past the last one would set bits beyond the bit vector
+    BOOST_CHECK_THROW(EliasFano({0, 1 << 20, 1}), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(elias_fano_max_value_test)
+{
+    // The universe of the largest value doesn't fit 64 bits
+    const auto max = std::numeric_limits<std::uint64_t>::max();
+    for (const auto &values : std::vector<std::vector<std::uint64_t>>{
+             {max}, {0, max}, {0, 5, max - 1, max, max}, {max - 1, max}})
+    {
+        const EliasFano sequence(values);
+        BOOST_REQUIRE_EQUAL(sequence.size(), values.size());
+        for (std::size_t i = 0; i < values.size(); ++i)
+            BOOST_CHECK_EQUAL(sequence[i], values[i]);
+
+        for (const auto key : {std::uint64_t{0}, std::uint64_t{6}, max - 1, max})
+        {
+            std::uint64_t found = 0;
+            const auto expected = std::lower_bound(values.begin(), values.end(), key);
+            BOOST_CHECK_EQUAL(sequence.lower_bound(key, found), expected - values.begin());
+            BOOST_CHECK_EQUAL(found, *expected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(elias_fano_access_test)
+{
+    // Dense and sparse sequences, with repeated values, sized around the sample rate
+    std::mt19937_64 rng(7);
+    for (const std::uint64_t spread : {1ull, 3ull, 1000ull, 1ull << 34})
+    {
+        for (const std::size_t count : {1, 255, 256, 257, 5000})
+        {
+            std::vector<std::uint64_t> values(count);
+            for (auto &value : values)
+                value = rng() % (spread * count);
+            std::sort(values.begin(), values.end());
+
+            const EliasFano sequence(values);
+            BOOST_REQUIRE_EQUAL(sequence.size(), count);
+            for (std::size_t i = 0; i < count; ++i)
+                BOOST_REQUIRE_EQUAL(sequence[i], values[i]);
+
+            for (std::size_t i = 0; i < 1000; ++i)
+            {
+                const auto key = rng() % (spread * count + 2);
+                const auto expected = std::lower_bound(values.begin(), values.end(), key);
+                std::uint64_t found = 0;
+                const auto index = sequence.lower_bound(key, found);
+                BOOST_REQUIRE_EQUAL(index, expected - values.begin());
+                if (expected != values.end())
+                    BOOST_REQUIRE_EQUAL(found, *expected);
+            }
+            // Every stored value finds its first occurrence
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                std::uint64_t found = 0;
+                const auto index = sequence.lower_bound(values[i], found);
+                BOOST_REQUIRE_EQUAL(
+                    index, std::lower_bound(values.begin(), values.end(), values[i]) - values.begin());
+                BOOST_REQUIRE_EQUAL(found, values[i]);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(elias_fano_size_test)
+{
+    // About 2 + log2(universe / size) bits per value
+    std::vector<std::uint64_t> values(100000);
+    for (std::size_t i = 0; i < values.size(); ++i)
+        values[i] = i * 1000;
+    const EliasFano sequence(values);
+    BOOST_CHECK_LT(sequence.memory_bytes() * 8, values.size() * 13);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
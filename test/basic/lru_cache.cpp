@@ -0,0 +1,79 @@
+#include <boost/test/test_case_template.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "lru_cache.hpp"
+
+BOOST_AUTO_TEST_SUITE(lru_cache_test)
+
+BOOST_AUTO_TEST_CASE(lru_cache_basic)
+{
+    ShardedLRUCache<int, int> cache(8, 1);
+
+    int value = 0;
+    BOOST_CHECK(!cache.get(1, value));
+    cache.put(1, 10);
+    BOOST_CHECK(cache.get(1, value));
+    BOOST_CHECK_EQUAL(value, 10);
+
+    // Replacing a value doesn't grow the cache
+    cache.put(1, 11);
+    BOOST_CHECK(cache.get(1, value));
+    BOOST_CHECK_EQUAL(value, 11);
+    BOOST_CHECK_EQUAL(cache.size(), 1);
+
+    BOOST_CHECK_EQUAL(cache.hits(), 2);
+    BOOST_CHECK_EQUAL(cache.misses(), 1);
+    BOOST_CHECK_EQUAL(cache.capacity(), 8);
+}
+
+BOOST_AUTO_TEST_CASE(lru_cache_eviction)
+{
+    ShardedLRUCache<int, int> cache(2, 1);
+
+    int value = 0;
+    cache.put(1, 10);
+    cache.put(2, 20);
+    // Touch 1 so that 2 becomes the least recently used entry
+    BOOST_CHECK(cache.get(1, value));
+    cache.put(3, 30);
+
+    BOOST_CHECK_EQUAL(cache.size(), 2);
+    BOOST_CHECK(cache.get(1, value));
+    BOOST_CHECK(!cache.get(2, value));
+    BOOST_CHECK(cache.get(3, value));
+    BOOST_CHECK_EQUAL(value, 30);
+}
+
+BOOST_AUTO_TEST_CASE(lru_cache_sharded_capacity)
+{
+    ShardedLRUCache<int, int> cache(64, 4);
+
+    for (int i = 0; i < 1000; ++i)
+        cache.put(i, i);
+
+    BOOST_CHECK(cache.size() <= 64);
+    BOOST_CHECK(cache.size() > 0);
+}
+
+BOOST_AUTO_TEST_CASE(lru_cache_uneven_capacity)
+{
+    // Capacities that aren't a multiple of the shard count, or are below it, hold exactly as
+    // many entries once every shard is full
+    for (const std::size_t capacity : {1, 5, 17, 100})
+    {
+        ShardedLRUCache<int, int> cache(capacity, 16);
+        for (int i = 0; i < 1000; ++i)
+            cache.put(i, i);
+
+        BOOST_CHECK_EQUAL(cache.size(), capacity);
+        BOOST_CHECK_EQUAL(cache.capacity(), capacity);
+    }
+
+    ShardedLRUCache<int, int> empty(0);
+    empty.put(1, 1);
+    int value;
+    BOOST_CHECK(!empty.get(1, value));
+    BOOST_CHECK_EQUAL(empty.size(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,194 @@
+#include <boost/test/unit_test.hpp>
+
+#include "parallel_load.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <zlib.h>
+
+BOOST_AUTO_TEST_SUITE(parallel_load_test)
+
+namespace
+{
+typedef std::tuple<std::uint64_t, std::uint64_t, std::uint32_t> row_t;
+
+struct Result
+{
+    std::vector<row_t> rows;
+    std::size_t stop;
+};
+
+// Parses segment rows, or way rows as (way, mph, speed)
+template <typename Row>
+const char *parse(const bool ways, const char *first, const char *last, Row &&row)
+{
+    if (ways)
+        return speed_csv::parse_way_speeds(
+            first, last, [&row](const std::uint32_t way, const bool mph,
+                                const std::uint32_t speed) { row(way, mph, speed); });
+    return speed_csv::parse_segment_speeds(
+        first, last,
+        [&row](const std::uint64_t from, const std::uint64_t to, const std::uint32_t speed,
+               speed_csv::SpeedUnit) { row(from, to, speed); });
+}
+
+Result load(const std::string &csv,
+            const bool ways,
+            const std::size_t threads,
+            const std::size_t chunk_bytes)
+{
+    Result result;
+    const auto add = [&result](const std::uint64_t a, const std::uint64_t b,
+                               const std::uint32_t c) { result.rows.emplace_back(a, b, c); };
+
+    const auto stop = parallel_load::load<std::vector<row_t>>(
+        csv.data(), csv.data() + csv.size(), threads, chunk_bytes,
+        [ways](const char *first, const char *last, std::vector<row_t> &chunk) {
+            return parse(ways, first, last,
+                         [&chunk](const std::uint64_t a, const std::uint64_t b,
+                                  const std::uint32_t c) { chunk.emplace_back(a, b, c); });
+        },
+        [&result](const std::vector<std::vector<row_t>> &chunks, const std::size_t count) {
+            for (std::size_t i = 0; i < count; ++i)
+                result.rows.insert(result.rows.end(), chunks[i].begin(), chunks[i].end());
+        },
+        [ways, &add](const char *first, const char *last) {
+            return parse(ways, first, last, add);
+        });
+    result.stop = stop - csv.data();
+    return result;
+}
+
+// Loads with 2 to 4 threads and chunks of every size up to the whole input, and checks
+// that the same rows are stored, in the same order, as on a single thread
+void check_same_as_sequential(const std::string &csv, const bool ways = false)
+{
+    const auto expected = load(csv, ways, 1, csv.size());
+    for (std::size_t threads = 2; threads <= 4; ++threads)
+    {
+        for (std::size_t chunk_bytes = 1; chunk_bytes <= csv.size(); ++chunk_bytes)
+        {
+            const auto actual = load(csv, ways, threads, chunk_bytes);
+            BOOST_CHECK_EQUAL(actual.stop, expected.stop);
+            BOOST_CHECK(actual.rows == expected.rows);
+        }
+    }
+}
+
+// Writes csv to a gzip file of two members, which must read as one stream
+void write_gzip(const std::string &path, const std::string &csv)
+{
+    const auto half = csv.size() / 2;
+    const auto first = gzopen(path.c_str(), "wb");
+    gzwrite(first, csv.data(), half);
+    gzclose(first);
+    const auto second = gzopen(path.c_str(), "ab");
+    gzwrite(second, csv.data() + half, csv.size() - half);
+    gzclose(second);
+}
+
+// Loads the csv gzip compressed, in blocks of every size up to the whole input, and checks
+// that the same rows are stored, and the same error reported, as for the uncompressed input
+void check_gzip_same_as_sequential(const std::string &csv, const bool ways = false)
+{
+    const std::string path = "parallel_load_test.csv.gz";
+    write_gzip(path, csv);
+
+    const auto expected = load(csv, ways, 1, csv.size());
+    const auto expected_error =
+        expected.stop == csv.size()
+            ? std::string()
+            : speed_csv::parse_error(path, csv.data(), csv.data() + expected.stop,
+                                     csv.data() + csv.size());
+    for (const std::size_t threads : {1, 3})
+    {
+        for (std::size_t block_bytes = 1; block_bytes <= csv.size() + 1; ++block_bytes)
+        {
+            std::vector<row_t> rows;
+            const auto add = [&rows](const std::uint64_t a, const std::uint64_t b,
+                                     const std::uint32_t c) { rows.emplace_back(a, b, c); };
+            auto parse_chunk = [ways](const char *first, const char *last,
+                                      std::vector<row_t> &chunk) {
+                return parse(ways, first, last,
+                             [&chunk](const std::uint64_t a, const std::uint64_t b,
+                                      const std::uint32_t c) { chunk.emplace_back(a, b, c); });
+            };
+            auto store = [&rows](const std::vector<std::vector<row_t>> &chunks,
+                                 const std::size_t count) {
+                for (std::size_t i = 0; i < count; ++i)
+                    rows.insert(rows.end(), chunks[i].begin(), chunks[i].end());
+            };
+            auto parse_rest = [ways, &add](const char *first, const char *last) {
+                return parse(ways, first, last, add);
+            };
+
+            const auto error = parallel_load::detail::load_gzip<std::vector<row_t>>(
+                path, threads, block_bytes, parse_chunk, store, parse_rest);
+            BOOST_CHECK_EQUAL(error, expected_error);
+            BOOST_CHECK(rows == expected.rows);
+        }
+    }
+    std::remove(path.c_str());
+}
+} // namespace
+
+BOOST_AUTO_TEST_CASE(parallel_load_rows_test)
+{
+    check_same_as_sequential("1,2,3\n4,5,6\n1,2,7\n8,9,mph,10\r\n11,12,13\r14,15,16\n\n\n");
+    check_same_as_sequential("1,2,3\n4,5,6\n7,8,9");
+    check_same_as_sequential("");
+}
+
+BOOST_AUTO_TEST_CASE(parallel_load_errors_test)
+{
+    // Invalid rows, and line starts that a chunk would accept on its own: after a blank
+    // line, or after line breaks only at the end of the input
+    check_same_as_sequential("1,2,3\n4,5,6\n7,x,9\n10,11,12\n");
+    check_same_as_sequential("1,2,3\n4,5,6\n\n7,8,9\n10,11,12\n");
+    check_same_as_sequential("1,2,3\n4,5,6\r\n\r\n7,8,9\n");
+    check_same_as_sequential("1,2,3\n4,5,6,7\n8,9,10\n");
+    check_same_as_sequential("x\n1,2,3\n4,5,6\n");
+    check_same_as_sequential("\n1,2,3\n4,5,6\n");
+
+    // A line break in a datasource
+    check_same_as_sequential("1,a,mph,2\n3,b\nc,kph,4\n5,,,6\n", true);
+    check_same_as_sequential("1,a,mph,2\n\n3,b,kph,4\n", true);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_load_gzip_test)
+{
+    check_gzip_same_as_sequential("1,2,3\n4,5,6\n1,2,7\n8,9,mph,10\r\n11,12,13\r14,15,16\n\n\n");
+    check_gzip_same_as_sequential("1,2,3\n4,5,6\n7,8,9");
+    check_gzip_same_as_sequential("");
+    check_gzip_same_as_sequential("1,a,mph,2\n3,b,kph,4\n\n", true);
+
+    check_gzip_same_as_sequential("1,2,3\n4,5,6\n7,x,9\n10,11,12\n");
+    check_gzip_same_as_sequential("1,2,3\n4,5,6\n\n7,8,9\n10,11,12\n");
+    check_gzip_same_as_sequential("1,2,3\n4,5,6\r\n\r\n7,8,9\n");
+    check_gzip_same_as_sequential("1,2,3\n4,5,6,7\n8,9,10\n");
+    check_gzip_same_as_sequential("\n1,2,3\n4,5,6\n");
+    check_gzip_same_as_sequential("1,a,mph,2\n\n3,b,kph,4\n", true);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_load_for_each_index_test)
+{
+    for (std::size_t threads = 1; threads <= 4; ++threads)
+    {
+        std::vector<std::atomic<int>> calls(100);
+        parallel_load::for_each_index(calls.size(), threads,
+                                      [&calls](const std::size_t i) { ++calls[i]; });
+        for (const auto &count : calls)
+            BOOST_CHECK_EQUAL(count.load(), 1);
+    }
+
+    BOOST_CHECK_EQUAL(parallel_load::chunk_bytes(0, 4), parallel_load::MIN_CHUNK_BYTES);
+    BOOST_CHECK_EQUAL(parallel_load::chunk_bytes(4 << 20, 4), 1 << 20);
+    BOOST_CHECK_EQUAL(parallel_load::chunk_bytes(std::size_t{1} << 40, 4),
+                      parallel_load::MAX_CHUNK_BYTES);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,42 @@
+#include <boost/test/test_case_template.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "polyline.hpp"
+
+BOOST_AUTO_TEST_SUITE(polyline_test)
+
+BOOST_AUTO_TEST_CASE(polyline_decode_precision5)
+{
+    // The example from the Google polyline algorithm documentation
+    const auto points = decode_polyline("_p~iF~ps|U_ulLnnqC_mqNvxq`@", 5);
+    BOOST_CHECK_EQUAL(points.size(), 3);
+    BOOST_CHECK_CLOSE(points[0].get<0>(), -120.2, 1e-9);
+    BOOST_CHECK_CLOSE(points[0].get<1>(), 38.5, 1e-9);
+    BOOST_CHECK_CLOSE(points[1].get<0>(), -120.95, 1e-9);
+    BOOST_CHECK_CLOSE(points[1].get<1>(), 40.7, 1e-9);
+    BOOST_CHECK_CLOSE(points[2].get<0>(), -126.453, 1e-9);
+    BOOST_CHECK_CLOSE(points[2].get<1>(), 43.252, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(polyline_decode_precision6)
+{
+    // Same coordinates as above, encoded with 6 decimal places
+    const auto points = decode_polyline("_izlhA~rlgdF_{geC~ywl@_kwzCn`{nI", 6);
+    BOOST_CHECK_EQUAL(points.size(), 3);
+    BOOST_CHECK_CLOSE(points[0].get<0>(), -120.2, 1e-9);
+    BOOST_CHECK_CLOSE(points[0].get<1>(), 38.5, 1e-9);
+    BOOST_CHECK_CLOSE(points[2].get<0>(), -126.453, 1e-9);
+    BOOST_CHECK_CLOSE(points[2].get<1>(), 43.252, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(polyline_decode_invalid)
+{
+    BOOST_CHECK_EQUAL(decode_polyline("").size(), 0);
+    // Truncated in the middle of a value
+    BOOST_CHECK_THROW(decode_polyline("_p~iF~ps|"), std::runtime_error);
+    // Characters outside of the polyline alphabet
+    BOOST_CHECK_THROW(decode_polyline("_p~iF ps|U"), std::runtime_error);
+    BOOST_CHECK_THROW(decode_polyline("_p~iF~ps|U", 7), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
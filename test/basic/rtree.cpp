@@ -86,4 +86,28 @@ BOOST_AUTO_TEST_CASE(rtree_radius_test)
     BOOST_CHECK_EQUAL(results[0], INVALID_INTERNAL_NODEID);
 }
 
+BOOST_AUTO_TEST_CASE(rtree_fixed_point_test)
+{
+    const fixed_point_t fixed{point_t{-122.4194155, 37.7749295}};
+    BOOST_CHECK_EQUAL(fixed.lon, -1224194155);
+    BOOST_CHECK_EQUAL(fixed.lat, 377749295);
+    BOOST_CHECK_CLOSE(fixed.to_point().get<0>(), -122.4194155, 1e-9);
+    BOOST_CHECK_CLOSE(fixed.to_point().get<1>(), 37.7749295, 1e-9);
+
+    Database db(true);
+    db.used_nodes_list.emplace_back(point_t{-122.41942, 37.77493}, 1);
+    db.used_nodes_list.emplace_back(point_t{-122.41941, 37.77493}, 2);
+    db.used_nodes_list.emplace_back(point_t{-122.41945, 37.77493}, 3);
+    db.build_rtree();
+    db.compact();
+
+    RouteAnnotator annotator(db);
+
+    // The closest of several nodes inside the radius wins
+    std::vector<point_t> points{point_t{-122.419412, 37.77493}};
+    auto results = annotator.coordinates_to_internal(points);
+    BOOST_CHECK_EQUAL(results.size(), 1);
+    BOOST_CHECK_EQUAL(results[0], 2);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
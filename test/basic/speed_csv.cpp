@@ -0,0 +1,169 @@
+#include <boost/test/unit_test.hpp>
+
+#include "speed_csv.hpp"
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(speed_csv_test)
+
+using speed_csv::SpeedUnit;
+
+namespace
+{
+typedef std::tuple<std::uint64_t, std::uint64_t, std::uint32_t, SpeedUnit> segment_row_t;
+
+// Parses segment rows, returns how many bytes were parsed
+std::size_t parse_segments(const std::string &csv, std::vector<segment_row_t> &rows)
+{
+    const auto stop = speed_csv::parse_segment_speeds(
+        csv.data(), csv.data() + csv.size(),
+        [&rows](const std::uint64_t from, const std::uint64_t to, const std::uint32_t speed,
+                const SpeedUnit unit) { rows.emplace_back(from, to, speed, unit); });
+    return stop - csv.data();
+}
+
+std::size_t parse_ways(const std::string &csv, std::vector<std::uint32_t> &speeds)
+{
+    const auto stop = speed_csv::parse_way_speeds(
+        csv.data(), csv.data() + csv.size(),
+        [&speeds](const std::uint32_t way, const bool mph, const std::uint32_t speed) {
+            speeds.push_back(way);
+            speeds.push_back(mph);
+            speeds.push_back(speed);
+        });
+    return stop - csv.data();
+}
+} // namespace
+
+BOOST_AUTO_TEST_CASE(speed_csv_segments_test)
+{
+    std::vector<segment_row_t> rows;
+    const std::string csv = "86909055,86909053,81\n1,2,mph,30\r\n3,4,kph,40\r5,6,,50\n\n\n";
+    BOOST_CHECK_EQUAL(parse_segments(csv, rows), csv.size());
+
+    const std::vector<segment_row_t> expected{
+        segment_row_t{86909055, 86909053, 81, SpeedUnit::None},
+        segment_row_t{1, 2, 30, SpeedUnit::Mph}, segment_row_t{3, 4, 40, SpeedUnit::Kph},
+        segment_row_t{5, 6, 50, SpeedUnit::Kph}};
+    BOOST_CHECK(rows == expected);
+
+    rows.clear();
+    BOOST_CHECK_EQUAL(parse_segments("", rows), 0);
+    BOOST_CHECK(rows.empty());
+}
+
+BOOST_AUTO_TEST_CASE(speed_csv_short_rows_test)
+{
+    // Enough rows for the short row path, mixed with rows it leaves to the general parser:
+    // units, \r\n, numbers of more than 16 digits and rows longer than 32 bytes
+    std::string csv;
+    std::vector<segment_row_t> expected;
+    for (std::uint64_t i = 0; i < 40; ++i)
+    {
+        const auto from = i % 7 == 0 ? 12345678901234567890ull - i : 1000000000 + i * 987654321;
+        const auto to = i % 5 == 0 ? 9999999999999999ull : i;
+        csv += std::to_string(from) + ',' + std::to_string(to) + ',';
+        if (i % 3 == 0)
+            csv += "mph,";
+        csv += std::to_string(i * 7) + (i % 4 == 0 ? "\r\n" : "\n");
+        expected.emplace_back(from, to, i * 7, i % 3 == 0 ? SpeedUnit::Mph : SpeedUnit::None);
+    }
+
+    std::vector<segment_row_t> rows;
+    BOOST_CHECK_EQUAL(parse_segments(csv, rows), csv.size());
+    BOOST_CHECK(rows == expected);
+
+    // An invalid row among short ones still stops at its line
+    rows.clear();
+    const std::string invalid = "1,2,3\n4,5,6\n7,,8\n" + std::string(64, '\n');
+    BOOST_CHECK_EQUAL(parse_segments(invalid, rows), 12);
+    BOOST_CHECK_EQUAL(rows.size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(speed_csv_numbers_test)
+{
+    // Every length of number, on both sides of the 8 and 16 digit conversions, with and
+    // without 16 bytes left to read after them
+    for (std::size_t digits = 1; digits <= 19; ++digits)
+    {
+        std::string number;
+        std::uint64_t value = 0;
+        for (std::size_t i = 0; i < digits; ++i)
+        {
+            number += static_cast<char>('1' + i % 9);
+            value = value * 10 + (1 + i % 9);
+        }
+
+        for (const std::string &padding : {std::string(), std::string(32, '\n')})
+        {
+            std::vector<segment_row_t> rows;
+            const auto csv = number + "," + number + ",5" + padding;
+            BOOST_CHECK_EQUAL(parse_segments(csv, rows), csv.size());
+            BOOST_REQUIRE_EQUAL(rows.size(), 1);
+            BOOST_CHECK_EQUAL(std::get<0>(rows[0]), value);
+            BOOST_CHECK_EQUAL(std::get<1>(rows[0]), value);
+        }
+    }
+
+    // Leading zeros don't overflow, values that don't fit do
+    std::vector<segment_row_t> rows;
+    BOOST_CHECK_EQUAL(parse_segments("000000000000000000000000000001,2,3", rows), 34);
+    BOOST_CHECK_EQUAL(std::get<0>(rows.at(0)), 1);
+    BOOST_CHECK_EQUAL(parse_segments("18446744073709551615,2,3", rows), 24);
+    BOOST_CHECK_EQUAL(std::get<0>(rows.at(1)), 18446744073709551615ull);
+    BOOST_CHECK_EQUAL(parse_segments("18446744073709551616,2,3", rows), 0);
+    BOOST_CHECK_EQUAL(parse_segments("1,2,4294967296", rows), 0);
+    BOOST_CHECK_EQUAL(rows.size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(speed_csv_errors_test)
+{
+    std::vector<segment_row_t> rows;
+    // An invalid first row stops the whole file
+    BOOST_CHECK_EQUAL(parse_segments("a,2,3\n1,2,3", rows), 0);
+    BOOST_CHECK_EQUAL(parse_segments("\n1,2,3", rows), 0);
+    BOOST_CHECK(rows.empty());
+
+    // Later invalid rows stop at the start of their line, after the valid ones
+    BOOST_CHECK_EQUAL(parse_segments("1,2,3\n4,5,-6\n7,8,9", rows), 6);
+    BOOST_CHECK_EQUAL(rows.size(), 1);
+    // Blank lines can only be at the end
+    BOOST_CHECK_EQUAL(parse_segments("1,2,3\n\n4,5,6", rows), 7);
+    // An extra column stops in the middle of a line, after its row
+    BOOST_CHECK_EQUAL(parse_segments("1,2,3\n4,5,6,7", rows), 11);
+    BOOST_CHECK_EQUAL(rows.size(), 4);
+    BOOST_CHECK_EQUAL(parse_segments("1,2,knots,3", rows), 0);
+    BOOST_CHECK_EQUAL(parse_segments("1,2,mph", rows), 0);
+
+    const std::string csv = "1,2,3\n4,5,6,7\n8,9,10";
+    const auto stop = csv.data() + 11;
+    BOOST_CHECK_EQUAL(
+        speed_csv::parse_error("speeds.csv", csv.data(), stop, csv.data() + csv.size()),
+        "CSV parsing failed at speeds.csv:2: 4,5,6,7");
+    BOOST_CHECK_EQUAL(speed_csv::parse_error("speeds.csv", csv.data(), csv.data() + 1,
+                                             csv.data() + csv.size()),
+                      "CSV parsing failed at speeds.csv:1: 1,2,3");
+}
+
+BOOST_AUTO_TEST_CASE(speed_csv_ways_test)
+{
+    std::vector<std::uint32_t> values;
+    const std::string csv = "406215748,C7nsuhT7vQHkBQEPAKIBBQ==,mph,30\n"
+                            "49800696,,kph,88\r\n"
+                            "4229292,source,,65\n";
+    BOOST_CHECK_EQUAL(parse_ways(csv, values), csv.size());
+    const std::vector<std::uint32_t> expected{406215748, 1, 30, 49800696, 0, 88, 4229292, 0, 65};
+    BOOST_CHECK_EQUAL_COLLECTIONS(values.begin(), values.end(), expected.begin(), expected.end());
+
+    // Way files may be empty or only have line breaks
+    values.clear();
+    BOOST_CHECK_EQUAL(parse_ways("\n\n", values), 2);
+    BOOST_CHECK_EQUAL(parse_ways("\nway,source,unit,speed", values), 1);
+    BOOST_CHECK_EQUAL(parse_ways("1,source,mph", values), 0);
+    BOOST_CHECK_EQUAL(parse_ways("1,source,30", values), 0);
+    BOOST_CHECK(values.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,83 @@
+#include <boost/test/unit_test.hpp>
+
+#include "speed_fallback.hpp"
+
+BOOST_AUTO_TEST_SUITE(speed_fallback_test)
+
+BOOST_AUTO_TEST_CASE(speed_fallback_chain_test)
+{
+    // 86909055 -> 86909053 has a segment speed of 81, way 106817824 a way speed of 70mph
+    const SegmentSpeedMap segments("test/congestion/fixtures/congestion.csv");
+    const WaySpeedMap ways("test/wayspeeds/fixtures/way_speeds.csv");
+
+    Database db;
+    const std::vector<external_nodeid_t> nodes{86909055, 86909053, 100, 101, 102, 103};
+    for (std::size_t i = 0; i < nodes.size(); ++i)
+        db.external_internal_map.emplace(nodes[i], i);
+
+    const auto maxspeed = db.addstring("maxspeed");
+    const auto highway = db.addstring("highway");
+    db.key_value_pairs.emplace_back(highway, db.addstring("primary"));
+    db.key_value_pairs.emplace_back(maxspeed, db.addstring("30 mph"));
+    db.key_value_pairs.emplace_back(maxspeed, db.addstring("none"));
+    db.way_tag_ranges.emplace_back(0, 1);
+    db.way_tag_ranges.emplace_back(0, 2);
+    db.way_tag_ranges.emplace_back(2, 3);
+    db.internal_to_external_way_id_map = {106817824, 1, 2};
+
+    db.pair_way_map.emplace(internal_nodepair_t{0, 1}, way_storage_t{0, true});
+    db.pair_way_map.emplace(internal_nodepair_t{1, 2}, way_storage_t{0, true});
+    db.pair_way_map.emplace(internal_nodepair_t{2, 3}, way_storage_t{1, true});
+    db.pair_way_map.emplace(internal_nodepair_t{3, 4}, way_storage_t{1, true});
+    db.pair_way_map.emplace(internal_nodepair_t{4, 5}, way_storage_t{2, true});
+    db.compact();
+
+    const SpeedFallback fallback(&db, &segments, &ways);
+    // Goes backwards over 101 -> 100 to check that pairs are found in either order
+    const std::vector<external_nodeid_t> route{86909055, 86909053, 100, 101, 100, 101, 102,
+                                               103, 999};
+    const auto result = fallback.getValues(route);
+
+    const std::vector<segment_speed_t> expected_speeds{81, 113, 48, 48, 48, 48, 255, 255};
+    const std::vector<SpeedSource> expected_sources{
+        SpeedSource::Segment,  SpeedSource::Way,      SpeedSource::Maxspeed, SpeedSource::Maxspeed,
+        SpeedSource::Maxspeed, SpeedSource::Maxspeed, SpeedSource::None,     SpeedSource::None};
+    BOOST_CHECK_EQUAL_COLLECTIONS(result.speeds.begin(), result.speeds.end(),
+                                  expected_speeds.begin(), expected_speeds.end());
+    BOOST_CHECK(result.sources == expected_sources);
+
+    // Missing sources are skipped
+    const auto without_database = SpeedFallback(nullptr, &segments, &ways).getValues(route);
+    BOOST_CHECK(without_database.sources[0] == SpeedSource::Segment);
+    BOOST_CHECK(without_database.sources[1] == SpeedSource::None);
+    BOOST_CHECK_EQUAL(without_database.speeds[1], INVALID_SPEED);
+
+    const auto without_ways = SpeedFallback(&db, nullptr, nullptr).getValues(route);
+    BOOST_CHECK(without_ways.sources[0] == SpeedSource::None);
+    BOOST_CHECK(without_ways.sources[1] == SpeedSource::None);
+    BOOST_CHECK(without_ways.sources[2] == SpeedSource::Maxspeed);
+
+    BOOST_CHECK(fallback.getValues({86909055}).speeds.empty());
+}
+
+BOOST_AUTO_TEST_CASE(speed_fallback_parse_maxspeed_test)
+{
+    segment_speed_t speed = 0;
+    BOOST_CHECK(SpeedFallback::parse_maxspeed("50", speed));
+    BOOST_CHECK_EQUAL(speed, 50);
+    BOOST_CHECK(SpeedFallback::parse_maxspeed("70 km/h", speed));
+    BOOST_CHECK_EQUAL(speed, 70);
+    BOOST_CHECK(SpeedFallback::parse_maxspeed("30 mph", speed));
+    BOOST_CHECK_EQUAL(speed, 48);
+    BOOST_CHECK(SpeedFallback::parse_maxspeed("25mph", speed));
+    BOOST_CHECK_EQUAL(speed, 40);
+
+    BOOST_CHECK(!SpeedFallback::parse_maxspeed("none", speed));
+    BOOST_CHECK(!SpeedFallback::parse_maxspeed("DE:urban", speed));
+    BOOST_CHECK(!SpeedFallback::parse_maxspeed("50;30", speed));
+    BOOST_CHECK(!SpeedFallback::parse_maxspeed("10 knots", speed));
+    BOOST_CHECK(!SpeedFallback::parse_maxspeed("300", speed));
+    BOOST_CHECK(!SpeedFallback::parse_maxspeed("", speed));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,42 @@
+#include <boost/test/unit_test.hpp>
+
+#include "speed_stats.hpp"
+
+BOOST_AUTO_TEST_SUITE(speed_stats_test)
+
+BOOST_AUTO_TEST_CASE(speed_stats_basic_test)
+{
+    const std::vector<segment_speed_t> speeds{30, INVALID_SPEED, 60, 90, INVALID_SPEED};
+    const auto stats = compute_speed_stats(speeds);
+
+    BOOST_CHECK_EQUAL(stats.total, 5);
+    BOOST_CHECK_EQUAL(stats.valid, 3);
+    BOOST_CHECK_EQUAL(stats.min, 30);
+    BOOST_CHECK_EQUAL(stats.max, 90);
+    BOOST_CHECK_CLOSE(stats.mean, 60, 1e-9);
+    // 3 / (1/30 + 1/60 + 1/90)
+    BOOST_CHECK_CLOSE(stats.harmonic_mean, 49.0909090909, 1e-6);
+    BOOST_CHECK_CLOSE(stats.coverage, 0.6, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(speed_stats_edge_cases_test)
+{
+    auto stats = compute_speed_stats({});
+    BOOST_CHECK_EQUAL(stats.total, 0);
+    BOOST_CHECK_EQUAL(stats.valid, 0);
+    BOOST_CHECK_EQUAL(stats.coverage, 0);
+
+    stats = compute_speed_stats({INVALID_SPEED, INVALID_SPEED});
+    BOOST_CHECK_EQUAL(stats.total, 2);
+    BOOST_CHECK_EQUAL(stats.valid, 0);
+    BOOST_CHECK_EQUAL(stats.coverage, 0);
+
+    // A stopped segment takes forever to travel
+    stats = compute_speed_stats({0, 50});
+    BOOST_CHECK_EQUAL(stats.min, 0);
+    BOOST_CHECK_CLOSE(stats.mean, 25, 1e-9);
+    BOOST_CHECK_EQUAL(stats.harmonic_mean, 0);
+    BOOST_CHECK_EQUAL(stats.coverage, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,84 @@
+#include <boost/test/unit_test.hpp>
+
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(thread_pool_test)
+
+BOOST_AUTO_TEST_CASE(thread_pool_each_index_once)
+{
+    ThreadPool pool(3);
+    for (std::size_t threads = 1; threads <= 5; ++threads)
+    {
+        std::vector<std::atomic<int>> calls(100);
+        pool.for_each_index(calls.size(), threads, [&calls](const std::size_t i) { ++calls[i]; });
+        for (const auto &count : calls)
+            BOOST_CHECK_EQUAL(count.load(), 1);
+    }
+    pool.for_each_index(0, 4, [](const std::size_t) { BOOST_ERROR("No index expected"); });
+}
+
+BOOST_AUTO_TEST_CASE(thread_pool_uses_workers)
+{
+    // The calling thread waits for a worker to take the other index
+    ThreadPool pool(1);
+    std::promise<void> taken;
+    auto waiting = taken.get_future();
+    std::set<std::thread::id> threads;
+    std::mutex mutex;
+    pool.for_each_index(2, 2, [&](const std::size_t i) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            threads.insert(std::this_thread::get_id());
+        }
+        if (i == 0)
+            waiting.wait();
+        else
+            taken.set_value();
+    });
+    BOOST_CHECK_EQUAL(threads.size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(thread_pool_concurrent_callers)
+{
+    // More callers than workers, as with several requests at once, each with its own exception
+    ThreadPool pool(2);
+    std::vector<std::string> errors(6);
+    std::vector<std::future<std::size_t>> callers;
+    for (std::size_t caller = 0; caller < errors.size(); ++caller)
+    {
+        callers.push_back(std::async(std::launch::async, [&pool, &errors, caller]() {
+            std::atomic<std::size_t> sum{0};
+            try
+            {
+                pool.for_each_index(50, 3, [&sum, caller](const std::size_t i) {
+                    if (caller % 2 == 1 && i == 17)
+                        throw std::runtime_error("index 17");
+                    sum += i;
+                });
+            }
+            catch (const std::runtime_error &e)
+            {
+                errors[caller] = e.what();
+            }
+            return sum.load();
+        }));
+    }
+
+    // Every other index is still called after an exception
+    for (std::size_t caller = 0; caller < callers.size(); ++caller)
+    {
+        BOOST_CHECK_EQUAL(callers[caller].get(), 49 * 50 / 2 - (caller % 2 == 1 ? 17 : 0));
+        BOOST_CHECK_EQUAL(errors[caller], caller % 2 == 1 ? "index 17" : "");
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
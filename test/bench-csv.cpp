@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+
+#include <boost/fusion/adapted/std_pair.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/spirit/include/phoenix.hpp>
+#include <boost/spirit/include/qi.hpp>
+
+#include "segment_speed_map.hpp"
+#include "speed_csv.hpp"
+
+/**
+ * Compares speed_csv with the Boost.Spirit grammars that SegmentSpeedMap and
+ * WaySpeedMap used before, on generated files or on a segment speed file.
+ * Given a file, also times loading it into a SegmentSpeedMap on one thread
+ * and on every hardware thread.
+ *
+ * Usage: bench-csv [segment csv]
+ */
+
+namespace
+{
+
+// Sums what was parsed so that both parsers can be checked against each other
+struct Checksum
+{
+    std::uint64_t rows = 0;
+    std::uint64_t sum = 0;
+
+    void segment(const std::uint64_t from, const std::uint64_t to, const std::uint32_t speed)
+    {
+        ++rows;
+        sum += from * 3 + to * 5 + speed;
+    }
+
+    void segment_with_unit(const std::uint64_t from,
+                           const std::uint64_t to,
+                           const std::uint32_t speed,
+                           const bool mph)
+    {
+        segment(from, to, speed + mph);
+    }
+
+    void way(const std::uint32_t way, const bool mph, const std::uint32_t speed)
+    {
+        ++rows;
+        sum += way * 3 + speed + mph;
+    }
+
+    bool operator==(const Checksum &other) const { return rows == other.rows && sum == other.sum; }
+};
+
+const char *spirit_segments(const char *first, const char *last, Checksum &checksum)
+{
+    namespace ph = boost::phoenix;
+    namespace qi = boost::spirit::qi;
+
+    qi::parse(first, last,
+              (((qi::ulong_long >> ',' >> qi::ulong_long >> ',' >>
+                 qi::uint_)[ph::bind(&Checksum::segment, &checksum, qi::_1, qi::_2, qi::_3)]) |
+               ((qi::ulong_long >> ',' >> qi::ulong_long >> ',' >>
+                 ("mph" >> qi::attr(true) | "kph" >> qi::attr(false) | "" >> qi::attr(false)) >>
+                 ',' >> qi::uint_)[ph::bind(&Checksum::segment_with_unit, &checksum, qi::_1,
+                                            qi::_2, qi::_4, qi::_3)])) %
+                      qi::eol >>
+                  *qi::eol);
+    return first;
+}
+
+const char *spirit_ways(const char *first, const char *last, Checksum &checksum)
+{
+    namespace ph = boost::phoenix;
+    namespace qi = boost::spirit::qi;
+
+    qi::parse(first, last,
+              -((qi::uint_ >> ',' >> ((+(qi::char_ - ',')) | "" >> qi::lit("")) >> ',' >>
+                 ("mph" >> qi::attr(true) | "kph" >> qi::attr(false) | "" >> qi::attr(false)) >>
+                 ',' >> qi::uint_)[ph::bind(&Checksum::way, &checksum, qi::_1, qi::_3, qi::_4)] %
+                qi::eol) >>
+                  *qi::eol);
+    return first;
+}
+
+const char *fast_segments(const char *first, const char *last, Checksum &checksum)
+{
+    return speed_csv::parse_segment_speeds(
+        first, last,
+        [&checksum](const std::uint64_t from, const std::uint64_t to, const std::uint32_t speed,
+                    const speed_csv::SpeedUnit unit) {
+            if (unit == speed_csv::SpeedUnit::None)
+                checksum.segment(from, to, speed);
+            else
+                checksum.segment_with_unit(from, to, speed, unit == speed_csv::SpeedUnit::Mph);
+        });
+}
+
+const char *fast_ways(const char *first, const char *last, Checksum &checksum)
+{
+    return speed_csv::parse_way_speeds(
+        first, last,
+        [&checksum](const std::uint32_t way, const bool mph, const std::uint32_t speed) {
+            checksum.way(way, mph, speed);
+        });
+}
+
+template <typename Parse>
+double best_ms(
+    Parse parse, const std::string &name, const char *first, const char *last, Checksum &checksum)
+{
+    double best = 0;
+    for (int run = 0; run < 3; ++run)
+    {
+        checksum = Checksum{};
+        const auto start = std::chrono::steady_clock::now();
+        const auto stop = parse(first, last, checksum);
+        const auto end = std::chrono::steady_clock::now();
+        if (stop != last)
+            std::cerr << name << " stopped at byte " << stop - first << std::endl;
+        const auto ms = std::chrono::duration<double, std::milli>(end - start).count();
+        best = run == 0 ? ms : std::min(best, ms);
+    }
+    return best;
+}
+
+template <typename Spirit, typename Fast>
+bool compare(
+    const std::string &name, Spirit spirit, Fast fast, const char *first, const char *last)
+{
+    Checksum spirit_checksum, fast_checksum;
+    const auto spirit_ms = best_ms(spirit, name, first, last, spirit_checksum);
+    const auto fast_ms = best_ms(fast, name, first, last, fast_checksum);
+    const auto mb = (last - first) / 1e6;
+    std::cout << name << ": " << fast_checksum.rows << " rows, " << mb << "MB, Spirit "
+              << mb / spirit_ms * 1e3 << "MB/s, speed_csv " << mb / fast_ms * 1e3 << "MB/s ("
+              << spirit_ms / fast_ms << "x)" << std::endl;
+    return spirit_checksum == fast_checksum;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    bool same = true;
+    if (argc > 1)
+    {
+        boost::iostreams::mapped_file_source mmap(argv[1]);
+        same = compare(argv[1], spirit_segments, fast_segments, mmap.begin(), mmap.end());
+
+        for (const std::size_t threads : {1u, std::max(1u, std::thread::hardware_concurrency())})
+        {
+            SegmentSpeedMap map;
+            const auto start = std::chrono::steady_clock::now();
+            map.loadCSV(argv[1], threads);
+            const auto end = std::chrono::steady_clock::now();
+            std::cout << "SegmentSpeedMap load, " << threads << " threads: " << map.size()
+                      << " segments in "
+                      << std::chrono::duration<double, std::milli>(end - start).count() << "ms"
+                      << std::endl;
+        }
+        return same ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    std::mt19937_64 rng(42);
+    std::string segments;
+    std::string ways;
+    for (std::size_t i = 0; i < 5000000; ++i)
+    {
+        // Node ids of today's planet, mostly without a unit
+        const auto from = 1000000000 + rng() % 12000000000;
+        const auto to = from + rng() % 1000;
+        segments += std::to_string(from) + ',' + std::to_string(to) + ',';
+        if (i % 10 == 0)
+            segments += i % 20 ? "kph," : "mph,";
+        segments += std::to_string(rng() % 130) + '\n';
+
+        ways += std::to_string(rng() % 1200000000) + ",C7nsuhT7vQHkBQEPAKIBBQ==," +
+                (i % 2 ? "kph," : "mph,") + std::to_string(rng() % 130) + '\n';
+    }
+
+    same = compare("segments", spirit_segments, fast_segments, segments.data(),
+                   segments.data() + segments.size()) &&
+           same;
+    same = compare("ways", spirit_ways, fast_ways, ways.data(), ways.data() + ways.size()) && same;
+    return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
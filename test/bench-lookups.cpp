@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "batch_lookup.hpp"
+#include "bloom_filter.hpp"
+#include "types.hpp"
+
+/**
+ * Measures what interleaving lookups with batch_lookup gains over probing one
+ * key after another, on tables much larger than the cache: the presence filter
+ * of the speed maps, and a dense array of speeds like EdgeSpeedMap keeps.
+ *
+ * Usage: bench-lookups [keys]
+ */
+
+namespace
+{
+
+template <typename F> double best_ms(F &&f)
+{
+    double best = 0;
+    for (int run = 0; run < 3; ++run)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        f();
+        const auto end = std::chrono::steady_clock::now();
+        const auto ms = std::chrono::duration<double, std::milli>(end - start).count();
+        best = run == 0 ? ms : std::min(best, ms);
+    }
+    return best;
+}
+
+void report(const std::string &name,
+            const double plain_ms,
+            const double batched_ms,
+            const std::size_t lookups)
+{
+    std::cout << name << ": one at a time " << plain_ms * 1e6 / lookups << "ns, interleaved "
+              << batched_ms * 1e6 / lookups << "ns per lookup (" << plain_ms / batched_ms
+              << "x)" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const std::size_t key_count = argc > 1 ? std::stoul(argv[1]) : 20000000;
+    const std::size_t lookup_count = 4000000;
+
+    std::mt19937_64 rng(42);
+
+    // Filter lookups for keys that mostly aren't there, like segments without a speed
+    BlockedBloomFilter filter;
+    filter.reset(key_count);
+    for (std::size_t i = 0; i < key_count; ++i)
+        filter.insert(BlockedBloomFilter::mix_hash(rng()));
+
+    std::vector<std::uint64_t> keys(lookup_count);
+    for (auto &key : keys)
+        key = rng();
+
+    std::vector<char> expected(lookup_count);
+    std::vector<char> actual(lookup_count);
+    const auto filter_plain_ms = best_ms([&] {
+        for (std::size_t i = 0; i < lookup_count; ++i)
+            expected[i] = filter.maybe_contains(BlockedBloomFilter::mix_hash(keys[i]));
+    });
+    const auto filter_batched_ms = best_ms([&] {
+        batch_lookup(lookup_count,
+                     [&keys](const std::size_t i) { return BlockedBloomFilter::mix_hash(keys[i]); },
+                     [&filter](const std::uint64_t hash) { filter.prefetch(hash); },
+                     [&](const std::size_t i, const std::uint64_t hash) {
+                         actual[i] = filter.maybe_contains(hash);
+                     });
+    });
+    bool same = expected == actual;
+
+    // Gathers from a dense array indexed by a hash of the key
+    std::vector<segment_speed_t> speeds(key_count);
+    for (auto &speed : speeds)
+        speed = static_cast<segment_speed_t>(rng() % INVALID_SPEED);
+
+    std::vector<segment_speed_t> expected_speeds(lookup_count);
+    std::vector<segment_speed_t> actual_speeds(lookup_count);
+    const auto array_plain_ms = best_ms([&] {
+        for (std::size_t i = 0; i < lookup_count; ++i)
+        {
+            const auto hash = BlockedBloomFilter::mix_hash(keys[i]);
+            const auto speed = speeds[hash % key_count];
+            // A data dependent branch, like a lookup that stops early on a miss
+            expected_speeds[i] = speed > 200 ? INVALID_SPEED : speed;
+        }
+    });
+    const auto array_batched_ms = best_ms([&] {
+        batch_lookup(lookup_count,
+                     [&keys](const std::size_t i) { return BlockedBloomFilter::mix_hash(keys[i]); },
+                     [&](const std::uint64_t hash) { __builtin_prefetch(&speeds[hash % key_count]); },
+                     [&](const std::size_t i, const std::uint64_t hash) {
+                         const auto speed = speeds[hash % key_count];
+                         actual_speeds[i] = speed > 200 ? INVALID_SPEED : speed;
+                     });
+    });
+    same = same && expected_speeds == actual_speeds;
+
+    const auto filter_bytes = filter.stats().memory_bytes;
+    std::cout << key_count << " keys, " << lookup_count << " lookups" << std::endl;
+    report("presence filter (" + std::to_string(filter_bytes >> 20) + "MB)", filter_plain_ms,
+           filter_batched_ms, lookup_count);
+    report("speed array (" + std::to_string(speeds.size() >> 20) + "MB)", array_plain_ms,
+           array_batched_ms, lookup_count);
+
+    return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
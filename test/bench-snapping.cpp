@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "annotator.hpp"
+#include "database.hpp"
+
+#include <boost/geometry.hpp>
+
+/**
+ * Measures how long it takes to snap coordinates to nodes, the first step of
+ * annotateRouteFromLonLats.  Nodes are scattered randomly over a small area so
+ * that no OSM extract is needed, and the annotator is compared with a baseline
+ * that measures the haversine distance to every node the rtree returns.
+ *
+ * Usage: bench-snapping [nodes] [snap radius in metres]
+ */
+
+namespace
+{
+
+const boost::geometry::strategy::distance::haversine<double> haversine(6372795.0);
+
+// The previous approach: exact distance to every node in the search box
+std::vector<internal_nodeid_t> snap_baseline(const Database &db,
+                                             const std::vector<point_t> &points,
+                                             const double snap_radius)
+{
+    std::vector<internal_nodeid_t> result;
+    result.reserve(points.size());
+    for (const auto &point : points)
+    {
+        const double lat_radius = snap_radius / 6372795.0 * 180 / M_PI;
+        const double lon_radius = lat_radius / std::cos(point.get<1>() * M_PI / 180);
+        const boost::geometry::model::box<fixed_point_t> box{
+            point_t{point.get<0>() - lon_radius, point.get<1>() - lat_radius},
+            point_t{point.get<0>() + lon_radius, point.get<1>() + lat_radius}};
+
+        std::vector<value_t> rtree_results;
+        db.rtree->query(boost::geometry::index::intersects(box), std::back_inserter(rtree_results));
+
+        internal_nodeid_t best = INVALID_INTERNAL_NODEID;
+        double best_distance = snap_radius;
+        for (const auto &candidate : rtree_results)
+        {
+            const auto distance =
+                boost::geometry::distance(point, candidate.first.to_point(), haversine);
+            if (distance < best_distance)
+            {
+                best = candidate.second;
+                best_distance = distance;
+            }
+        }
+        result.push_back(best);
+    }
+    return result;
+}
+
+template <typename F> double time_ms(F &&f)
+{
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const std::size_t node_count = argc > 1 ? std::stoul(argv[1]) : 2000000;
+    const double snap_radius = argc > 2 ? std::stod(argv[2]) : 10;
+    const std::size_t route_length = 100000;
+
+    // Scatter nodes over roughly 5km x 5km
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> lon(13.38, 13.45);
+    std::uniform_real_distribution<double> lat(52.49, 52.535);
+    std::normal_distribution<double> jitter(0, 0.00002);
+
+    Database db(true);
+    for (std::size_t i = 0; i < node_count; ++i)
+    {
+        db.used_nodes_list.emplace_back(point_t{lon(rng), lat(rng)}, i);
+    }
+
+    // Route coordinates land close to, but not on top of, existing nodes
+    std::vector<point_t> points;
+    std::uniform_int_distribution<std::size_t> pick(0, node_count - 1);
+    for (std::size_t i = 0; i < route_length; ++i)
+    {
+        const auto node = db.used_nodes_list[pick(rng)].first.to_point();
+        points.emplace_back(node.get<0>() + jitter(rng), node.get<1>() + jitter(rng));
+    }
+
+    db.build_rtree();
+    db.compact();
+
+    RouteAnnotator::Options options;
+    options.snap_radius = snap_radius;
+    RouteAnnotator annotator(db, options);
+
+    std::vector<internal_nodeid_t> expected;
+    std::vector<internal_nodeid_t> actual;
+    const auto baseline_ms = time_ms([&] { expected = snap_baseline(db, points, snap_radius); });
+    const auto projected_ms = time_ms([&] { actual = annotator.coordinates_to_internal(points); });
+
+    const auto mismatches = route_length - static_cast<std::size_t>(std::inner_product(
+                                               expected.begin(), expected.end(), actual.begin(), 0,
+                                               std::plus<std::size_t>(),
+                                               std::equal_to<internal_nodeid_t>()));
+
+    std::cout << node_count << " nodes, " << route_length << " coordinates, " << snap_radius
+              << "m radius" << std::endl;
+    std::cout << "haversine for every candidate: " << baseline_ms << "ms ("
+              << baseline_ms * 1000 / route_length << "us per coordinate)" << std::endl;
+    std::cout << "planar ranking, haversine for the result: " << projected_ms << "ms ("
+              << projected_ms * 1000 / route_length << "us per coordinate)" << std::endl;
+    std::cout << "different nodes chosen: " << mismatches << std::endl;
+
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+#include "way_speed_map.hpp"
+
+/**
+ * Compares the memory and lookup latency of the WaySpeedMap storage
+ * backends on a way,datasource,unit,speed CSV file.  Lookups are for the ways
+ * in the file, and for as many random ids from the same range, most of
+ * which have no speed.
+ *
+ * Usage: bench-way-speeds <csv> [lookups]
+ */
+
+namespace
+{
+
+std::vector<wayid_t> read_ways(const std::string &path)
+{
+    std::vector<wayid_t> ways;
+    std::ifstream csv(path);
+    std::string line;
+    while (std::getline(csv, line))
+    {
+        if (!line.empty())
+            ways.push_back(static_cast<wayid_t>(std::stoul(line.substr(0, line.find(',')))));
+    }
+    return ways;
+}
+
+template <typename F> double best_ms(F &&f)
+{
+    double best = 0;
+    for (int run = 0; run < 3; ++run)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        f();
+        const auto end = std::chrono::steady_clock::now();
+        const auto ms = std::chrono::duration<double, std::milli>(end - start).count();
+        best = run == 0 ? ms : std::min(best, ms);
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <csv> [lookups]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::string path = argv[1];
+    const std::size_t lookup_count = argc > 2 ? std::stoul(argv[2]) : 4000000;
+
+    const auto ways = read_ways(path);
+    if (ways.empty())
+    {
+        std::cerr << "No ways in " << path << std::endl;
+        return EXIT_FAILURE;
+    }
+    const auto largest = *std::max_element(ways.begin(), ways.end());
+
+    std::mt19937 rng(42);
+    std::vector<wayid_t> hits(lookup_count);
+    std::vector<wayid_t> mixed(lookup_count);
+    for (std::size_t i = 0; i < lookup_count; ++i)
+    {
+        hits[i] = ways[rng() % ways.size()];
+        mixed[i] = i % 2 ? hits[i] : static_cast<wayid_t>(rng() % (std::uint64_t{largest} + 1));
+    }
+
+    std::vector<segment_speed_t> expected;
+    bool same = true;
+    for (const auto storage : {WaySpeedMap::Storage::Hashtable, WaySpeedMap::Storage::Radix})
+    {
+        const auto name = storage == WaySpeedMap::Storage::Radix ? "radix" : "hashtable";
+
+        const auto load_start = std::chrono::steady_clock::now();
+        const WaySpeedMap map(path, storage);
+        const auto load_ms = std::chrono::duration<double, std::milli>(
+                                 std::chrono::steady_clock::now() - load_start)
+                                 .count();
+
+        std::vector<segment_speed_t> speeds;
+        const auto hits_ms = best_ms([&] { speeds = map.getValues(hits); });
+        const auto mixed_ms = best_ms([&] { speeds = map.getValues(mixed); });
+        if (expected.empty())
+            expected = speeds;
+        same = same && expected == speeds;
+
+        const auto filter_bytes = map.filterStats().memory_bytes;
+        std::cout << name << ": " << map.size() << " ways, " << map.memoryBytes() << " bytes + "
+                  << filter_bytes << " filter bytes ("
+                  << static_cast<double>(map.memoryBytes() + filter_bytes) / map.size()
+                  << " per way), loaded in " << load_ms << "ms, " << hits_ms * 1e6 / lookup_count
+                  << "ns per hit, " << mixed_ms * 1e6 / lookup_count
+                  << "ns per lookup with half misses" << std::endl;
+    }
+
+    return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,5 +1,6 @@
 #include <boost/test/test_case_template.hpp>
 #include <boost/test/unit_test.hpp>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 
@@ -198,4 +199,180 @@ BOOST_AUTO_TEST_CASE(congestion_test_get_values_exceptions)
     BOOST_CHECK_EQUAL_COLLECTIONS(actual.begin(), actual.end(), expected.begin(), expected.end());
 }
 
+BOOST_AUTO_TEST_CASE(congestion_test_filter)
+{
+    SegmentSpeedMap map("test/congestion/fixtures/congestion.csv");
+
+    // Every loaded segment passes the filter, in both hasKey and getValues
+    BOOST_CHECK(map.hasKey(86909055, 86909053));
+    BOOST_CHECK(map.hasKey(3860306483, 1362215135));
+    BOOST_CHECK_EQUAL(map.getValues({69395079, 69402983})[0], 23);
+
+    const auto stats = map.filterStats();
+    BOOST_CHECK_EQUAL(stats.keys, 39);
+    BOOST_CHECK_EQUAL(stats.memory_bytes, 64);
+    BOOST_CHECK_LT(stats.false_positive_rate, 0.01);
+
+    BOOST_CHECK_EQUAL(SegmentSpeedMap().filterStats().memory_bytes, 0);
+}
+
+BOOST_AUTO_TEST_CASE(congestion_test_frozen)
+{
+    const std::vector<std::string> paths = {"test/congestion/fixtures/congestion.csv",
+                                            "test/congestion/fixtures/congestion2.csv"};
+    const SegmentSpeedMap map(paths);
+    SegmentSpeedMap frozen(paths);
+    frozen.freeze();
+
+    BOOST_CHECK(frozen.isFrozen());
+    BOOST_CHECK_EQUAL(frozen.size(), map.size());
+    BOOST_CHECK_LT(frozen.memoryBytes(), map.memoryBytes());
+
+    // Every segment keeps its speed, and neither direction of it is confused with the other
+    for (const auto &path : paths)
+    {
+        std::ifstream csv(path);
+        std::string line;
+        while (std::getline(csv, line))
+        {
+            if (line.empty())
+                continue;
+            const auto first = line.find(',');
+            const auto second = line.find(',', first + 1);
+            const external_nodeid_t from = std::stoull(line.substr(0, first));
+            const external_nodeid_t to = std::stoull(line.substr(first + 1, second - first - 1));
+
+            BOOST_CHECK_EQUAL(frozen.getValue(from, to), map.getValue(from, to));
+            BOOST_CHECK_EQUAL(frozen.hasKey(to, from), map.hasKey(to, from));
+            BOOST_CHECK_EQUAL(frozen.hasKey(from, to + 1), map.hasKey(from, to + 1));
+            BOOST_CHECK_EQUAL(frozen.hasKey(from + 1, to), map.hasKey(from + 1, to));
+        }
+    }
+
+    std::vector<external_nodeid_t> nodes{86909055, 86909053,   86909050,   86909053,
+                                         86909055, 3860306483, 1362215135, 297976455};
+    const auto expected = map.getValues(nodes);
+    const auto actual = frozen.getValues(nodes);
+    BOOST_CHECK_EQUAL_COLLECTIONS(actual.begin(), actual.end(), expected.begin(), expected.end());
+
+    BOOST_CHECK_THROW(frozen.getValue(100, 100), std::exception);
+    BOOST_CHECK_THROW(frozen.loadCSV("test/congestion/fixtures/congestion.csv"), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE(congestion_test_parallel_load)
+{
+    // Large enough to be split between threads, with segments repeated far apart and speeds
+    // out of range, up to the largest that parses in km/h and in mph
+    const std::string path = "congestion_parallel_load.csv";
+    {
+        std::ofstream csv(path);
+        for (std::uint64_t i = 0; i < 20000; ++i)
+        {
+            const auto from = 1000000000 + i % 15000;
+            csv << from << ',' << from + 1 << ',';
+            if (i % 3 == 0)
+                csv << "mph,";
+            csv << (i == 16234 ? 1000 : (i == 17001 || i == 17002) ? 4294967295 : i % 130) << '\n';
+        }
+    }
+
+    SegmentSpeedMap sequential;
+    sequential.loadCSV(path, 1);
+    SegmentSpeedMap parallel;
+    parallel.loadCSV(path, 4);
+
+    BOOST_CHECK_EQUAL(parallel.size(), 15000);
+    BOOST_CHECK_EQUAL(parallel.size(), sequential.size());
+    for (std::uint64_t from = 1000000000; from < 1000015000; ++from)
+        BOOST_CHECK_EQUAL(parallel.getValue(from, from + 1), sequential.getValue(from, from + 1));
+    // The last row of a repeated segment wins, the rows out of range are skipped
+    BOOST_CHECK_EQUAL(parallel.getValue(1000000001, 1000000002), 15001 % 130);
+    BOOST_CHECK_EQUAL(parallel.getValue(1000001234, 1000001235), 1234 % 130);
+    BOOST_CHECK_EQUAL(parallel.getValue(1000002001, 1000002002), 82); // 51mph
+    BOOST_CHECK_EQUAL(parallel.getValue(1000002002, 1000002003), 2002 % 130);
+
+    // An invalid row late in the file stops loading at the same row
+    {
+        std::ofstream csv(path, std::ios::app);
+        csv << "1,2,x\n3,4,5\n";
+    }
+    SegmentSpeedMap invalid;
+    BOOST_CHECK_EXCEPTION(invalid.loadCSV(path, 4), std::exception, [](const std::exception &e) {
+        return std::string(e.what()) ==
+               "CSV parsing failed at congestion_parallel_load.csv:20001: 1,2,x";
+    });
+    BOOST_CHECK_EQUAL(invalid.size(), 15000);
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(congestion_test_compressed)
+{
+    SegmentSpeedMap map("test/congestion/fixtures/congestion.csv");
+    SegmentSpeedMap gzip("test/congestion/fixtures/congestion.csv.gz");
+
+    std::vector<external_nodeid_t> nodes{86909055, 86909053,   86909050,   86909053,
+                                         86909055, 3860306483, 1362215135, 297976455};
+    const auto expected = map.getValues(nodes);
+    const auto actual = gzip.getValues(nodes);
+    BOOST_CHECK_EQUAL(gzip.size(), map.size());
+    BOOST_CHECK_EQUAL_COLLECTIONS(actual.begin(), actual.end(), expected.begin(), expected.end());
+
+    // Compression is detected from the content, and a truncated file is an error
+    std::string compressed;
+    {
+        std::ifstream file("test/congestion/fixtures/congestion.csv.gz", std::ios::binary);
+        compressed.assign(std::istreambuf_iterator<char>(file), {});
+    }
+    const std::string path = "congestion_compressed.csv";
+    std::ofstream(path, std::ios::binary) << compressed;
+    SegmentSpeedMap renamed(path);
+    BOOST_CHECK_EQUAL(renamed.size(), map.size());
+    std::ofstream(path, std::ios::binary) << compressed.substr(0, compressed.size() - 20);
+    BOOST_CHECK_THROW(SegmentSpeedMap truncated(path), std::exception);
+    std::remove(path.c_str());
+
+    BOOST_CHECK_EXCEPTION(
+        SegmentSpeedMap zstd("test/congestion/fixtures/congestion.csv.zst"), std::exception,
+        [](const std::exception &e) {
+            return std::string(e.what()) == "test/congestion/fixtures/congestion.csv.zst is zstd "
+                                            "compressed, only gzip compressed files can be loaded";
+        });
+}
+
+BOOST_AUTO_TEST_CASE(congestion_test_buffer)
+{
+    SegmentSpeedMap map("test/congestion/fixtures/congestion.csv");
+
+    std::string csv;
+    {
+        std::ifstream file("test/congestion/fixtures/congestion.csv", std::ios::binary);
+        csv.assign(std::istreambuf_iterator<char>(file), {});
+    }
+    SegmentSpeedMap buffer;
+    buffer.loadCSVBuffer(csv.data(), csv.size(), "buffer");
+
+    std::vector<external_nodeid_t> nodes{86909055, 86909053,   86909050,   86909053,
+                                         86909055, 3860306483, 1362215135, 297976455};
+    const auto expected = map.getValues(nodes);
+    const auto actual = buffer.getValues(nodes);
+    BOOST_CHECK_EQUAL(buffer.size(), map.size());
+    BOOST_CHECK_EQUAL_COLLECTIONS(actual.begin(), actual.end(), expected.begin(), expected.end());
+
+    const std::string invalid = "1,2,3\n4,5,x\n";
+    BOOST_CHECK_EXCEPTION(buffer.loadCSVBuffer(invalid.data(), invalid.size(), "buffer"),
+                          std::exception, [](const std::exception &e) {
+                              return std::string(e.what()) ==
+                                     "CSV parsing failed at buffer:2: 4,5,x";
+                          });
+    BOOST_CHECK_EQUAL(buffer.getValue(1, 2), 3);
+
+    std::string compressed;
+    {
+        std::ifstream file("test/congestion/fixtures/congestion.csv.gz", std::ios::binary);
+        compressed.assign(std::istreambuf_iterator<char>(file), {});
+    }
+    BOOST_CHECK_THROW(buffer.loadCSVBuffer(compressed.data(), compressed.size(), "buffer"),
+                      std::exception);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,7 @@ const annotator = new bindings.Annotator({ coordinates: true });
 const segmentmap = new bindings.SegmentSpeedLookup();
 const waymap = new bindings.WaySpeedLookup();
 
+const fs = require('fs');
 const path = require('path');
 
 test('invalid initialization', (t) => {
@@ -201,6 +202,252 @@ test('annotate by coordinate', function(t) {
     });
 });
 
+test('annotator route cache', function(t) {
+  const cached = new bindings.Annotator({ cacheSize: 100 });
+  cached.loadOSMExtract(path.join(__dirname,'data/winthrop.osm'), (err) => {
+    if (err) throw err;
+    var nodes = [50253600,50253602,50137292];
+    cached.annotateRouteFromNodeIds(nodes, (err, first) => {
+      if (err) throw err;
+      cached.annotateRouteFromNodeIds(nodes, (err, second) => {
+        if (err) throw err;
+        t.same(second, first, "Cached route gives the same way IDs");
+        var stats = cached.getCacheStats();
+        t.equal(stats.hits, 1, "Second lookup was a cache hit");
+        t.equal(stats.misses, 1, "First lookup was a cache miss");
+        t.equal(stats.capacity, 100, "Cache capacity matches the option");
+        t.end();
+      });
+    });
+  });
+});
+
+test('annotator with coordinate cache', function(t) {
+  const cached = new bindings.Annotator({ coordinates: true, coordinateCacheSize: 100 });
+  cached.loadOSMExtract(path.join(__dirname,'data/winthrop.osm'), (err) => {
+    if (err) throw err;
+    var coords = [[-120.1872774,48.4715898],[-120.1882910,48.4725110],[-120.1872774,48.4715898]];
+    cached.annotateRouteFromLonLats(coords, (err, wayIds) => {
+      if (err) throw err;
+      t.same(wayIds, [0, 0], "Got back the expected way IDs");
+      var stats = cached.getCacheStats().coordinates;
+      t.equal(stats.hits, 1, "Repeated coordinate was a cache hit");
+      t.equal(stats.misses, 2, "New coordinates were cache misses");
+      t.equal(stats.capacity, 100, "Cache capacity matches the option");
+      t.end();
+    });
+  });
+});
+
+test('annotator with parallel chunks', function(t) {
+  const chunked = new bindings.Annotator({ coordinates: true, parallelChunkSize: 1 });
+  chunked.loadOSMExtract(path.join(__dirname,'data/winthrop.osm'), (err) => {
+    if (err) throw err;
+    var coords = [[-120.1872774,48.4715898],[-120.1882910,48.4725110],[0,0]];
+    chunked.annotateRouteFromLonLats(coords, (err, wayIds) => {
+      if (err) throw err;
+      t.same(wayIds, [0, null], "Got back the expected way IDs");
+      chunked.annotateRouteFromNodeIds([50253600,50253602,50137292], (err, wayIds) => {
+        if (err) throw err;
+        t.same(wayIds, [0, 0], "Got back the expected way IDs from node ids");
+        t.end();
+      });
+    });
+  });
+});
+
+test('annotate with run-length encoded output', function(t) {
+    var nodes = [50253600,50253602,50137292,1];
+    annotator.annotateRouteFromNodeIds(nodes, { runs: true }, (err, runs) => {
+      if (err) throw err;
+      t.same(runs, [[0, 0, 2], [null, 2, 1]], "Got back runs of way IDs");
+      annotator.annotateRouteFromNodeIds(new Float64Array(nodes), { runs: true }, (err, typed) => {
+        if (err) throw err;
+        t.ok(typed instanceof Uint32Array, "Typed input gives typed runs");
+        t.same(Array.from(typed), [0, 0, 2, 4294967295, 2, 1], "Got back flat run triples");
+        var coords = [[-120.1872774,48.4715898],[-120.1882910,48.4725110],[0,0]];
+        annotator.annotateRouteFromLonLats(coords, { runs: true }, (err, runs) => {
+          if (err) throw err;
+          t.same(runs, [[0, 0, 1], [null, 1, 1]], "Got back runs from coordinates");
+          t.throws(function() { annotator.annotateRouteFromNodeIds(nodes, { runs: 1 }, () => {}); }, /runs/, 'returns error with a non-boolean runs option');
+          t.end();
+        });
+      });
+    });
+});
+
+test('annotate with gap filling', function(t) {
+    // Skips 50253602 between the first two nodes
+    var nodes = [50253600,50137292,1];
+    annotator.annotateRouteFromNodeIds(nodes, (err, wayIds) => {
+      if (err) throw err;
+      t.same(wayIds, [null, null], "Gap is unmatched without filling");
+      annotator.annotateRouteFromNodeIds(nodes, { fillGaps: 2 }, (err, wayIds) => {
+        if (err) throw err;
+        t.same(wayIds, [[0], null], "Gap is filled with the way IDs along the path");
+        t.throws(function() { annotator.annotateRouteFromNodeIds(nodes, { fillGaps: 0 }, () => {}); }, /fillGaps/, 'returns error with no hops');
+        t.throws(function() { annotator.annotateRouteFromNodeIds(nodes, { fillGaps: 2.7 }, () => {}); }, /fillGaps/, 'returns error with a fractional number of hops');
+        t.throws(function() { annotator.annotateRouteFromNodeIds(nodes, { fillGaps: 2, runs: true }, () => {}); }, /fillGaps/, 'returns error when combined with runs');
+        t.throws(function() { annotator.annotateRouteFromNodeIds(new Float64Array(nodes), { fillGaps: 2 }, () => {}); }, /fillGaps/, 'returns error with typed arrays');
+        t.end();
+      });
+    });
+});
+
+test('aggregate route lengths by tag', function(t) {
+    var nodes = [50253600,50253602,50137292];
+    annotator.aggregateRouteFromNodeIds(nodes, ['highway', 'surface', 'highway'], (err, lengths) => {
+      if (err) throw err;
+      t.same(Object.keys(lengths), ['highway', 'surface'], "Got a summary for every key");
+      t.same(Object.keys(lengths.highway), ['residential'], "Route is all residential, a repeated key keeps its lengths");
+      t.ok(lengths.highway.residential > 0, "Residential length was measured");
+      t.same(lengths.surface, {}, "No surface tags on the route");
+      const noCoordinates = new bindings.Annotator();
+      noCoordinates.loadOSMExtract(path.join(__dirname,'data/winthrop.osm'), (err) => {
+        if (err) throw err;
+        noCoordinates.aggregateRouteFromNodeIds(nodes, ['highway'], (err) => {
+          t.ok(err, "Fails without coordinates support");
+          t.end();
+        });
+      });
+    });
+});
+
+test('annotator with connected snapping', function(t) {
+  const snapping = new bindings.Annotator({ coordinates: true, snapCandidates: 4, snapRadius: 10 });
+  snapping.loadOSMExtract(path.join(__dirname,'data/winthrop.osm'), (err) => {
+    if (err) throw err;
+    var coords = [[-120.1872774,48.4715898],[-120.1882910,48.4725110],[0,0]];
+    snapping.annotateRouteFromLonLats(coords, (err, wayIds) => {
+      if (err) throw err;
+      t.same(wayIds, [0, null], "Got back the expected way IDs");
+      t.end();
+    });
+  });
+});
+
+test('annotate by node and coordinates while the coordinate index is built', function(t) {
+  t.plan(2);
+  const background = new bindings.Annotator({ coordinates: true });
+  background.loadOSMExtract(path.join(__dirname,'data/winthrop.osm'), (err) => {
+    if (err) throw err;
+    // The lon/lat request is queued until the index exists, node ids are answered right away
+    var coords = [[-120.1872774,48.4715898],[-120.1882910,48.4725110]];
+    background.annotateRouteFromLonLats(coords, (err, wayIds) => {
+      if (err) throw err;
+      t.same(wayIds, [0], 'Got back the expected way IDs from coordinates');
+    });
+    background.annotateRouteFromNodeIds([50253600,50253602], (err, wayIds) => {
+      if (err) throw err;
+      t.same(wayIds, [0], 'Got back the expected way IDs from node ids');
+    });
+  });
+});
+
+test('annotator with invalid snapping options', function(t) {
+  t.throws(function() { new bindings.Annotator({ snapRadius: 0 }); }, /snapRadius/, 'returns error with a zero radius');
+  t.throws(function() { new bindings.Annotator({ snapRadius: Infinity }); }, /snapRadius/, 'returns error with an infinite radius');
+  t.throws(function() { new bindings.Annotator({ snapCandidates: 0 }); }, /snapCandidates/, 'returns error with no candidates');
+  t.throws(function() { new bindings.Annotator({ snapCandidates: Infinity }); }, /snapCandidates/, 'returns error with infinite candidates');
+  t.end();
+});
+
+test('annotator with invalid cacheSize option', function(t) {
+  t.throws(function() { new bindings.Annotator({ cacheSize: -1 }); }, /cacheSize/, 'returns error with a negative cache size');
+  t.throws(function() { new bindings.Annotator({ cacheSize: 'big' }); }, /cacheSize/, 'returns error with a non-numeric cache size');
+  t.throws(function() { new bindings.Annotator({ coordinateCacheSize: -1 }); }, /coordinateCacheSize/, 'returns error with a negative coordinate cache size');
+  t.throws(function() { new bindings.Annotator({ parallelChunkSize: -1 }); }, /parallelChunkSize/, 'returns error with a negative chunk size');
+  t.throws(function() { new bindings.Annotator({ cacheSize: Infinity }); }, /cacheSize/, 'returns error with an infinite cache size');
+  t.throws(function() { new bindings.Annotator({ coordinateCacheSize: 1e30 }); }, /coordinateCacheSize/, 'returns error with a cache size out of range');
+  t.throws(function() { new bindings.Annotator({ parallelChunkSize: 2.5 }); }, /parallelChunkSize/, 'returns error with a fractional chunk size');
+  t.end();
+});
+
+test('annotate by node with typed arrays', function(t) {
+    var nodes = new Float64Array([50253600,50253602,50137292,1]);
+    annotator.annotateRouteFromNodeIds(nodes, (err, wayIds) => {
+      if (err) throw err;
+      t.ok(wayIds instanceof Uint32Array, "Typed input gives a Uint32Array back");
+      t.same(Array.from(wayIds), [0, 0, 4294967295], "Unmatched segments use the INVALID_WAYID sentinel");
+      if (typeof BigUint64Array === 'undefined') return t.end();
+      var bigNodes = new BigUint64Array([50253600n,50253602n,50137292n]);
+      annotator.annotateRouteFromNodeIds(bigNodes, (err, wayIds) => {
+        if (err) throw err;
+        t.same(Array.from(wayIds), [0, 0], "BigUint64Array node ids are supported");
+        t.end();
+      });
+    });
+});
+
+test('annotate by coordinate with typed arrays', function(t) {
+    var coords = new Float64Array([-120.1872774,48.4715898,-120.1882910,48.4725110,0,0]);
+    annotator.annotateRouteFromLonLats(coords, (err, wayIds) => {
+      if (err) throw err;
+      t.ok(wayIds instanceof Uint32Array, "Typed input gives a Uint32Array back");
+      t.same(Array.from(wayIds), [0, 4294967295], "Got back the expected way IDs");
+      t.throws(function() {
+        annotator.annotateRouteFromLonLats(new Float64Array([1,2,3]), (err, wayIds) => {});
+      }, /interleaved/, "Should fail if the coordinates aren't pairs");
+      t.end();
+    });
+});
+
+test('annotate by encoded polyline', function(t) {
+    // Same coordinates as above, precision 5
+    annotator.annotateRouteFromLonLats('mbzfHnaq|UwDhEdhzfHygq|U', (err, wayIds) => {
+      if (err) throw err;
+      t.same(wayIds, [0, null], "Got back the expected way IDs");
+      t.end();
+    });
+});
+
+test('annotate by encoded polyline with precision 6', function(t) {
+    annotator.annotateRouteFromLonLats('kanm{AxwsfdFqx@j~@|zom{AewufdF', { precision: 6 }, (err, wayIds) => {
+      if (err) throw err;
+      t.same(wayIds, [0, null], "Got back the expected way IDs");
+      t.end();
+    });
+});
+
+test('invalid encoded polyline parameters', function(t) {
+  t.throws(function() {
+    annotator.annotateRouteFromLonLats('mbzfHnaq|UwDhEdhzfHygq|U', { precision: 7 }, (err, wayIds) => {});
+  }, /precision/, "Should fail if precision isn't 5 or 6");
+  t.throws(function() {
+    annotator.annotateRouteFromLonLats('mbzfHnaq|UwDhEdhzfHygq|U', { precision: 5.7 }, (err, wayIds) => {});
+  }, /precision/, "Should fail if precision isn't a whole number");
+
+  annotator.annotateRouteFromLonLats('mbzfHnaq|U', (err, wayIds) => {
+    t.ok(err, "Should fail if the polyline has a single coordinate");
+    annotator.annotateRouteFromLonLats('mbzfHnaq', (err, wayIds) => {
+      t.ok(err, "Should fail if the polyline is truncated");
+      t.end();
+    });
+  });
+});
+
+test('get tags for many way ids', function(t) {
+    annotator.getTagsForWayIds([0, 99999, 0], (err, tags) => {
+      if (err) throw err;
+      t.equal(tags.length, 3, "One result per requested way ID");
+      t.equal(tags[0]._way_id, '6091729', "Got correct _way_id attribute on match");
+      t.equal(tags[1], null, "Unknown way IDs give null");
+      t.same(tags[2], tags[0], "Repeated way IDs give the same tags");
+      annotator.getAllTagsForWayId(0, (err, single) => {
+        if (err) throw err;
+        t.same(tags[0], single, "Same tags as getAllTagsForWayId");
+        t.end();
+      });
+    });
+});
+
+test('invalid get tags for many way ids parameters', (t) => {
+  t.throws(function() { annotator.getTagsForWayIds(0, (err, tags) => {}); }, /Array of way IDs/, "Should fail if the ids aren't an array");
+  t.throws(function() { annotator.getTagsForWayIds(["a"], (err, tags) => {}); }, /numeric way IDs/, "Should fail if an id isn't a number");
+  t.throws(function() { annotator.getTagsForWayIds([0]); }, /callback/, "Should fail without a callback");
+  t.end();
+});
+
 test('invalid get tags parameters', (t) => {
   try {
     annotator.getAllTagsForWayId("invalid", (err, wayIds) => {
@@ -391,6 +638,78 @@ test('SegmentSpeedLookup: lookup node pair from second file', function(t) {
   });
 });
 
+test('SegmentSpeedLookup: filter statistics', function(t) {
+  const stats = segmentmap.getFilterStats();
+  t.ok(stats.keys > 0, "Filter covers the loaded keys");
+  t.ok(stats.bytes > 0, "Filter memory is reported");
+  t.ok(stats.falsePositiveRate > 0 && stats.falsePositiveRate < 0.05, "False positive rate is low");
+  t.same(new bindings.SegmentSpeedLookup().getFilterStats(), {keys: 0, bytes: 0, falsePositiveRate: 0},
+         "Empty filter without a CSV");
+  t.end();
+});
+
+test('SegmentSpeedLookup: frozen storage', function(t) {
+  const frozenmap = new bindings.SegmentSpeedLookup();
+  t.throws(() => { frozenmap.loadCSV(path.join(__dirname,'congestion/fixtures/congestion.csv'), {frozen: 1}, () => {}); },
+           "frozen option must be a boolean");
+  frozenmap.loadCSV(
+    [path.join(__dirname,'congestion/fixtures/congestion.csv'),
+     path.join(__dirname,'congestion/fixtures/congestion2.csv')],
+    {frozen: true}, (err) => {
+    if (err) throw err;
+    const stats = frozenmap.getStorageStats();
+    const unfrozen = segmentmap.getStorageStats();
+    t.ok(stats.frozen, "Segments are frozen");
+    t.notOk(unfrozen.frozen, "Segments are kept in a hashtable by default");
+    t.equal(stats.segments, unfrozen.segments, "Same segments are loaded");
+    t.ok(stats.bytes < unfrozen.bytes, "Frozen segments take less memory");
+    frozenmap.getRouteSpeeds([86909055, 86909053, 86909050, 86909053, 86909055, 3860306483, 1362215135, 297976455], (err, resp) => {
+      if (err) throw err;
+      t.same(resp, [81, 81, 81, 81, 255, 6, 10], "Frozen lookups return the same speeds");
+      t.end();
+    });
+  });
+});
+
+test('SegmentSpeedLookup: load from a buffer', function(t) {
+  const buffermap = new bindings.SegmentSpeedLookup();
+  t.throws(() => { buffermap.loadCSVFromBuffer('86909055,86909053,81', () => {}); },
+           "Only buffers are accepted");
+  const csv = fs.readFileSync(path.join(__dirname,'congestion/fixtures/congestion.csv'));
+  buffermap.loadCSVFromBuffer(csv, {frozen: true}, (err) => {
+    if (err) throw err;
+    t.ok(buffermap.getStorageStats().frozen, "Options apply to buffers");
+    buffermap.getRouteSpeeds([86909055, 86909053, 86909050, 86909053, 86909055, 3860306483, 1362215135, 297976455], (err, resp) => {
+      if (err) throw err;
+      t.same(resp, [81, 81, 81, 81, 255, 6, 10], "Speeds are loaded from the buffer");
+      buffermap.loadCSVFromBuffer(Buffer.from('1,2,3\n4,5,x\n'), (err) => {
+        t.equal(err.message, 'CSV parsing failed at buffer:2: 4,5,x', "Errors name the buffer");
+        t.end();
+      });
+    });
+  });
+});
+
+test('SegmentSpeedLookup: route speed statistics', function(t) {
+  segmentmap.getRouteSpeedStats([86909066,86909064,86909066,999], (err, stats)=> {
+    if (err) { console.log(err); throw err; }
+    t.equal(stats.min, 79, "Verify minimum speed");
+    t.equal(stats.max, 80, "Verify maximum speed");
+    t.equal(stats.mean, 79.5, "Verify mean speed");
+    t.ok(Math.abs(stats.harmonicMean - 2 / (1/79 + 1/80)) < 1e-9, "Verify harmonic mean speed");
+    t.ok(Math.abs(stats.coverage - 2/3) < 1e-9, "Verify coverage");
+    t.equal(stats.valid, 2, "Verify segments with a speed");
+    t.equal(stats.total, 3, "Verify segment count");
+    var speedlookup = new bindings.SegmentSpeedLookup();
+    speedlookup.getRouteSpeedStats([90,91,92,93], (err, stats)=> {
+      if (err) { console.log(err); throw err; }
+      t.equal(stats.mean, null, "No speeds without a CSV");
+      t.equal(stats.coverage, 0, "No coverage without a CSV");
+      t.end();
+    });
+  });
+});
+
 test('SegmentSpeedLookup: make sure that it works even if CSV is not loaded', function(t) {
   var speedlookup = new bindings.SegmentSpeedLookup();
   speedlookup.getRouteSpeeds([90,91,92,93], (err, resp)=> {
@@ -621,6 +940,65 @@ test('WaySpeedLookup: lookup ways from second file', function(t) {
   });
 });
 
+test('WaySpeedLookup: filter statistics', function(t) {
+  const stats = waymap.getFilterStats();
+  t.ok(stats.keys > 0, "Filter covers the loaded keys");
+  t.ok(stats.bytes > 0, "Filter memory is reported");
+  t.ok(stats.falsePositiveRate > 0 && stats.falsePositiveRate < 0.05, "False positive rate is low");
+  t.same(new bindings.WaySpeedLookup().getFilterStats(), {keys: 0, bytes: 0, falsePositiveRate: 0},
+         "Empty filter without a CSV");
+  t.end();
+});
+
+test('WaySpeedLookup: radix storage', function(t) {
+  const radixmap = new bindings.WaySpeedLookup();
+  t.throws(() => { radixmap.loadCSV(path.join(__dirname,'wayspeeds/fixtures/way_speeds.csv'), {storage: 'trie'}, () => {}); },
+           "Unknown storage is rejected");
+  t.same(radixmap.getStorageStats(), {ways: 0, bytes: 0, storage: 'hashtable'}, "Nothing stored without a CSV");
+  radixmap.loadCSV(
+    [path.join(__dirname,'wayspeeds/fixtures/way_speeds.csv'),
+     path.join(__dirname,'wayspeeds/fixtures/way_speeds2.csv')],
+    {storage: 'radix'}, (err) => {
+    if (err) throw err;
+    const stats = radixmap.getStorageStats();
+    t.equal(stats.storage, 'radix', "Speeds are stored in pages");
+    t.equal(stats.ways, waymap.getStorageStats().ways, "Same ways are loaded");
+    t.ok(stats.bytes >= 65536, "Page memory is reported");
+    radixmap.getRouteSpeeds([301595694,165499294,106817824,45619838,999], (err, resp) => {
+      if (err) throw err;
+      t.same(resp, [30,70,113,65,255], "Radix lookups return the same speeds");
+      t.end();
+    });
+  });
+});
+
+test('WaySpeedLookup: load from a buffer', function(t) {
+  const buffermap = new bindings.WaySpeedLookup();
+  t.throws(() => { buffermap.loadCSVFromBuffer(1234, () => {}); }, "Only buffers are accepted");
+  const csv = fs.readFileSync(path.join(__dirname,'wayspeeds/fixtures/way_speeds.csv'));
+  buffermap.loadCSVFromBuffer(csv, {storage: 'radix'}, (err) => {
+    if (err) throw err;
+    t.equal(buffermap.getStorageStats().storage, 'radix', "Options apply to buffers");
+    buffermap.getRouteSpeeds([106817824,999], (err, resp) => {
+      if (err) throw err;
+      t.same(resp, [113,255], "Speeds are loaded from the buffer");
+      t.end();
+    });
+  });
+});
+
+test('WaySpeedLookup: route speed statistics', function(t) {
+  waymap.getRouteSpeedStats([301595694,165499294,106817824,999], (err, stats)=> {
+    if (err) { console.log(err); throw err; }
+    t.equal(stats.min, 30, "Verify minimum speed");
+    t.equal(stats.max, 113, "Verify maximum speed");
+    t.equal(stats.mean, 71, "Verify mean speed");
+    t.equal(stats.coverage, 0.75, "Verify coverage");
+    t.equal(stats.total, 4, "Verify way count");
+    t.end();
+  });
+});
+
 test('WaySpeedLookup: make sure that it works even if CSV is not loaded', function(t) {
   var waylookup = new bindings.WaySpeedLookup();
   waylookup.getRouteSpeeds([6697274,11714049,6663351,6670232], (err, resp)=> {
@@ -638,3 +1016,117 @@ test('WaySpeedLookup: dont load CSV and see if you get the correct response (4 I
     t.end();
   });
 });
+
+test('SpeedFallbackLookup: invalid parameters', function(t) {
+  t.throws(() => { new bindings.SpeedFallbackLookup(); }, "Needs the annotator and both lookups");
+  t.throws(() => { new bindings.SpeedFallbackLookup(annotator, waymap, segmentmap); },
+           "Lookups must be passed in order");
+  const fallback = new bindings.SpeedFallbackLookup(annotator, segmentmap, waymap);
+  t.throws(() => { fallback.getRouteSpeeds([1], () => {}); }, "Needs at least two node ids");
+  t.throws(() => { fallback.getRouteSpeeds([1, -2], () => {}); }, "Node ids must be positive");
+  t.end();
+});
+
+test('SpeedFallbackLookup: segment speed, then way speed, then maxspeed', function(t) {
+  const monaco = new bindings.Annotator();
+  const segments = new bindings.SegmentSpeedLookup();
+  const ways = new bindings.WaySpeedLookup();
+  const fallback = new bindings.SpeedFallbackLookup(monaco, segments, ways);
+  // Way 4227277 (maxspeed 50) 1918966551 -> 1079045459 -> 4940692951, then way 4229292
+  // (no maxspeed) 937988290 -> 1079045402
+  const nodes = [1918966551,1079045459,4940692951,937988290,1079045402,999];
+
+  fallback.getRouteSpeeds(nodes, (err, speeds, sources) => {
+    t.error(err, "Nothing loaded yet");
+    t.same(speeds, [255,255,255,255,255], "No speeds without data");
+    t.same(sources, [0,0,0,0,0], "No sources without data");
+
+    monaco.loadOSMExtract(path.join(__dirname,'data/monaco.extract.osm'), (err) => {
+      if (err) throw err;
+      segments.loadCSV(path.join(__dirname,'congestion/fixtures/fallback.csv'), (err) => {
+        if (err) throw err;
+        ways.loadCSV(path.join(__dirname,'wayspeeds/fixtures/fallback.csv'), (err) => {
+          if (err) throw err;
+          fallback.getRouteSpeeds(nodes, (err, speeds, sources) => {
+            t.error(err, "Speeds resolved");
+            t.same(speeds, [33,50,255,65,255], "Verify expected speeds");
+            t.same(sources, [1,3,0,2,0], "Verify the source of each speed");
+            t.end();
+          });
+        });
+      });
+    });
+  });
+});
+
+test('way speeds bound to the loaded extract', function(t) {
+  const monaco = new bindings.Annotator();
+  const ways = new bindings.WaySpeedLookup();
+  t.throws(() => { monaco.bindWaySpeeds(ways, () => {}); }, "Needs OSM data first");
+  // Way 4227277 without a way speed, then way 4229292 with one
+  const nodes = [1918966551,1079045459,4940692951,937988290,1079045402,999];
+
+  monaco.loadOSMExtract(path.join(__dirname,'data/monaco.extract.osm'), (err) => {
+    if (err) throw err;
+    t.throws(() => { monaco.bindWaySpeeds({}, () => {}); }, "Needs a WaySpeedLookup");
+    t.throws(() => { monaco.annotateRouteFromNodeIds(nodes, {waySpeeds: 1}, () => {}); },
+             "waySpeeds option must be a boolean");
+    t.throws(() => { monaco.annotateRouteFromNodeIds(nodes, {waySpeeds: true, fillGaps: 2}, () => {}); },
+             "waySpeeds can't be combined with fillGaps");
+
+    monaco.annotateRouteFromNodeIds(nodes, {waySpeeds: true}, (err, wayIds, speeds) => {
+      t.error(err, "Annotates before binding");
+      t.same(speeds, [255,255,255,255,255], "No speeds before binding");
+
+      ways.loadCSV(path.join(__dirname,'wayspeeds/fixtures/fallback.csv'), (err) => {
+        if (err) throw err;
+        monaco.bindWaySpeeds(ways, (err) => {
+          t.error(err, "Speeds bound");
+          monaco.annotateRouteFromNodeIds(nodes, {waySpeeds: true}, (err, wayIds, speeds) => {
+            t.error(err, "Annotated");
+            t.equal(wayIds.length, 5, "Way ids are returned as without the option");
+            t.same(speeds, [255,255,255,65,255], "Speed of the way of each segment");
+            monaco.annotateRouteFromNodeIds(nodes, {waySpeeds: true, runs: true}, (err, runs, speeds) => {
+              t.error(err, "Annotated runs");
+              // 4940692951 -> 937988290 and 1079045402 -> 999 aren't on a way
+              t.same(runs, [[wayIds[0],0,2],[null,2,1],[wayIds[3],3,1],[null,4,1]],
+                     "Runs of way 4227277, no way, way 4229292 and no way");
+              t.same(speeds, [255,255,65,255], "Speed of the way of each run");
+              monaco.annotateRouteFromNodeIds(new Float64Array(nodes), {waySpeeds: true}, (err, wayIds, speeds) => {
+                t.error(err, "Annotated typed array");
+                t.ok(speeds instanceof Uint8Array, "Speeds are typed too");
+                t.same(Array.from(speeds), [255,255,255,65,255], "Same speeds from typed arrays");
+                t.end();
+              });
+            });
+          });
+        });
+      });
+    });
+  });
+});
+
+test('segment speeds stored against the loaded extract', function(t) {
+  const monaco = new bindings.Annotator();
+  t.throws(() => { monaco.loadSegmentSpeedCSV('speeds.csv', () => {}); }, "Needs OSM data first");
+
+  monaco.loadOSMExtract(path.join(__dirname,'data/monaco.extract.osm'), (err) => {
+    if (err) throw err;
+    const nodes = [1918966551,1079045459,4940692951,1079045459,999];
+    monaco.getRouteSpeedsFromNodeIds(nodes, (err, wayIds, speeds) => {
+      t.error(err, "Speeds without a CSV");
+      t.same(speeds, [255,255,255,255], "No speeds before loading");
+      t.equal(wayIds[3], null, "Unknown node pair has no way");
+
+      monaco.loadSegmentSpeedCSV(path.join(__dirname,'congestion/fixtures/fallback.csv'), (err) => {
+        if (err) throw err;
+        monaco.getRouteSpeedsFromNodeIds(nodes, (err, speedWayIds, speeds) => {
+          t.error(err, "Speeds after loading a CSV");
+          t.same(speedWayIds, wayIds, "Same way ids as without speeds");
+          t.same(speeds, [33,255,255,255], "Speed only in the direction of the CSV row");
+          t.end();
+        });
+      });
+    });
+  });
+});
@@ -1,5 +1,6 @@
 #include <boost/test/test_case_template.hpp>
 #include <boost/test/unit_test.hpp>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 
@@ -168,4 +169,114 @@ BOOST_AUTO_TEST_CASE(way_speeds_test_has_key)
     BOOST_CHECK_EQUAL(map.hasKey(51369345),true);
 }
 
+BOOST_AUTO_TEST_CASE(way_speeds_test_radix)
+{
+    const std::vector<std::string> paths = {"test/wayspeeds/fixtures/way_speeds.csv",
+                                            "test/wayspeeds/fixtures/way_speeds2.csv"};
+    const WaySpeedMap map(paths);
+    WaySpeedMap radix(paths, WaySpeedMap::Storage::Radix);
+
+    BOOST_CHECK(radix.storage() == WaySpeedMap::Storage::Radix);
+    BOOST_CHECK_EQUAL(radix.size(), map.size());
+    BOOST_CHECK_EQUAL(radix.filterStats().keys, 0);
+
+    // Ways with a speed, their neighbours in the same page and ids past the last page
+    std::vector<wayid_t> ways{106817824, 231738435, 406215748, 51369345, 106817825,
+                              1,         0,         4294967294};
+    const auto expected = map.getValues(ways);
+    const auto actual = radix.getValues(ways);
+    BOOST_CHECK_EQUAL_COLLECTIONS(actual.begin(), actual.end(), expected.begin(), expected.end());
+    for (const auto way : ways)
+    {
+        BOOST_CHECK_EQUAL(radix.hasKey(way), map.hasKey(way));
+        if (map.hasKey(way))
+            BOOST_CHECK_EQUAL(radix.getValue(way), map.getValue(way));
+        else
+            BOOST_CHECK_THROW(radix.getValue(way), std::exception);
+    }
+
+    // A page of speeds for each populated range of 64K way ids, and a pointer up to the last one
+    const std::size_t largest_way = 589687901;
+    const auto page_pointers = ((largest_way >> WaySpeedMap::PAGE_BITS) + 1) * sizeof(void *);
+    BOOST_CHECK_GE(radix.memoryBytes(), WaySpeedMap::PAGE_SIZE + page_pointers);
+    BOOST_CHECK_LE(radix.memoryBytes(), radix.size() * WaySpeedMap::PAGE_SIZE + page_pointers);
+}
+
+BOOST_AUTO_TEST_CASE(way_speeds_test_parallel_load)
+{
+    // Large enough to be split between threads, with ways repeated far apart and the largest
+    // speed that parses, in km/h and in mph
+    const std::string path = "way_speeds_parallel_load.csv";
+    {
+        std::ofstream csv(path);
+        for (std::uint32_t i = 0; i < 20000; ++i)
+            csv << 100000 + i % 15000 << ",C7nsuhT7vQHkBQEPAKIBBQ==," << (i % 3 ? "kph," : "mph,")
+                << ((i == 17001 || i == 17002) ? 4294967295 : i % 130) << '\n';
+    }
+
+    for (const auto storage : {WaySpeedMap::Storage::Hashtable, WaySpeedMap::Storage::Radix})
+    {
+        WaySpeedMap sequential(storage);
+        sequential.loadCSV(path, 1);
+        WaySpeedMap parallel(storage);
+        parallel.loadCSV(path, 4);
+
+        BOOST_CHECK_EQUAL(parallel.size(), 15000);
+        std::vector<wayid_t> ways;
+        for (wayid_t way = 100000; way < 115000; ++way)
+            ways.push_back(way);
+        const auto expected = sequential.getValues(ways);
+        const auto actual = parallel.getValues(ways);
+        BOOST_CHECK_EQUAL_COLLECTIONS(actual.begin(), actual.end(), expected.begin(),
+                                      expected.end());
+        // The last row of a repeated way wins, the rows out of range are skipped
+        BOOST_CHECK_EQUAL(parallel.getValue(100001), 15001 % 130);
+        BOOST_CHECK_EQUAL(parallel.getValue(102001), 82); // 51mph
+        BOOST_CHECK_EQUAL(parallel.getValue(102002), 2002 % 130);
+    }
+    std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(way_speeds_test_compressed)
+{
+    for (const auto storage : {WaySpeedMap::Storage::Hashtable, WaySpeedMap::Storage::Radix})
+    {
+        WaySpeedMap map(storage);
+        map.loadCSV("test/wayspeeds/fixtures/way_speeds.csv");
+        WaySpeedMap gzip(storage);
+        gzip.loadCSV("test/wayspeeds/fixtures/way_speeds.csv.gz");
+
+        std::vector<wayid_t> ways{106817824, 172938030, 50324987, 231738435, 106780378};
+        const auto expected = map.getValues(ways);
+        const auto actual = gzip.getValues(ways);
+        BOOST_CHECK_EQUAL(gzip.size(), map.size());
+        BOOST_CHECK_EQUAL_COLLECTIONS(actual.begin(), actual.end(), expected.begin(),
+                                      expected.end());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(way_speeds_test_buffer)
+{
+    std::string csv;
+    {
+        std::ifstream file("test/wayspeeds/fixtures/way_speeds.csv", std::ios::binary);
+        csv.assign(std::istreambuf_iterator<char>(file), {});
+    }
+
+    for (const auto storage : {WaySpeedMap::Storage::Hashtable, WaySpeedMap::Storage::Radix})
+    {
+        WaySpeedMap map(storage);
+        map.loadCSV("test/wayspeeds/fixtures/way_speeds.csv");
+        WaySpeedMap buffer(storage);
+        buffer.loadCSVBuffer(csv.data(), csv.size(), "buffer");
+
+        std::vector<wayid_t> ways{106817824, 172938030, 50324987, 231738435, 106780378};
+        const auto expected = map.getValues(ways);
+        const auto actual = buffer.getValues(ways);
+        BOOST_CHECK_EQUAL(buffer.size(), map.size());
+        BOOST_CHECK_EQUAL_COLLECTIONS(actual.begin(), actual.end(), expected.begin(),
+                                      expected.end());
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()